@@ -0,0 +1,1280 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Description:  Device-independent bookkeeping shared by the LinearAllocator, BuddyAllocator and
+// CommandAllocatorPool.  Nothing here touches D3D12.  Memory comes from a provider and GPU progress is
+// observed through a fence query, which is any callable taking a fence value and returning true once
+// the GPU has passed it.  The host provider and fence at the bottom of the file let the allocators be
+// driven from a plain C++ program, as the tests and benchmarks in Tests/ do.
+//
+// A provider supplies:
+//     typedef ... PageType;
+//     PageType* CreatePage( size_t PageSize );    // 0 selects the default page size
+//     void DestroyPage( PageType* Page );
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifndef ASSERT
+#include <cassert>
+#define ASSERT(expr) assert(expr)
+#endif
+
+namespace AllocatorCore
+{
+    // A lock-free, multi-producer, multi-consumer list of items waiting on a fence.  Producers push a
+    // batch of items per fence value.  A consumer takes the whole list at once, keeps the batches whose
+    // fence has completed, and pushes the rest back.  Taking the whole list avoids the ABA problem of
+    // popping individual nodes.
+    template <typename T>
+    class FencedList
+    {
+    public:
+        FencedList() : m_Head(nullptr) {}
+        ~FencedList() { Clear(); }
+
+        void Push( uint64_t FenceValue, const std::vector<T>& Items )
+        {
+            if (Items.empty())
+                return;
+
+            Batch* NewBatch = new Batch;
+            NewBatch->FenceValue = FenceValue;
+            NewBatch->Items = Items;
+            NewBatch->Next = nullptr;
+            PushChain(NewBatch, NewBatch);
+        }
+
+        // Appends items whose fence has completed to Completed
+        template <typename FenceQuery>
+        void Reclaim( const FenceQuery& IsFenceComplete, std::vector<T>& Completed )
+        {
+            if (m_Head.load(std::memory_order_relaxed) == nullptr)
+                return;
+
+            Batch* Iter = m_Head.exchange(nullptr, std::memory_order_acquire);
+            Batch* PendingFirst = nullptr;
+            Batch* PendingLast = nullptr;
+
+            while (Iter != nullptr)
+            {
+                Batch* Next = Iter->Next;
+
+                if (IsFenceComplete(Iter->FenceValue))
+                {
+                    Completed.insert(Completed.end(), Iter->Items.begin(), Iter->Items.end());
+                    delete Iter;
+                }
+                else
+                {
+                    Iter->Next = PendingFirst;
+                    PendingFirst = Iter;
+                    if (PendingLast == nullptr)
+                        PendingLast = Iter;
+                }
+
+                Iter = Next;
+            }
+
+            if (PendingFirst != nullptr)
+                PushChain(PendingFirst, PendingLast);
+        }
+
+        // Forgets all items without waiting on their fences
+        void Clear( void )
+        {
+            Batch* Iter = m_Head.exchange(nullptr, std::memory_order_acquire);
+            while (Iter != nullptr)
+            {
+                Batch* Next = Iter->Next;
+                delete Iter;
+                Iter = Next;
+            }
+        }
+
+    private:
+        struct Batch
+        {
+            uint64_t FenceValue;
+            std::vector<T> Items;
+            Batch* Next;
+        };
+
+        void PushChain( Batch* First, Batch* Last )
+        {
+            Batch* Head = m_Head.load(std::memory_order_relaxed);
+            do
+            {
+                Last->Next = Head;
+            }
+            while (!m_Head.compare_exchange_weak(Head, First, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        std::atomic<Batch*> m_Head;
+    };
+
+    // Recycles fixed size pages once the fence they were retired with has passed.  Each thread keeps a
+    // small cache of free pages so that requesting a page rarely touches shared state.  Retired pages are
+    // reclaimed in batches by whichever thread next runs out of cached pages.  A mutex is only taken when
+    // pages must be created or moved between a thread cache and the shared free list.  Up to
+    // kMaxThreadCacheSlots pools of one type can be live at once before their thread caches collide.
+    template <typename Provider, typename FenceQuery>
+    class FencedPagePool
+    {
+    public:
+        typedef typename Provider::PageType PageType;
+
+        enum
+        {
+            kRefillCount = 4,           // Pages moved from the shared free list into a thread cache at a time
+            kMaxCachedPages = 16,       // Reclaimed pages beyond this are returned to the shared free list
+            kMaxThreadCacheSlots = 16
+        };
+
+        FencedPagePool( const Provider& PageProvider, const FenceQuery& IsFenceComplete )
+            : m_Provider(PageProvider), m_IsFenceComplete(IsFenceComplete),
+            m_Slot(NextSlot()), m_Epoch(NextEpoch())
+        {
+        }
+
+        ~FencedPagePool() { Destroy(); }
+
+        Provider& GetProvider( void ) { return m_Provider; }
+
+        // Not safe to call while other threads are using the pool
+        void SetFenceQuery( const FenceQuery& IsFenceComplete ) { m_IsFenceComplete = IsFenceComplete; }
+
+        PageType* RequestPage( void )
+        {
+            ThreadCache& Cache = GetThreadCache();
+
+            if (Cache.Pages.empty())
+            {
+                m_RetiredPages.Reclaim(m_IsFenceComplete, Cache.Pages);
+
+                if (Cache.Pages.size() > kMaxCachedPages)
+                {
+                    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+                    m_AvailablePages.insert(m_AvailablePages.end(), Cache.Pages.begin() + kMaxCachedPages, Cache.Pages.end());
+                    Cache.Pages.resize(kMaxCachedPages);
+                }
+            }
+
+            if (Cache.Pages.empty())
+            {
+                std::lock_guard<std::mutex> LockGuard(m_Mutex);
+                const size_t Count = m_AvailablePages.size() < kRefillCount ? m_AvailablePages.size() : (size_t)kRefillCount;
+                Cache.Pages.insert(Cache.Pages.end(), m_AvailablePages.end() - Count, m_AvailablePages.end());
+                m_AvailablePages.resize(m_AvailablePages.size() - Count);
+            }
+
+            if (Cache.Pages.empty())
+            {
+                PageType* PagePtr = m_Provider.CreatePage(0);
+                std::lock_guard<std::mutex> LockGuard(m_Mutex);
+                m_PagePool.push_back(PagePtr);
+                return PagePtr;
+            }
+
+            PageType* PagePtr = Cache.Pages.back();
+            Cache.Pages.pop_back();
+            return PagePtr;
+        }
+
+        // Single-use pages are not recycled.  Release them with FreeLargePages().
+        PageType* CreateLargePage( size_t PageSize ) { return m_Provider.CreatePage(PageSize); }
+
+        // Discarded pages will get recycled once FenceValue has passed
+        void DiscardPages( uint64_t FenceValue, const std::vector<PageType*>& Pages )
+        {
+            m_RetiredPages.Push(FenceValue, Pages);
+        }
+
+        // Freed pages will be destroyed once FenceValue has passed
+        void FreeLargePages( uint64_t FenceValue, const std::vector<PageType*>& Pages )
+        {
+            std::vector<PageType*> CompletedPages;
+            m_DeletionQueue.Reclaim(m_IsFenceComplete, CompletedPages);
+            for (auto iter = CompletedPages.begin(); iter != CompletedPages.end(); ++iter)
+                m_Provider.DestroyPage(*iter);
+
+            m_DeletionQueue.Push(FenceValue, Pages);
+        }
+
+        // Destroys every page without waiting on fences
+        void Destroy( void )
+        {
+            // Pages cached by every thread become stale
+            m_Epoch.store(NextEpoch(), std::memory_order_release);
+
+            std::vector<PageType*> LargePages;
+            m_DeletionQueue.Reclaim([](uint64_t) { return true; }, LargePages);
+            for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
+                m_Provider.DestroyPage(*iter);
+
+            m_RetiredPages.Clear();
+
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            for (auto iter = m_PagePool.begin(); iter != m_PagePool.end(); ++iter)
+                m_Provider.DestroyPage(*iter);
+            m_PagePool.clear();
+            m_AvailablePages.clear();
+        }
+
+        // Number of recyclable pages created so far
+        size_t GetPageCount( void )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            return m_PagePool.size();
+        }
+
+    private:
+        struct ThreadCache
+        {
+            ThreadCache() : Epoch(0) {}
+            uint64_t Epoch;
+            std::vector<PageType*> Pages;
+        };
+
+        static uint32_t NextSlot( void )
+        {
+            static std::atomic<uint32_t> s_NextSlot(0);
+            return s_NextSlot.fetch_add(1, std::memory_order_relaxed) % kMaxThreadCacheSlots;
+        }
+
+        static uint64_t NextEpoch( void )
+        {
+            static std::atomic<uint64_t> s_NextEpoch(1);
+            return s_NextEpoch.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ThreadCache& GetThreadCache( void )
+        {
+            static thread_local ThreadCache t_Caches[kMaxThreadCacheSlots];
+
+            ThreadCache& Cache = t_Caches[m_Slot];
+            const uint64_t Epoch = m_Epoch.load(std::memory_order_acquire);
+            if (Cache.Epoch != Epoch)
+            {
+                Cache.Pages.clear();
+                Cache.Epoch = Epoch;
+            }
+            return Cache;
+        }
+
+        Provider m_Provider;
+        FenceQuery m_IsFenceComplete;
+        const uint32_t m_Slot;
+        std::atomic<uint64_t> m_Epoch;
+
+        FencedList<PageType*> m_RetiredPages;
+        FencedList<PageType*> m_DeletionQueue;
+
+        // Guards the page pool and the shared free list
+        std::mutex m_Mutex;
+        std::vector<PageType*> m_PagePool;
+        std::vector<PageType*> m_AvailablePages;
+    };
+
+    // Bump allocation of offsets within a fixed size page.  Allocate() fails once the current page is full
+    // and StartPage() must be called after acquiring a new page.
+    class LinearOffsetAllocator
+    {
+    public:
+        enum : size_t { kInvalidOffset = ~(size_t)0 };
+
+        explicit LinearOffsetAllocator( size_t PageSize ) : m_PageSize(PageSize), m_CurOffset(PageSize) {}
+
+        size_t GetPageSize( void ) const { return m_PageSize; }
+        size_t GetUsedSize( void ) const { return m_CurOffset; }
+
+        // Alignment must be a power of two
+        size_t Allocate( size_t AlignedSize, size_t Alignment )
+        {
+            ASSERT((Alignment & (Alignment - 1)) == 0);
+
+            const size_t Offset = (m_CurOffset + Alignment - 1) & ~(Alignment - 1);
+            if (Offset < m_CurOffset || Offset + AlignedSize > m_PageSize)
+                return kInvalidOffset;
+
+            m_CurOffset = Offset + AlignedSize;
+            return Offset;
+        }
+
+        void StartPage( void ) { m_CurOffset = 0; }
+
+        // Leaves no page current so that the next Allocate() fails
+        void EndPage( void ) { m_CurOffset = m_PageSize; }
+
+    private:
+        size_t m_PageSize;
+        size_t m_CurOffset;
+    };
+
+    inline uint32_t CountTrailingZeros64( uint64_t Value )
+    {
+        ASSERT(Value != 0);
+#if defined(_MSC_VER)
+        unsigned long Index;
+        _BitScanForward64(&Index, Value);
+        return (uint32_t)Index;
+#else
+        return (uint32_t)__builtin_ctzll(Value);
+#endif
+    }
+
+    // A bitmap with summary levels above it, one bit per word of the level below, so that the first set
+    // bit is found by reading one word per level.
+    class HierarchicalBitmap
+    {
+    public:
+        enum : size_t { kInvalidIndex = ~(size_t)0 };
+
+        void Resize( size_t NumBits )
+        {
+            m_Levels.clear();
+            do
+            {
+                NumBits = (NumBits + 63) / 64;
+                m_Levels.push_back(std::vector<uint64_t>(NumBits, 0));
+            }
+            while (NumBits > 1);
+        }
+
+        void ClearAll( void )
+        {
+            for (auto iter = m_Levels.begin(); iter != m_Levels.end(); ++iter)
+                std::fill(iter->begin(), iter->end(), 0);
+        }
+
+        bool Test( size_t Index ) const { return (m_Levels[0][Index >> 6] >> (Index & 63) & 1) != 0; }
+
+        bool Any( void ) const { return m_Levels.back()[0] != 0; }
+
+        void Set( size_t Index )
+        {
+            for (size_t Level = 0; Level < m_Levels.size(); ++Level)
+            {
+                uint64_t& Word = m_Levels[Level][Index >> 6];
+                const bool WasEmpty = Word == 0;
+                Word |= (uint64_t)1 << (Index & 63);
+                if (!WasEmpty)
+                    break;
+                Index >>= 6;
+            }
+        }
+
+        void Clear( size_t Index )
+        {
+            for (size_t Level = 0; Level < m_Levels.size(); ++Level)
+            {
+                uint64_t& Word = m_Levels[Level][Index >> 6];
+                Word &= ~((uint64_t)1 << (Index & 63));
+                if (Word != 0)
+                    break;
+                Index >>= 6;
+            }
+        }
+
+        size_t FindFirst( void ) const
+        {
+            if (!Any())
+                return kInvalidIndex;
+
+            size_t Index = 0;
+            for (size_t Level = m_Levels.size(); Level-- > 0; )
+                Index = (Index << 6) + CountTrailingZeros64(m_Levels[Level][Index]);
+            return Index;
+        }
+
+    private:
+        std::vector<std::vector<uint64_t> > m_Levels;   // Finest level first
+    };
+
+    // Occupancy of a sub-allocated range, comparable across allocators.  Sizes are in bytes.
+    struct SubAllocatorStats
+    {
+        size_t TotalSize;
+        size_t AllocatedSize;       // Including padding added by the allocator
+        size_t RequestedSize;       // As asked for by callers
+        size_t LargestFreeBlock;
+        size_t FreeBlockCount;
+        size_t AllocationCount;
+
+        // Fraction of allocated space lost to padding
+        float InternalFragmentation( void ) const
+        {
+            return AllocatedSize == 0 ? 0.0f : 1.0f - (float)RequestedSize / (float)AllocatedSize;
+        }
+
+        // Fraction of free space that cannot serve an allocation as large as all of it
+        float ExternalFragmentation( void ) const
+        {
+            const size_t FreeSize = TotalSize - AllocatedSize;
+            return FreeSize == 0 ? 0.0f : 1.0f - (float)LargestFreeBlock / (float)FreeSize;
+        }
+    };
+
+    // Buddy allocation of power-of-two runs of units.  Offsets and sizes are in units; the caller maps
+    // them onto bytes.  An order N block is 2^N units.  Each order keeps a bitmap of its free blocks and
+    // a mask records which orders have any, so allocating and freeing are a few bit scans with no heap
+    // allocation.  A block is split when its free bit is cleared and its right half's bit is set one
+    // order down, and merged when its buddy's bit is found set on free.
+    class BuddyOrderAllocator
+    {
+    public:
+        enum : size_t { kInvalidOffset = ~(size_t)0 };
+
+        explicit BuddyOrderAllocator( uint32_t MaxOrder )
+            : m_MaxOrder(MaxOrder), m_FreeOrders(0), m_FreeUnits(0), m_FreeBlockCount(0)
+        {
+            ASSERT(MaxOrder < 64);
+            m_FreeBlocks.resize(m_MaxOrder + 1);
+            for (uint32_t Order = 0; Order <= m_MaxOrder; ++Order)
+                m_FreeBlocks[Order].Resize(OrderToUnitSize(m_MaxOrder - Order));
+            Reset();
+        }
+
+        uint32_t GetMaxOrder( void ) const { return m_MaxOrder; }
+
+        void Reset( void )
+        {
+            for (uint32_t Order = 0; Order <= m_MaxOrder; ++Order)
+                m_FreeBlocks[Order].ClearAll();
+            m_FreeOrders = 0;
+            m_FreeUnits = 0;
+            m_FreeBlockCount = 0;
+            MarkFree(m_MaxOrder, 0);
+        }
+
+        size_t GetFreeUnits( void ) const { return m_FreeUnits; }
+        size_t GetFreeBlockCount( void ) const { return m_FreeBlockCount; }
+
+        // Size in units of the largest free block, or 0 when full
+        size_t GetLargestFreeUnits( void ) const
+        {
+            if (m_FreeOrders == 0)
+                return 0;
+
+            uint32_t Order = 63;
+            while ((m_FreeOrders >> Order) == 0)
+                --Order;
+            return OrderToUnitSize(Order);
+        }
+
+        // Returns the unit offset of a free order Order block or kInvalidOffset if none can be found
+        size_t AllocateBlock( uint32_t Order )
+        {
+            if (Order > m_MaxOrder)
+                return kInvalidOffset;
+
+            // Find the smallest free block that is large enough
+            const uint64_t LargeEnough = m_FreeOrders >> Order;
+            if (LargeEnough == 0)
+                return kInvalidOffset;
+
+            const uint32_t FoundOrder = Order + CountTrailingZeros64(LargeEnough);
+            return TakeBlock(FoundOrder, m_FreeBlocks[FoundOrder].FindFirst(), Order);
+        }
+
+        // Like AllocateBlock() but picks the free block with the lowest offset, and fails unless that
+        // offset is below Limit.  Used to move blocks toward the start of the range.
+        size_t AllocateBlockBelow( uint32_t Order, size_t Limit )
+        {
+            if (Order > m_MaxOrder)
+                return kInvalidOffset;
+
+            size_t BestOffset = Limit;
+            uint32_t BestOrder = 0;
+
+            for (uint64_t Orders = m_FreeOrders >> Order; Orders != 0; Orders &= Orders - 1)
+            {
+                const uint32_t FoundOrder = Order + CountTrailingZeros64(Orders);
+                const size_t Offset = m_FreeBlocks[FoundOrder].FindFirst() << FoundOrder;
+                if (Offset < BestOffset)
+                {
+                    BestOffset = Offset;
+                    BestOrder = FoundOrder;
+                }
+            }
+
+            if (BestOffset >= Limit)
+                return kInvalidOffset;
+
+            return TakeBlock(BestOrder, BestOffset >> BestOrder, Order);
+        }
+
+        void DeallocateBlock( size_t Offset, uint32_t Order )
+        {
+            size_t Index = Offset >> Order;
+
+            // Merge with free buddies as far up as possible
+            while (Order < m_MaxOrder && m_FreeBlocks[Order].Test(Index ^ 1))
+            {
+                MarkUsed(Order, Index ^ 1);
+                Index >>= 1;
+                ++Order;
+            }
+
+            MarkFree(Order, Index);
+        }
+
+        static size_t OrderToUnitSize( uint32_t Order ) { return ((size_t)1) << Order; }
+
+    private:
+        // Removes a free block and splits it down to Order, freeing the right half at each level
+        size_t TakeBlock( uint32_t FoundOrder, size_t Index, uint32_t Order )
+        {
+            MarkUsed(FoundOrder, Index);
+
+            const size_t Offset = Index << FoundOrder;
+            while (FoundOrder > Order)
+            {
+                --FoundOrder;
+                MarkFree(FoundOrder, (Offset >> FoundOrder) + 1);
+            }
+
+            return Offset;
+        }
+
+        void MarkFree( uint32_t Order, size_t Index )
+        {
+            m_FreeBlocks[Order].Set(Index);
+            m_FreeOrders |= (uint64_t)1 << Order;
+            m_FreeUnits += OrderToUnitSize(Order);
+            ++m_FreeBlockCount;
+        }
+
+        void MarkUsed( uint32_t Order, size_t Index )
+        {
+            m_FreeBlocks[Order].Clear(Index);
+            if (!m_FreeBlocks[Order].Any())
+                m_FreeOrders &= ~((uint64_t)1 << Order);
+            m_FreeUnits -= OrderToUnitSize(Order);
+            --m_FreeBlockCount;
+        }
+
+        uint32_t m_MaxOrder;
+        uint64_t m_FreeOrders;                          // Bit N is set when an order N block is free
+        size_t m_FreeUnits;
+        size_t m_FreeBlockCount;
+        std::vector<HierarchicalBitmap> m_FreeBlocks;   // Indexed by order, one bit per block
+    };
+
+    // A live block the compaction planner may move.  Tag is passed through to the move untouched.
+    struct DefragBlock
+    {
+        size_t Offset;
+        uint32_t Order;
+        uint32_t Tag;
+    };
+
+    struct DefragMove
+    {
+        uint32_t Tag;
+        size_t SrcOffset;
+        size_t DstOffset;
+        uint32_t Order;
+    };
+
+    // Plans moves of live blocks into the lowest free blocks below them, highest blocks first, until
+    // UnitBudget units are scheduled.  Destinations are allocated from Allocator right away.  Sources
+    // stay allocated and must be freed with DeallocateBlock() once the copies have completed; this
+    // lets the freed space at the top merge into large blocks.  Returns the number of units scheduled.
+    inline size_t PlanBuddyCompaction( BuddyOrderAllocator& Allocator, std::vector<DefragBlock>& Blocks,
+        size_t UnitBudget, std::vector<DefragMove>& Moves )
+    {
+        std::sort(Blocks.begin(), Blocks.end(),
+            [](const DefragBlock& A, const DefragBlock& B) { return A.Offset > B.Offset; });
+
+        size_t Scheduled = 0;
+
+        for (auto iter = Blocks.begin(); iter != Blocks.end(); ++iter)
+        {
+            // Skip blocks over budget; smaller ones further down may still fit
+            const size_t Size = BuddyOrderAllocator::OrderToUnitSize(iter->Order);
+            if (Scheduled + Size > UnitBudget)
+                continue;
+
+            const size_t DstOffset = Allocator.AllocateBlockBelow(iter->Order, iter->Offset);
+            if (DstOffset == BuddyOrderAllocator::kInvalidOffset)
+                continue;
+
+            DefragMove Move = { iter->Tag, iter->Offset, DstOffset, iter->Order };
+            Moves.push_back(Move);
+            Scheduled += Size;
+        }
+
+        return Scheduled;
+    }
+
+    // Two-level segregated fit allocation of byte ranges.  Free blocks are binned by size: the first level
+    // is the power of two below the size and the second level splits each power of two into
+    // kSecondLevelCount linear steps.  A bitmap per level records which bins hold blocks, so finding a
+    // block that fits and returning one are a few bit scans.  Sizes are rounded up to the alignment only,
+    // which keeps internal fragmentation well below that of buddy allocation.  Block records are kept
+    // in a vector and recycled, so the only heap allocation is the occasional growth of that vector.
+    class TLSFOffsetAllocator
+    {
+    public:
+        enum : uint32_t { kInvalidNode = ~0u };
+
+        enum
+        {
+            kSecondLevelBits = 4,
+            kSecondLevelCount = 1 << kSecondLevelBits,
+            kFirstLevelCount = 64 - kSecondLevelBits
+        };
+
+        // Alignment must be a power of two
+        TLSFOffsetAllocator( size_t TotalSize, size_t Alignment ) : m_Alignment(Alignment)
+        {
+            ASSERT(Alignment != 0 && (Alignment & (Alignment - 1)) == 0);
+            m_AlignmentShift = CountTrailingZeros64(Alignment);
+            m_TotalSize = TotalSize & ~(Alignment - 1);
+            Reset();
+        }
+
+        void Reset( void )
+        {
+            m_Nodes.clear();
+            m_UnusedNodes.clear();
+            m_FirstLevelMap = 0;
+            std::fill(m_SecondLevelMap, m_SecondLevelMap + kFirstLevelCount, 0u);
+            std::fill(m_FreeHeads, m_FreeHeads + kFirstLevelCount * kSecondLevelCount, kInvalidNode);
+            m_AllocatedSize = 0;
+            m_FreeBlockCount = 0;
+            m_AllocationCount = 0;
+
+            if (m_TotalSize > 0)
+            {
+                uint32_t Node = NewNode(0, m_TotalSize);
+                InsertFree(Node);
+            }
+        }
+
+        // Returns a node identifying the allocation, or kInvalidNode if no free block is large enough
+        uint32_t Allocate( size_t Size )
+        {
+            Size = RoundUp(Size == 0 ? 1 : Size);
+
+            uint32_t FirstLevel, SecondLevel;
+            if (!MapSearch(Size, FirstLevel, SecondLevel))
+                return kInvalidNode;
+
+            uint32_t SecondLevelMap = FirstLevel < kFirstLevelCount ? m_SecondLevelMap[FirstLevel] & (~0u << SecondLevel) : 0;
+            if (SecondLevelMap == 0)
+            {
+                const uint64_t FirstLevelMap = FirstLevel + 1 < 64 ? m_FirstLevelMap & (~(uint64_t)0 << (FirstLevel + 1)) : 0;
+                if (FirstLevelMap == 0)
+                    return kInvalidNode;
+
+                FirstLevel = CountTrailingZeros64(FirstLevelMap);
+                SecondLevelMap = m_SecondLevelMap[FirstLevel];
+            }
+            SecondLevel = CountTrailingZeros64(SecondLevelMap);
+
+            const uint32_t Node = m_FreeHeads[FirstLevel * kSecondLevelCount + SecondLevel];
+            RemoveFree(Node);
+
+            // Return the tail to the free lists
+            if (m_Nodes[Node].Size > Size)
+            {
+                const uint32_t Remainder = NewNode(m_Nodes[Node].Offset + Size, m_Nodes[Node].Size - Size);
+                m_Nodes[Node].Size = Size;
+                LinkAfter(Node, Remainder);
+                InsertFree(Remainder);
+            }
+
+            m_AllocatedSize += Size;
+            ++m_AllocationCount;
+            return Node;
+        }
+
+        // Freeing the kInvalidNode of a failed Allocate() does nothing
+        void Free( uint32_t Node )
+        {
+            if (Node == kInvalidNode)
+                return;
+
+            ASSERT(Node < m_Nodes.size() && !m_Nodes[Node].IsFree);
+
+            m_AllocatedSize -= m_Nodes[Node].Size;
+            --m_AllocationCount;
+
+            // Coalesce with free neighbors
+            const uint32_t Next = m_Nodes[Node].NextPhys;
+            if (Next != kInvalidNode && m_Nodes[Next].IsFree)
+            {
+                RemoveFree(Next);
+                m_Nodes[Node].Size += m_Nodes[Next].Size;
+                Unlink(Next);
+            }
+
+            const uint32_t Prev = m_Nodes[Node].PrevPhys;
+            if (Prev != kInvalidNode && m_Nodes[Prev].IsFree)
+            {
+                RemoveFree(Prev);
+                m_Nodes[Prev].Size += m_Nodes[Node].Size;
+                Unlink(Node);
+                InsertFree(Prev);
+            }
+            else
+            {
+                InsertFree(Node);
+            }
+        }
+
+        size_t GetOffset( uint32_t Node ) const { return m_Nodes[Node].Offset; }
+        size_t GetSize( uint32_t Node ) const { return m_Nodes[Node].Size; }
+        size_t GetAlignment( void ) const { return m_Alignment; }
+        size_t GetTotalSize( void ) const { return m_TotalSize; }
+
+        // RequestedSize is left for the caller to fill in
+        SubAllocatorStats GetStats( void ) const
+        {
+            SubAllocatorStats Stats = {};
+            Stats.TotalSize = m_TotalSize;
+            Stats.AllocatedSize = m_AllocatedSize;
+            Stats.RequestedSize = m_AllocatedSize;
+            Stats.FreeBlockCount = m_FreeBlockCount;
+            Stats.AllocationCount = m_AllocationCount;
+
+            // The largest block is in the highest non-empty bin
+            if (m_FirstLevelMap != 0)
+            {
+                uint32_t FirstLevel = 63;
+                while ((m_FirstLevelMap >> FirstLevel) == 0)
+                    --FirstLevel;
+                uint32_t SecondLevel = kSecondLevelCount - 1;
+                while ((m_SecondLevelMap[FirstLevel] >> SecondLevel) == 0)
+                    --SecondLevel;
+
+                for (uint32_t Node = m_FreeHeads[FirstLevel * kSecondLevelCount + SecondLevel];
+                    Node != kInvalidNode; Node = m_Nodes[Node].NextFree)
+                {
+                    Stats.LargestFreeBlock = (std::max)(Stats.LargestFreeBlock, m_Nodes[Node].Size);
+                }
+            }
+
+            return Stats;
+        }
+
+    private:
+        struct Node
+        {
+            size_t Offset;
+            size_t Size;
+            uint32_t PrevPhys, NextPhys;    // Address-ordered neighbors
+            uint32_t PrevFree, NextFree;    // Bin list links while free
+            bool IsFree;
+        };
+
+        size_t RoundUp( size_t Size ) const { return (Size + m_Alignment - 1) & ~(m_Alignment - 1); }
+
+        static uint32_t Log2Floor( size_t Value )
+        {
+            uint32_t Bit = 63;
+            while (((uint64_t)Value >> Bit) == 0)
+                --Bit;
+            return Bit;
+        }
+
+        // The bin a free block of this size belongs in
+        void MapInsert( size_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel ) const
+        {
+            const size_t Units = Size >> m_AlignmentShift;
+            if (Units < kSecondLevelCount)
+            {
+                FirstLevel = 0;
+                SecondLevel = (uint32_t)Units;
+            }
+            else
+            {
+                const uint32_t Log2 = Log2Floor(Units);
+                FirstLevel = Log2 - kSecondLevelBits + 1;
+                SecondLevel = (uint32_t)(Units >> (Log2 - kSecondLevelBits)) ^ kSecondLevelCount;
+            }
+        }
+
+        // The first bin whose blocks are all at least this large
+        bool MapSearch( size_t Size, uint32_t& FirstLevel, uint32_t& SecondLevel ) const
+        {
+            size_t Units = Size >> m_AlignmentShift;
+            if (Units >= kSecondLevelCount)
+            {
+                const size_t Round = ((size_t)1 << (Log2Floor(Units) - kSecondLevelBits)) - 1;
+                if (Units + Round < Units)
+                    return false;
+                Units += Round;
+            }
+            MapInsert(Units << m_AlignmentShift, FirstLevel, SecondLevel);
+            return FirstLevel < kFirstLevelCount;
+        }
+
+        uint32_t NewNode( size_t Offset, size_t Size )
+        {
+            uint32_t Index;
+            if (!m_UnusedNodes.empty())
+            {
+                Index = m_UnusedNodes.back();
+                m_UnusedNodes.pop_back();
+            }
+            else
+            {
+                Index = (uint32_t)m_Nodes.size();
+                m_Nodes.push_back(Node());
+            }
+
+            Node& N = m_Nodes[Index];
+            N.Offset = Offset;
+            N.Size = Size;
+            N.PrevPhys = N.NextPhys = kInvalidNode;
+            N.PrevFree = N.NextFree = kInvalidNode;
+            N.IsFree = false;
+            return Index;
+        }
+
+        void LinkAfter( uint32_t Index, uint32_t NewIndex )
+        {
+            const uint32_t Next = m_Nodes[Index].NextPhys;
+            m_Nodes[NewIndex].PrevPhys = Index;
+            m_Nodes[NewIndex].NextPhys = Next;
+            m_Nodes[Index].NextPhys = NewIndex;
+            if (Next != kInvalidNode)
+                m_Nodes[Next].PrevPhys = NewIndex;
+        }
+
+        // Removes a node from the address-ordered list and recycles it
+        void Unlink( uint32_t Index )
+        {
+            const uint32_t Prev = m_Nodes[Index].PrevPhys;
+            const uint32_t Next = m_Nodes[Index].NextPhys;
+            if (Prev != kInvalidNode)
+                m_Nodes[Prev].NextPhys = Next;
+            if (Next != kInvalidNode)
+                m_Nodes[Next].PrevPhys = Prev;
+            m_UnusedNodes.push_back(Index);
+        }
+
+        void InsertFree( uint32_t Index )
+        {
+            uint32_t FirstLevel, SecondLevel;
+            MapInsert(m_Nodes[Index].Size, FirstLevel, SecondLevel);
+
+            uint32_t& Head = m_FreeHeads[FirstLevel * kSecondLevelCount + SecondLevel];
+            m_Nodes[Index].IsFree = true;
+            m_Nodes[Index].PrevFree = kInvalidNode;
+            m_Nodes[Index].NextFree = Head;
+            if (Head != kInvalidNode)
+                m_Nodes[Head].PrevFree = Index;
+            Head = Index;
+
+            m_FirstLevelMap |= (uint64_t)1 << FirstLevel;
+            m_SecondLevelMap[FirstLevel] |= 1u << SecondLevel;
+            ++m_FreeBlockCount;
+        }
+
+        void RemoveFree( uint32_t Index )
+        {
+            uint32_t FirstLevel, SecondLevel;
+            MapInsert(m_Nodes[Index].Size, FirstLevel, SecondLevel);
+
+            Node& N = m_Nodes[Index];
+            if (N.PrevFree != kInvalidNode)
+                m_Nodes[N.PrevFree].NextFree = N.NextFree;
+            else
+                m_FreeHeads[FirstLevel * kSecondLevelCount + SecondLevel] = N.NextFree;
+            if (N.NextFree != kInvalidNode)
+                m_Nodes[N.NextFree].PrevFree = N.PrevFree;
+            N.IsFree = false;
+
+            if (m_FreeHeads[FirstLevel * kSecondLevelCount + SecondLevel] == kInvalidNode)
+            {
+                m_SecondLevelMap[FirstLevel] &= ~(1u << SecondLevel);
+                if (m_SecondLevelMap[FirstLevel] == 0)
+                    m_FirstLevelMap &= ~((uint64_t)1 << FirstLevel);
+            }
+            --m_FreeBlockCount;
+        }
+
+        size_t m_Alignment;
+        uint32_t m_AlignmentShift;
+        size_t m_TotalSize;
+
+        uint64_t m_FirstLevelMap;
+        uint32_t m_SecondLevelMap[kFirstLevelCount];
+        uint32_t m_FreeHeads[kFirstLevelCount * kSecondLevelCount];
+
+        std::vector<Node> m_Nodes;
+        std::vector<uint32_t> m_UnusedNodes;
+
+        size_t m_AllocatedSize;
+        size_t m_FreeBlockCount;
+        size_t m_AllocationCount;
+    };
+
+    // Recycles objects once the fence they were retired with has passed.  Retired objects are kept in
+    // shards picked per thread.  A request takes any completed object from its own shard, then tries the
+    // other shards, and only creates a new object when none has completed, so one slow fence at the head
+    // doesn't hide the ready objects behind it.  Each shard is guarded by a spin lock that is uncontended
+    // while no more threads than shards use the pool.
+    //
+    // Callers report how much each use consumed, in any unit that tracks the object's memory.  The pool
+    // keeps a high-water mark per object and a running average over all uses.  Objects whose high-water
+    // mark is kTrimFactor times the average are destroyed when their fence completes instead of being
+    // recycled, as are completed objects beyond kMaxIdlePerShard.
+    //
+    // A provider supplies:
+    //     typedef ... ObjectType;
+    //     ObjectType* Create( size_t Index );
+    //     void Reset( ObjectType* Object );         // Called before a recycled object is handed out
+    //     void Destroy( ObjectType* Object );
+    template <typename Provider>
+    class FencedObjectPool
+    {
+    public:
+        typedef typename Provider::ObjectType ObjectType;
+
+        enum : uint64_t
+        {
+            kNumShards = 8,
+            kMaxIdlePerShard = 8,
+            kTrimFactor = 4,
+            kMinTrimUsage = 1024,   // The average is never taken to be below this
+        };
+
+        struct PoolStats
+        {
+            size_t Created;
+            size_t Recycled;
+            size_t Trimmed;
+            size_t Live;
+            uint64_t AverageUsage;
+        };
+
+        explicit FencedObjectPool( const Provider& ObjectProvider = Provider() ) :
+            m_Provider(ObjectProvider), m_AverageUsage(0), m_NumCreated(0), m_NumRecycled(0), m_NumTrimmed(0) {}
+        ~FencedObjectPool() { Shutdown(); }
+
+        Provider& GetProvider( void ) { return m_Provider; }
+
+        template <typename FenceQuery>
+        ObjectType* Request( const FenceQuery& IsFenceComplete )
+        {
+            const uint32_t Home = GetShardIndex();
+            Entry Found = {};
+            bool Recycled = false;
+
+            // Never wait on another thread's shard; creating an object is cheaper than stalling
+            for (uint32_t i = 0; i < kNumShards && !Recycled; ++i)
+            {
+                Shard& Candidate = m_Shards[(Home + i) % kNumShards];
+                if (i == 0)
+                    Candidate.Lock();
+                else if (!Candidate.TryLock())
+                    continue;
+                Recycled = TakeCompleted(Candidate, IsFenceComplete, Found);
+                Candidate.Unlock();
+            }
+
+            if (Recycled)
+            {
+                m_Provider.Reset(Found.Object);
+                m_NumRecycled.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                Found.Object = CreateObject();
+                Found.HighWater = 0;
+            }
+
+            Shard& Owner = m_Shards[Home];
+            Owner.Lock();
+            Owner.Outstanding.push_back(Found);
+            Owner.Unlock();
+
+            return Found.Object;
+        }
+
+        void Discard( uint64_t FenceValue, ObjectType* Object, uint64_t Usage = 0 )
+        {
+            const uint32_t Home = GetShardIndex();
+            Entry Retiring = {};
+
+            // Usually discarded by the thread that requested it, so the entry is in this shard
+            bool Found = false;
+            for (uint32_t i = 0; i < kNumShards && !Found; ++i)
+            {
+                Shard& Candidate = m_Shards[(Home + i) % kNumShards];
+                Candidate.Lock();
+                Found = TakeOutstanding(Candidate, Object, Retiring);
+                Candidate.Unlock();
+            }
+            ASSERT(Found);   // Discarding an object this pool didn't hand out
+
+            const uint64_t Average = UpdateAverage(Usage);
+            Retiring.Object = Object;
+            Retiring.FenceValue = FenceValue;
+            Retiring.HighWater = (std::max)(Retiring.HighWater, Usage);
+            Retiring.Trim = Retiring.HighWater > kTrimFactor * (std::max)(Average, (uint64_t)kMinTrimUsage);
+
+            Shard& Owner = m_Shards[Home];
+            Owner.Lock();
+            Owner.Retired.push_back(Retiring);
+            Owner.Unlock();
+        }
+
+        void Shutdown( void )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            for (size_t i = 0; i < m_Pool.size(); ++i)
+                m_Provider.Destroy(m_Pool[i]);
+            m_Pool.clear();
+
+            for (uint32_t i = 0; i < kNumShards; ++i)
+            {
+                m_Shards[i].Lock();
+                m_Shards[i].Retired.clear();
+                m_Shards[i].Outstanding.clear();
+                m_Shards[i].Unlock();
+            }
+        }
+
+        size_t Size( void )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            return m_Pool.size();
+        }
+
+        PoolStats GetStats( void )
+        {
+            PoolStats Stats;
+            Stats.Created = m_NumCreated.load(std::memory_order_relaxed);
+            Stats.Recycled = m_NumRecycled.load(std::memory_order_relaxed);
+            Stats.Trimmed = m_NumTrimmed.load(std::memory_order_relaxed);
+            Stats.Live = Size();
+            Stats.AverageUsage = m_AverageUsage.load(std::memory_order_relaxed);
+            return Stats;
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t FenceValue;
+            ObjectType* Object;
+            uint64_t HighWater;
+            bool Trim;
+        };
+
+        struct Shard
+        {
+            Shard() : m_Busy(false) {}
+
+            void Lock( void )
+            {
+                while (m_Busy.exchange(true, std::memory_order_acquire))
+                    std::this_thread::yield();
+            }
+
+            bool TryLock( void ) { return !m_Busy.exchange(true, std::memory_order_acquire); }
+            void Unlock( void ) { m_Busy.store(false, std::memory_order_release); }
+
+            std::atomic<bool> m_Busy;
+            std::vector<Entry> Retired;
+            std::vector<Entry> Outstanding;
+        };
+
+        // Threads are spread over the shards in the order they first touch any pool
+        static uint32_t GetShardIndex( void )
+        {
+            static std::atomic<uint32_t> s_NextThread(0);
+            static thread_local uint32_t t_Shard = s_NextThread.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+            return t_Shard;
+        }
+
+        // Takes the first completed object that isn't marked for trimming.  Along the way, completed
+        // objects that are marked, or that exceed the idle limit, are destroyed.  Shard must be locked.
+        template <typename FenceQuery>
+        bool TakeCompleted( Shard& S, const FenceQuery& IsFenceComplete, Entry& Found )
+        {
+            bool Taken = false;
+            size_t NumIdle = 0;
+
+            for (size_t i = 0; i < S.Retired.size(); )
+            {
+                Entry& Candidate = S.Retired[i];
+                if (!IsFenceComplete(Candidate.FenceValue))
+                {
+                    ++i;
+                    continue;
+                }
+
+                if (Candidate.Trim || (Taken && ++NumIdle > kMaxIdlePerShard))
+                    DestroyObject(Candidate.Object);
+                else if (!Taken)
+                {
+                    Found = Candidate;
+                    Taken = true;
+                }
+                else
+                {
+                    ++i;
+                    continue;
+                }
+
+                Candidate = S.Retired.back();
+                S.Retired.pop_back();
+            }
+
+            return Taken;
+        }
+
+        // Shard must be locked
+        static bool TakeOutstanding( Shard& S, ObjectType* Object, Entry& Found )
+        {
+            for (size_t i = S.Outstanding.size(); i-- > 0; )
+            {
+                if (S.Outstanding[i].Object == Object)
+                {
+                    Found = S.Outstanding[i];
+                    S.Outstanding[i] = S.Outstanding.back();
+                    S.Outstanding.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Folds one use into the running average and returns the average before it
+        uint64_t UpdateAverage( uint64_t Usage )
+        {
+            uint64_t Average = m_AverageUsage.load(std::memory_order_relaxed);
+            uint64_t NewAverage;
+            do
+            {
+                NewAverage = Average == 0 ? Usage : Average - Average / 16 + Usage / 16;
+            }
+            while (!m_AverageUsage.compare_exchange_weak(Average, NewAverage, std::memory_order_relaxed));
+            return Average;
+        }
+
+        ObjectType* CreateObject( void )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            ObjectType* Object = m_Provider.Create(m_NumCreated.fetch_add(1, std::memory_order_relaxed));
+            m_Pool.push_back(Object);
+            return Object;
+        }
+
+        void DestroyObject( ObjectType* Object )
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            auto Iter = std::find(m_Pool.begin(), m_Pool.end(), Object);
+            ASSERT(Iter != m_Pool.end());
+            *Iter = m_Pool.back();
+            m_Pool.pop_back();
+            m_Provider.Destroy(Object);
+            m_NumTrimmed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Provider m_Provider;
+        Shard m_Shards[kNumShards];
+        std::atomic<uint64_t> m_AverageUsage;
+        std::atomic<size_t> m_NumCreated;
+        std::atomic<size_t> m_NumRecycled;
+        std::atomic<size_t> m_NumTrimmed;
+
+        // Every live object, touched only when objects are created or destroyed
+        std::vector<ObjectType*> m_Pool;
+        std::mutex m_Mutex;
+    };
+
+    // A page of host memory, laid out like LinearAllocationPage where the allocators look at it
+    struct HostPage
+    {
+        explicit HostPage( size_t PageSize ) : m_Size(PageSize)
+        {
+            m_CpuVirtualAddress = std::malloc(PageSize);
+            m_GpuVirtualAddress = (uint64_t)(uintptr_t)m_CpuVirtualAddress;
+        }
+
+        ~HostPage() { std::free(m_CpuVirtualAddress); }
+
+        void* m_CpuVirtualAddress;
+        uint64_t m_GpuVirtualAddress;
+        size_t m_Size;
+
+    private:
+        HostPage( const HostPage& );
+        HostPage& operator=( const HostPage& );
+    };
+
+    // Backs pages with malloc
+    class HostMemoryProvider
+    {
+    public:
+        typedef HostPage PageType;
+
+        explicit HostMemoryProvider( size_t DefaultPageSize ) : m_DefaultPageSize(DefaultPageSize) {}
+
+        PageType* CreatePage( size_t PageSize )
+        {
+            return new HostPage(PageSize == 0 ? m_DefaultPageSize : PageSize);
+        }
+
+        void DestroyPage( PageType* Page ) { delete Page; }
+
+    private:
+        size_t m_DefaultPageSize;
+    };
+
+    // A fence advanced by hand.  Pass a pointer to it wrapped in a lambda, or std::cref(), as the fence
+    // query of the pools above.
+    class HostFence
+    {
+    public:
+        HostFence() : m_NextValue(1), m_CompletedValue(0) {}
+
+        // Returns the value that will be completed once the work submitted so far finishes
+        uint64_t Signal( void ) { return m_NextValue.fetch_add(1, std::memory_order_relaxed); }
+
+        void Complete( uint64_t FenceValue )
+        {
+            uint64_t Completed = m_CompletedValue.load(std::memory_order_relaxed);
+            while (Completed < FenceValue && !m_CompletedValue.compare_exchange_weak(Completed, FenceValue,
+                std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        uint64_t GetCompletedValue( void ) const { return m_CompletedValue.load(std::memory_order_acquire); }
+
+        bool operator()( uint64_t FenceValue ) const { return FenceValue <= GetCompletedValue(); }
+
+    private:
+        std::atomic<uint64_t> m_NextValue;
+        std::atomic<uint64_t> m_CompletedValue;
+    };
+
+} // namespace AllocatorCore
@@ -27,6 +27,7 @@ BuddyBlock::BuddyBlock(uint32_t heapOffset, uint32_t totalSize, uint32_t unpadde
     , m_fenceValue(0)
     , m_size(totalSize)
     , m_unpaddedSize(unpaddedSize)
+    , m_allocatorNode(~0u)
 {};
 
 void BuddyBlock::InitPlaced(ID3D12Heap* pBackingHeap, uint32_t numElements, uint32_t elementSize, const void* initialData)
@@ -60,6 +61,9 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
     , m_baseOffset(baseOffset)
     , m_maxBlockSize(maxBlockSize)
     , m_minBlockSize(MinBlockSize)
+    , m_Blocks(Math::Log2((maxBlockSize + MinBlockSize - 1) / MinBlockSize))
+    , m_requestedSize(0)
+    , m_allocationCount(0)
     , m_pBackingHeap(nullptr)
 #if defined(PROFILE) || defined(_DEBUG)
     , m_SpaceUsed(0)
@@ -68,10 +72,6 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
 {
     ASSERT(Math::IsDivisible(maxBlockSize, m_minBlockSize));
     ASSERT(Math::IsPowerOfTwo(maxBlockSize / m_minBlockSize));
-
-    m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
-
-    Reset();
 }
 
 void BuddyAllocator::Initialize()
@@ -103,118 +103,80 @@ void BuddyAllocator::Destroy()
     else
     {
         m_BackingResource.Destroy();
+        m_defragScratch.Destroy();
     }
 }
 
-size_t BuddyAllocator::AllocateBlock(UINT order)
+BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
 {
-    size_t offset;
-
-    if (order > m_maxOrder)
-    {
-        throw(std::bad_alloc()); // Can't allocate a block that large  
-    }
+    size_t size = numElements * elementSize;
+    size_t unitSize = SizeToUnitSize(size);
+    UINT order = UnitSizeToOrder(unitSize);
 
-    auto it = m_freeBlocks[order].begin();
+    size_t offset = m_Blocks.AllocateBlock(order);
 
-    if (it == m_freeBlocks[order].end())
-    {
-        // No free nodes in the requested pool.  Try to find a higher-order block and split it.  
-        size_t left = AllocateBlock(order + 1);
+    // There are no blocks available for the requested size so  
+    // return the NULL block type  
+    if (offset == AllocatorCore::BuddyOrderAllocator::kInvalidOffset)
+        return new BuddyBlock();
 
-        size_t size = OrderToUnitSize(order);
+    uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
 
-        size_t right = left + size;
+    uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
 
-        m_freeBlocks[order].insert(right); // Add the right block to the free pool  
+    INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
+    INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
+    m_requestedSize += size;
+    ++m_allocationCount;
 
-        offset = left; // Return the left block  
+    BuddyBlock* pBlock = new BuddyBlock(blockOffset, //offset
+        paddedSize, //total size (padded to fit a block)
+        numElements * elementSize);
+        
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
+    {
+        pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
     }
-
     else
     {
-        offset = *it;
-
-        // Remove the block from the free list  
-        m_freeBlocks[order].erase(it);
+        //TODO: To be truely thread-safe this operation should be atomic to guard against
+        //      the case in which blocks from this allocator are used on multiple threads 
+        //      (because it's really only 1 resource underneath)
+        pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
     }
 
-    return offset;
-}
-
-void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
-{
-    // See if the buddy block is free  
-    size_t size = OrderToUnitSize(order);
-
-    size_t buddy = GetBuddyOffset(offset, size);
+    pBlock->m_allocatorNode = uint32_t(m_liveBlocks.size());
+    m_liveBlocks.push_back(pBlock);
 
-    auto it = m_freeBlocks[order].find(buddy);
-
-    if (it != m_freeBlocks[order].end())
-    {
-        // Deallocate merged blocks  
-        DeallocateBlock(min(offset, buddy), order + 1);
-        // Remove the buddy from the free list  
-        m_freeBlocks[order].erase(it);
-    }
-    else
-    {
-        // Add the block to the free list  
-        m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
-    }
+    return pBlock;
 }
 
-BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
+void BuddyAllocator::Deallocate(BuddyBlock* pBlock)
 {
-    size_t size = numElements * elementSize;
-    size_t unitSize = SizeToUnitSize(size);
-    UINT order = UnitSizeToOrder(unitSize);
-
-    try
+    // The null block returned by a failed Allocate() owns no range
+    if (pBlock->m_allocatorNode == ~0u)
     {
-        size_t offset = AllocateBlock(order);
-        uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
-
-        uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
-
-        INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
-        INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
-
-        BuddyBlock* pBlock = new BuddyBlock(blockOffset, //offset
-            paddedSize, //total size (padded to fit a block)
-            numElements * elementSize);
-            
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
-        }
-        else
-        {
-            //TODO: To be truely thread-safe this operation should be atomic to guard against
-            //      the case in which blocks from this allocator are used on multiple threads 
-            //      (because it's really only 1 resource underneath)
-            pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
-        }
-
-        return pBlock;
+        ASSERT(pBlock->GetSize() == 0);
+        delete pBlock;
+        return;
     }
 
-    catch (std::bad_alloc&)
-    {
-        // There are no blocks available for the requested size so  
-        // return the NULL block type  
-        return new BuddyBlock();
-    }
+    RemoveLiveBlock(pBlock);
+
+    pBlock->m_fenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    m_deferredDeletionQueue.push(pBlock);
 }
 
-/*
-void BuddyAllocator::Deallocate(BuddyBlock* pBlock)
+void BuddyAllocator::RemoveLiveBlock(BuddyBlock* pBlock)
 {
-    pBlock->m_fenceValue = g_CommandManager.GetNextFenceValue();
-    m_deferredDeletionQueue.push(pBlock);
+    ASSERT(pBlock->m_allocatorNode < m_liveBlocks.size() && m_liveBlocks[pBlock->m_allocatorNode] == pBlock);
+
+    BuddyBlock* pLast = m_liveBlocks.back();
+    pLast->m_allocatorNode = pBlock->m_allocatorNode;
+    m_liveBlocks[pBlock->m_allocatorNode] = pLast;
+    m_liveBlocks.pop_back();
+    pBlock->m_allocatorNode = ~0u;
 }
-*/
 
 void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 {
@@ -226,31 +188,33 @@ void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 
     UINT order = UnitSizeToOrder(size);
 
-    try
-    {
-        DeallocateBlock(offset, order); // throw(std::bad_alloc)
+    m_Blocks.DeallocateBlock(offset, order);
 
-        DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
-        DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
-        
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            // Release the resource
-            pBlock->Destroy();
-        }
-        delete(pBlock);
-    }
+    DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
+    DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
+    m_requestedSize -= pBlock->m_unpaddedSize;
+    --m_allocationCount;
 
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate failed trying to add the free block to the pool  
-        // resulting in a leak.  Unfortunately there is not much we can do.  
-        // Fortunately this is expected to be extremely rare as the storage  
-        // needed for each deallocate is very small.  
+        // Release the resource
+        pBlock->Destroy();
     }
+    delete(pBlock);
 };
 
-/*
+AllocatorCore::SubAllocatorStats BuddyAllocator::GetStats() const
+{
+    AllocatorCore::SubAllocatorStats stats = {};
+    stats.TotalSize = m_maxBlockSize;
+    stats.AllocatedSize = m_maxBlockSize - m_Blocks.GetFreeUnits() * m_minBlockSize;
+    stats.RequestedSize = m_requestedSize;
+    stats.LargestFreeBlock = m_Blocks.GetLargestFreeUnits() * m_minBlockSize;
+    stats.FreeBlockCount = m_Blocks.GetFreeBlockCount();
+    stats.AllocationCount = m_allocationCount;
+    return stats;
+}
+
 void BuddyAllocator::CleanUpAllocations()
 {
     while (m_deferredDeletionQueue.empty() == false &&
@@ -261,4 +225,126 @@ void BuddyAllocator::CleanUpAllocations()
 
         DeallocateInternal(pBlock);
     }
-}*/
+
+    while (m_movedSourceQueue.empty() == false &&
+        g_CommandManager.IsFenceComplete(m_movedSourceQueue.front().fenceValue))
+    {
+        MovedBlockSource& source = m_movedSourceQueue.front();
+
+        m_Blocks.DeallocateBlock(source.unitOffset, source.order);
+        if (source.pOldBuffer != nullptr)
+        {
+            source.pOldBuffer->Destroy();
+            delete source.pOldBuffer;
+        }
+
+        m_movedSourceQueue.pop();
+    }
+}
+
+size_t BuddyAllocator::Defragment(size_t byteBudget)
+{
+    // Upload and readback heaps are locked in one resource state, so their blocks can't be copy targets
+    if (m_heapType != D3D12_HEAP_TYPE_DEFAULT)
+        return 0;
+
+    vector<AllocatorCore::DefragBlock> candidates;
+    for (size_t i = 0; i < m_liveBlocks.size(); ++i)
+    {
+        const BuddyBlock* pBlock = m_liveBlocks[i];
+        if (!pBlock->m_onRelocate)
+            continue;
+
+        AllocatorCore::DefragBlock candidate;
+        candidate.Offset = SizeToUnitSize(pBlock->GetOffset() - m_baseOffset);
+        candidate.Order = UnitSizeToOrder(SizeToUnitSize(pBlock->GetSize()));
+        candidate.Tag = uint32_t(i);
+        candidates.push_back(candidate);
+    }
+
+    vector<AllocatorCore::DefragMove> moves;
+    const size_t unitsMoved = AllocatorCore::PlanBuddyCompaction(m_Blocks, candidates, byteBudget / m_minBlockSize, moves);
+    if (moves.empty())
+        return 0;
+
+    CommandContext& context = CommandContext::Begin(L"Buddy Allocator Defragment");
+
+    vector<ByteAddressBuffer*> newBuffers(moves.size(), nullptr);
+
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
+    {
+        // Each block is its own resource, so copy straight into a new one placed at the destination
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            BuddyBlock& block = *m_liveBlocks[moves[i].Tag];
+            ByteAddressBuffer* pNewBuffer = new ByteAddressBuffer();
+            pNewBuffer->CreatePlaced(L"Buddy Block", m_pBackingHeap, uint32_t(m_baseOffset + moves[i].DstOffset * m_minBlockSize),
+                block.m_pBuffer->GetElementCount(), block.m_pBuffer->GetElementSize());
+
+            context.TransitionResource(*block.m_pBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            context.TransitionResource(*pNewBuffer, D3D12_RESOURCE_STATE_COPY_DEST, true);
+            context.CopyBufferRegion(*pNewBuffer, 0, *block.m_pBuffer, 0, pNewBuffer->GetBufferSize());
+            context.TransitionResource(*pNewBuffer, D3D12_RESOURCE_STATE_GENERIC_READ);
+            newBuffers[i] = pNewBuffer;
+        }
+    }
+    else
+    {
+        // A resource cannot be a copy source and destination at once, so stage through a scratch buffer
+        size_t scratchSize = 0;
+        for (size_t i = 0; i < moves.size(); ++i)
+            scratchSize += m_liveBlocks[moves[i].Tag]->m_unpaddedSize;
+
+        if (m_defragScratch.GetBufferSize() < scratchSize)
+        {
+            // Earlier copies may still read the old scratch buffer.  This only happens when the budget grows.
+            g_CommandManager.IdleGPU();
+            m_defragScratch.Destroy();
+            m_defragScratch.Create(L"Buddy Allocator Defragment Scratch", uint32_t(Math::AlignUp(scratchSize, 4) / 4), 4);
+        }
+
+        context.TransitionResource(m_BackingResource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        context.TransitionResource(m_defragScratch, D3D12_RESOURCE_STATE_COPY_DEST, true);
+        size_t scratchOffset = 0;
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            const BuddyBlock& block = *m_liveBlocks[moves[i].Tag];
+            context.CopyBufferRegion(m_defragScratch, scratchOffset, m_BackingResource, block.GetOffset(), block.m_unpaddedSize);
+            scratchOffset += block.m_unpaddedSize;
+        }
+
+        context.TransitionResource(m_BackingResource, D3D12_RESOURCE_STATE_COPY_DEST);
+        context.TransitionResource(m_defragScratch, D3D12_RESOURCE_STATE_COPY_SOURCE, true);
+        scratchOffset = 0;
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            const BuddyBlock& block = *m_liveBlocks[moves[i].Tag];
+            context.CopyBufferRegion(m_BackingResource, m_baseOffset + moves[i].DstOffset * m_minBlockSize, m_defragScratch, scratchOffset, block.m_unpaddedSize);
+            scratchOffset += block.m_unpaddedSize;
+        }
+
+        context.TransitionResource(m_BackingResource, D3D12_RESOURCE_STATE_GENERIC_READ);
+    }
+
+    const uint64_t fenceValue = context.Finish();
+
+    for (size_t i = 0; i < moves.size(); ++i)
+    {
+        BuddyBlock& block = *m_liveBlocks[moves[i].Tag];
+
+        MovedBlockSource source;
+        source.fenceValue = fenceValue;
+        source.unitOffset = moves[i].SrcOffset;
+        source.order = moves[i].Order;
+        source.pOldBuffer = newBuffers[i] != nullptr ? block.m_pBuffer : nullptr;
+        m_movedSourceQueue.push(source);
+
+        block.m_offset = m_baseOffset + moves[i].DstOffset * m_minBlockSize;
+        if (newBuffers[i] != nullptr)
+            block.m_pBuffer = newBuffers[i];
+
+        block.m_onRelocate(block);
+    }
+
+    return unitsMoved * m_minBlockSize;
+}
@@ -21,10 +21,11 @@
 #pragma once
 
 #include "GpuBuffer.h"
+#include "AllocatorCore.h"
 #include <vector>
 #include <queue>
 #include <mutex>
-#include <set>
+#include <functional>
 
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
@@ -60,11 +61,16 @@ struct BuddyBlock
     size_t m_size;
     size_t m_unpaddedSize;
     uint64_t m_fenceValue;
+    uint32_t m_allocatorNode;   // Allocator-specific handle, used by TLSFAllocator
+
+    // Called after BuddyAllocator::Defragment() moves the block so the owner can rebuild its views.
+    // Blocks without one are never moved.
+    std::function<void(BuddyBlock&)> m_onRelocate;
 
     inline size_t GetOffset() const { return m_offset; }
     inline size_t GetSize() const { return m_size; }
 
-    BuddyBlock() : m_pBuffer(nullptr), m_pBackingHeap(nullptr), m_offset(0), m_size(0), m_unpaddedSize(0), m_fenceValue(0) {};
+    BuddyBlock() : m_pBuffer(nullptr), m_pBackingHeap(nullptr), m_offset(0), m_size(0), m_unpaddedSize(0), m_fenceValue(0), m_allocatorNode(~0u) {};
 
     BuddyBlock(uint32_t heapOffset, uint32_t totalSize, uint32_t unpaddedSize);
 
@@ -96,16 +102,21 @@ public:
 
     inline void Reset()
     {
-        // Clear the free blocks collection  
-        m_freeBlocks.clear();
-
         // Initialize the pool with a free inner block of max inner block size  
-        m_freeBlocks.resize(m_maxOrder + 1);
-        m_freeBlocks[m_maxOrder].insert((size_t)0);
+        m_Blocks.Reset();
     }
 
     void CleanUpAllocations();
 
+    // Occupancy for comparison with other sub-allocation strategies
+    AllocatorCore::SubAllocatorStats GetStats() const;
+
+    // Moves relocatable blocks toward the start of the heap, copying at most byteBudget bytes, so that
+    // freed space merges into large blocks.  Call once per frame while no command lists that use the
+    // blocks are being recorded.  The vacated ranges are released by CleanUpAllocations() once the
+    // copies have completed.  Only default heaps are compacted.  Returns the number of bytes scheduled.
+    size_t Defragment(size_t byteBudget);
+
 private:
     ID3D12Heap* m_pBackingHeap;
     ByteAddressBuffer m_BackingResource;
@@ -113,12 +124,31 @@ private:
     const D3D12_HEAP_TYPE m_heapType;
 
     std::queue<BuddyBlock*> m_deferredDeletionQueue;
-    std::vector<std::set<size_t>> m_freeBlocks;
-    UINT m_maxOrder;
+
+    // Live blocks, indexed by BuddyBlock::m_allocatorNode
+    std::vector<BuddyBlock*> m_liveBlocks;
+
+    // Ranges vacated by Defragment() that the GPU may still be copying from
+    struct MovedBlockSource
+    {
+        uint64_t fenceValue;
+        size_t unitOffset;
+        UINT order;
+        ByteAddressBuffer* pOldBuffer;  // Placed strategy only
+    };
+    std::queue<MovedBlockSource> m_movedSourceQueue;
+
+    // Staging for copies within the single backing resource of the manual strategy
+    ByteAddressBuffer m_defragScratch;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
     const size_t m_minBlockSize;
 
+    // Free block bookkeeping in units of m_minBlockSize
+    AllocatorCore::BuddyOrderAllocator m_Blocks;
+    size_t m_requestedSize;
+    size_t m_allocationCount;
+
     const kBuddyAllocationStrategy m_allocationStrategy;
 
     inline size_t SizeToUnitSize(size_t size) const
@@ -131,16 +161,10 @@ private:
         return Math::Log2(size); // Log2 rounds up fractions to next whole value
     }
 
-    inline size_t GetBuddyOffset(const size_t &offset, const size_t &size)
-    {
-        return offset ^ size;
-    }
-
     void DeallocateInternal(BuddyBlock* pBlock);
+    void RemoveLiveBlock(BuddyBlock* pBlock);
 
-    size_t OrderToUnitSize(UINT order) const { return ((size_t)1) << order; }
-    size_t AllocateBlock(UINT order);
-    void DeallocateBlock(size_t offset, UINT order);
+    size_t OrderToUnitSize(UINT order) const { return AllocatorCore::BuddyOrderAllocator::OrderToUnitSize(order); }
 
 #if defined(PROFILE) || defined(_DEBUG)
     size_t m_SpaceUsed;
@@ -14,10 +14,25 @@
 #include "pch.h"
 #include "CommandAllocatorPool.h"
 
+ID3D12CommandAllocator* CommandAllocatorProvider::Create(size_t Index)
+{
+    ID3D12CommandAllocator* pAllocator = nullptr;
+    ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_Type, MY_IID_PPV_ARGS(&pAllocator)));
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %zu", Index);
+    pAllocator->SetName(AllocatorName);
+    return pAllocator;
+}
+
+void CommandAllocatorProvider::Reset(ID3D12CommandAllocator* Allocator)
+{
+    ASSERT_SUCCEEDED(Allocator->Reset());
+}
+
 CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
-    m_cCommandListType(Type),
-    m_Device(nullptr)
+    m_cCommandListType(Type)
 {
+    m_AllocatorPool.GetProvider().m_Type = Type;
 }
 
 CommandAllocatorPool::~CommandAllocatorPool()
@@ -27,52 +42,22 @@ CommandAllocatorPool::~CommandAllocatorPool()
 
 void CommandAllocatorPool::Create(ID3D12Device * pDevice)
 {
-    m_Device = pDevice;
+    m_AllocatorPool.GetProvider().m_Device = pDevice;
 }
 
 void CommandAllocatorPool::Shutdown()
 {
-    for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
-        m_AllocatorPool[i]->Release();
-
-    m_AllocatorPool.clear();
+    m_AllocatorPool.Shutdown();
 }
 
 ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
-    ID3D12CommandAllocator* pAllocator = nullptr;
-
-    if (!m_ReadyAllocators.empty())
-    {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
-
-        if (AllocatorPair.first <= CompletedFenceValue)
-        {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
-            m_ReadyAllocators.pop();
-        }
-    }
-
-    // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
-    {
-        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
-        wchar_t AllocatorName[32];
-        swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
-        pAllocator->SetName(AllocatorName);
-        m_AllocatorPool.push_back(pAllocator);
-    }
-
-    return pAllocator;
+    // Any allocator whose fence has passed can be reused.  If none is ready, a new one is created.
+    return m_AllocatorPool.Request([CompletedFenceValue](uint64_t FenceValue) { return FenceValue <= CompletedFenceValue; });
 }
 
-void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
+void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator, uint64_t CommandCount)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    m_AllocatorPool.Discard(FenceValue, Allocator, CommandCount);
 }
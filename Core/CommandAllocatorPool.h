@@ -13,11 +13,25 @@
 
 #pragma once
 
-#include <vector>
-#include <queue>
-#include <mutex>
+#include "AllocatorCore.h"
 #include <stdint.h>
 
+// Creates and resets the D3D12 command allocators recycled by CommandAllocatorPool
+class CommandAllocatorProvider
+{
+public:
+    typedef ID3D12CommandAllocator ObjectType;
+
+    CommandAllocatorProvider() : m_Device(nullptr), m_Type(D3D12_COMMAND_LIST_TYPE_DIRECT) {}
+
+    ID3D12CommandAllocator* Create( size_t Index );
+    void Reset( ID3D12CommandAllocator* Allocator );
+    void Destroy( ID3D12CommandAllocator* Allocator ) { Allocator->Release(); }
+
+    ID3D12Device* m_Device;
+    D3D12_COMMAND_LIST_TYPE m_Type;
+};
+
 class CommandAllocatorPool
 {
 public:
@@ -28,15 +42,15 @@ public:
     void Shutdown();
 
     ID3D12CommandAllocator* RequestAllocator(uint64_t CompletedFenceValue);
-    void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
+    // CommandCount is the number of commands recorded since the allocator was requested.  D3D12 doesn't
+    // report allocator memory, so the count stands in for it when deciding to trim oversized allocators.
+    void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator, uint64_t CommandCount);
 
-    inline size_t Size() { return m_AllocatorPool.size(); }
+    inline size_t Size() { return m_AllocatorPool.Size(); }
+    inline AllocatorCore::FencedObjectPool<CommandAllocatorProvider>::PoolStats GetStats() { return m_AllocatorPool.GetStats(); }
 
 private:
     const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
 
-    ID3D12Device* m_Device;
-    std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
-    std::mutex m_AllocatorMutex;
+    AllocatorCore::FencedObjectPool<CommandAllocatorProvider> m_AllocatorPool;
 };
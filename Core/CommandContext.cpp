@@ -143,7 +143,7 @@ uint64_t CommandContext::Finish( bool WaitForCompletion )
     CommandQueue& Queue = g_CommandManager.GetQueue(m_Type);
 
     uint64_t FenceValue = Queue.ExecuteCommandList(m_CommandList);
-    Queue.DiscardAllocator(FenceValue, m_CurrentAllocator);
+    Queue.DiscardAllocator(FenceValue, m_CurrentAllocator, m_NumRecordedCommands);
     m_CurrentAllocator = nullptr;
 
     m_CpuLinearAllocator.CleanupUsedPages(FenceValue);
@@ -161,8 +161,8 @@ uint64_t CommandContext::Finish( bool WaitForCompletion )
 
 CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_Type(Type),
-    m_DynamicViewDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV),
-    m_DynamicSamplerDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER),
+    m_DynamicViewDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Type),
+    m_DynamicSamplerDescriptorHeap(*this, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, Type),
     m_CpuLinearAllocator(kCpuWritable), 
     m_GpuLinearAllocator(kGpuExclusive)
 {
@@ -175,6 +175,7 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_CurComputeRootSignature = nullptr;
     m_CurPipelineState = nullptr;
     m_NumBarriersToFlush = 0;
+    m_NumRecordedCommands = 0;
 }
 
 CommandContext::~CommandContext( void )
@@ -200,6 +201,7 @@ void CommandContext::Reset( void )
     m_CurComputeRootSignature = nullptr;
     m_CurPipelineState = nullptr;
     m_NumBarriersToFlush = 0;
+    m_NumRecordedCommands = 0;
 
     BindDescriptorHeaps();
 }
@@ -479,6 +481,29 @@ void CommandContext::InitializeTexture( GpuResource& Dest, UINT NumSubresources,
     InitContext.Finish(true);
 }
 
+void CommandContext::CopyTextureFromUpload(GpuResource& Dest, UINT NumSubresources, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* Layouts, const DynAlloc& Src)
+{
+    TransitionResource(Dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
+
+    for (UINT i = 0; i < NumSubresources; ++i)
+    {
+        D3D12_TEXTURE_COPY_LOCATION DestLocation =
+        {
+            Dest.GetResource(),
+            D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+            i
+        };
+
+        D3D12_TEXTURE_COPY_LOCATION SrcLocation = {};
+        SrcLocation.pResource = Src.Buffer.GetResource();
+        SrcLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        SrcLocation.PlacedFootprint = Layouts[i];
+        SrcLocation.PlacedFootprint.Offset += Src.Offset;
+
+        m_CommandList->CopyTextureRegion(&DestLocation, 0, 0, 0, &SrcLocation, nullptr);
+    }
+}
+
 void CommandContext::CopySubresource(GpuResource& Dest, UINT DestSubIndex, GpuResource& Src, UINT SrcSubIndex)
 {
     FlushResourceBarriers();
@@ -131,11 +131,16 @@ public:
     // and returns row pitch in bytes.
     uint32_t ReadbackTexture(ReadbackBuffer& DstBuffer, PixelBuffer& SrcBuffer);
 
-    DynAlloc ReserveUploadMemory(size_t SizeInBytes)
+    // Texture copies need their upload offsets aligned to D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+    DynAlloc ReserveUploadMemory(size_t SizeInBytes, size_t Alignment = DEFAULT_ALIGN)
     {
-        return m_CpuLinearAllocator.Allocate(SizeInBytes);
+        return m_CpuLinearAllocator.Allocate(SizeInBytes, Alignment);
     }
 
+    // Copy subresources already written to upload memory, laid out as GetCopyableFootprints() describes
+    // with offsets relative to Src
+    void CopyTextureFromUpload(GpuResource& Dest, UINT NumSubresources, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* Layouts, const DynAlloc& Src);
+
     static void InitializeTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] );
     static void InitializeBuffer( GpuBuffer& Dest, const void* Data, size_t NumBytes, size_t DestOffset = 0);
     static void InitializeBuffer( GpuBuffer& Dest, const UploadBuffer& Src, size_t SrcOffset, size_t NumBytes = -1, size_t DestOffset = 0 );
@@ -180,6 +185,9 @@ protected:
     D3D12_RESOURCE_BARRIER m_ResourceBarrierBuffer[16];
     UINT m_NumBarriersToFlush;
 
+    // Draws, dispatches and barriers recorded into m_CurrentAllocator, used to size allocators for reuse
+    uint32_t m_NumRecordedCommands;
+
     ID3D12DescriptorHeap* m_CurrentDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
     LinearAllocator m_CpuLinearAllocator;
@@ -312,6 +320,7 @@ inline void CommandContext::FlushResourceBarriers( void )
     if (m_NumBarriersToFlush > 0)
     {
         m_CommandList->ResourceBarrier(m_NumBarriersToFlush, m_ResourceBarrierBuffer);
+        m_NumRecordedCommands += m_NumBarriersToFlush;
         m_NumBarriersToFlush = 0;
     }
 }
@@ -553,6 +562,7 @@ inline void ComputeContext::Dispatch( size_t GroupCountX, size_t GroupCountY, si
     FlushResourceBarriers();
     m_DynamicViewDescriptorHeap.CommitComputeRootDescriptorTables(m_CommandList);
     m_DynamicSamplerDescriptorHeap.CommitComputeRootDescriptorTables(m_CommandList);
+    ++m_NumRecordedCommands;
     m_CommandList->Dispatch((UINT)GroupCountX, (UINT)GroupCountY, (UINT)GroupCountZ);
 }
 
@@ -688,6 +698,7 @@ inline void GraphicsContext::DrawInstanced(UINT VertexCountPerInstance, UINT Ins
     FlushResourceBarriers();
     m_DynamicViewDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
     m_DynamicSamplerDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
+    ++m_NumRecordedCommands;
     m_CommandList->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
 }
 
@@ -697,6 +708,7 @@ inline void GraphicsContext::DrawIndexedInstanced(UINT IndexCountPerInstance, UI
     FlushResourceBarriers();
     m_DynamicViewDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
     m_DynamicSamplerDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
+    ++m_NumRecordedCommands;
     m_CommandList->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
 }
 
@@ -707,6 +719,7 @@ inline void GraphicsContext::ExecuteIndirect(CommandSignature& CommandSig,
     FlushResourceBarriers();
     m_DynamicViewDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
     m_DynamicSamplerDescriptorHeap.CommitGraphicsRootDescriptorTables(m_CommandList);
+    ++m_NumRecordedCommands;
     m_CommandList->ExecuteIndirect(CommandSig.GetSignature(), MaxCommands,
         ArgumentBuffer.GetResource(), ArgumentStartOffset,
         CommandCounterBuffer == nullptr ? nullptr : CommandCounterBuffer->GetResource(), CounterOffset);
@@ -724,6 +737,7 @@ inline void ComputeContext::ExecuteIndirect(CommandSignature& CommandSig,
     FlushResourceBarriers();
     m_DynamicViewDescriptorHeap.CommitComputeRootDescriptorTables(m_CommandList);
     m_DynamicSamplerDescriptorHeap.CommitComputeRootDescriptorTables(m_CommandList);
+    ++m_NumRecordedCommands;
     m_CommandList->ExecuteIndirect(CommandSig.GetSignature(), MaxCommands,
         ArgumentBuffer.GetResource(), ArgumentStartOffset,
         CommandCounterBuffer == nullptr ? nullptr : CommandCounterBuffer->GetResource(), CounterOffset);
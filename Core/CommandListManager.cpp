@@ -197,7 +197,7 @@ ID3D12CommandAllocator* CommandQueue::RequestAllocator()
     return m_AllocatorPool.RequestAllocator(CompletedFence);
 }
 
-void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator)
+void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator, uint64_t CommandCount)
 {
-    m_AllocatorPool.DiscardAllocator(FenceValue, Allocator);
+    m_AllocatorPool.DiscardAllocator(FenceValue, Allocator, CommandCount);
 }
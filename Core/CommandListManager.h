@@ -51,7 +51,7 @@ private:
 
     uint64_t ExecuteCommandList(ID3D12CommandList* List);
     ID3D12CommandAllocator* RequestAllocator(void);
-    void DiscardAllocator(uint64_t FenceValueForReset, ID3D12CommandAllocator* Allocator);
+    void DiscardAllocator(uint64_t FenceValueForReset, ID3D12CommandAllocator* Allocator, uint64_t CommandCount);
 
     ID3D12CommandQueue* m_CommandQueue;
 
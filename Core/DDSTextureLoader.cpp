@@ -783,6 +783,76 @@ static HRESULT FillInitData( _In_ size_t width,
 }
 
 
+//--------------------------------------------------------------------------------------
+static void CreateTextureView( _In_ ID3D12Device* d3dDevice,
+                               _In_ ID3D12Resource* tex,
+                               _In_ const D3D12_RESOURCE_DESC& ResourceDesc,
+                               _In_ bool isCubeMap,
+                               _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
+    SRVDesc.Format = ResourceDesc.Format;
+    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+    const UINT arraySize = ResourceDesc.DepthOrArraySize;
+
+    switch ( ResourceDesc.Dimension )
+    {
+        case D3D12_RESOURCE_DIMENSION_TEXTURE1D:
+            if (arraySize > 1)
+            {
+                SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1DARRAY;
+                SRVDesc.Texture1DArray.MipLevels = ResourceDesc.MipLevels;
+                SRVDesc.Texture1DArray.ArraySize = arraySize;
+            }
+            else
+            {
+                SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1D;
+                SRVDesc.Texture1D.MipLevels = ResourceDesc.MipLevels;
+            }
+            break;
+
+        case D3D12_RESOURCE_DIMENSION_TEXTURE2D:
+            if ( isCubeMap )
+            {
+                if (arraySize > 6)
+                {
+                    SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBEARRAY;
+                    SRVDesc.TextureCubeArray.MipLevels = ResourceDesc.MipLevels;
+
+                    // Earlier we set arraySize to (NumCubes * 6)
+                    SRVDesc.TextureCubeArray.NumCubes = arraySize / 6;
+                }
+                else
+                {
+                    SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+                    SRVDesc.TextureCube.MipLevels = ResourceDesc.MipLevels;
+                }
+            }
+            else if (arraySize > 1)
+            {
+                SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+                SRVDesc.Texture2DArray.MipLevels = ResourceDesc.MipLevels;
+                SRVDesc.Texture2DArray.ArraySize = arraySize;
+            }
+            else
+            {
+                SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+                SRVDesc.Texture2D.MipLevels = ResourceDesc.MipLevels;
+                SRVDesc.Texture2D.MostDetailedMip = 0;
+            }
+            break;
+
+        case D3D12_RESOURCE_DIMENSION_TEXTURE3D:
+            SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+            SRVDesc.Texture3D.MipLevels = ResourceDesc.MipLevels;
+            SRVDesc.Texture3D.MostDetailedMip = 0;
+            break;
+    }
+
+    d3dDevice->CreateShaderResourceView( tex, &SRVDesc, textureView );
+}
+
 //--------------------------------------------------------------------------------------
 static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
                                    _In_ uint32_t resDim,
@@ -838,23 +908,7 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 
                 if (SUCCEEDED( hr ) && tex != nullptr)
                 {
-                    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
-                    SRVDesc.Format = format;
-                    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-                    if (arraySize > 1)
-                    {
-                        SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1DARRAY;
-                        SRVDesc.Texture1DArray.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                        SRVDesc.Texture1DArray.ArraySize = static_cast<UINT>( arraySize );
-                    }
-                    else
-                    {
-                        SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1D;
-                        SRVDesc.Texture1D.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                    }
-
-                    d3dDevice->CreateShaderResourceView( tex, &SRVDesc, textureView );
+                    CreateTextureView( d3dDevice, tex, ResourceDesc, isCubeMap, textureView );
 
                     if (texture != nullptr)
                     {
@@ -879,40 +933,7 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 
                 if (SUCCEEDED( hr ) && tex != 0)
                 {
-                    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
-                    SRVDesc.Format = format;
-                    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-                    if ( isCubeMap )
-                    {
-                        if (arraySize > 6)
-                        {
-                            SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBEARRAY;
-                            SRVDesc.TextureCubeArray.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-
-                            // Earlier we set arraySize to (NumCubes * 6)
-                            SRVDesc.TextureCubeArray.NumCubes = static_cast<UINT>( arraySize / 6 );
-                        }
-                        else
-                        {
-                            SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-                            SRVDesc.TextureCube.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                        }
-                    }
-                    else if (arraySize > 1)
-                    {
-                        SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
-                        SRVDesc.Texture2DArray.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                        SRVDesc.Texture2DArray.ArraySize = static_cast<UINT>( arraySize );
-                    }
-                    else
-                    {
-                        SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-                        SRVDesc.Texture2D.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                        SRVDesc.Texture2D.MostDetailedMip = 0;
-                    }
-
-                    d3dDevice->CreateShaderResourceView( tex, &SRVDesc, textureView );
+                    CreateTextureView( d3dDevice, tex, ResourceDesc, isCubeMap, textureView );
 
                     if (texture != nullptr)
                     {
@@ -938,15 +959,7 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 
                 if (SUCCEEDED( hr ) && tex != nullptr)
                 {
-                    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
-                    SRVDesc.Format = format;
-                    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-
-                    SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
-                    SRVDesc.Texture3D.MipLevels = (!mipCount) ? -1 : ResourceDesc.MipLevels;
-                    SRVDesc.Texture3D.MostDetailedMip = 0;
-
-                    d3dDevice->CreateShaderResourceView( tex, &SRVDesc, textureView );
+                    CreateTextureView( d3dDevice, tex, ResourceDesc, isCubeMap, textureView );
 
                     if (texture != nullptr)
                     {
@@ -966,27 +979,27 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 }
 
 //--------------------------------------------------------------------------------------
-static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
-                                     _In_ const DDS_HEADER* header,
-                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
-                                     _In_ size_t bitSize,
-                                     _In_ size_t maxsize,
-                                     _In_ bool forceSRGB,
-                                     _Outptr_opt_ ID3D12Resource** texture,
-                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+// Reads and validates the dimensions and format of the texture a DDS header describes
+static HRESULT GetTextureLayout( _In_ const DDS_HEADER* header,
+                                 _Out_ UINT& width,
+                                 _Out_ UINT& height,
+                                 _Out_ UINT& depth,
+                                 _Out_ size_t& mipCount,
+                                 _Out_ UINT& arraySize,
+                                 _Out_ DXGI_FORMAT& format,
+                                 _Out_ uint32_t& resDim,
+                                 _Out_ bool& isCubeMap )
 {
-    HRESULT hr = S_OK;
+    width = header->width;
+    height = header->height;
+    depth = header->depth;
 
-    UINT width = header->width;
-    UINT height = header->height;
-    UINT depth = header->depth;
+    resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+    arraySize = 1;
+    format = DXGI_FORMAT_UNKNOWN;
+    isCubeMap = false;
 
-    uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
-    UINT arraySize = 1;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    bool isCubeMap = false;
-
-    size_t mipCount = header->mipMapCount;
+    mipCount = header->mipMapCount;
     if (0 == mipCount)
     {
         mipCount = 1;
@@ -1142,6 +1155,31 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
+                                     _In_ const DDS_HEADER* header,
+                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                     _In_ size_t bitSize,
+                                     _In_ size_t maxsize,
+                                     _In_ bool forceSRGB,
+                                     _Outptr_opt_ ID3D12Resource** texture,
+                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    UINT width, height, depth, arraySize;
+    size_t mipCount;
+    DXGI_FORMAT format;
+    uint32_t resDim;
+    bool isCubeMap;
+
+    HRESULT hr = GetTextureLayout( header, width, height, depth, mipCount, arraySize, format, resDim, isCubeMap );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
     {
         // Create the texture
         UINT subresourceCount = static_cast<UINT>(mipCount) * arraySize;
@@ -1222,6 +1260,94 @@ static DDS_ALPHA_MODE GetAlphaMode( _In_ const DDS_HEADER* header )
 }
 
 
+_Use_decl_annotations_
+bool GetDDSTexture2DSize( const uint8_t* ddsData, size_t ddsDataSize, uint32_t& width, uint32_t& height, uint32_t& mipCount )
+{
+    width = height = mipCount = 0;
+
+    if (!ddsData || ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)) || *( const uint32_t* )( ddsData ) != DDS_MAGIC)
+        return false;
+
+    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    if (header->size != sizeof(DDS_HEADER))
+        return false;
+
+    if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC))
+    {
+        if (ddsDataSize < sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10))
+            return false;
+
+        auto d3d10ext = reinterpret_cast<const DDS_HEADER_DXT10*>( (const char*)header + sizeof(DDS_HEADER) );
+        if (d3d10ext->resourceDimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || d3d10ext->arraySize != 1 ||
+            (d3d10ext->miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE))
+            return false;
+    }
+    else if ((header->flags & DDS_HEADER_FLAGS_VOLUME) || (header->caps2 & DDS_CUBEMAP))
+    {
+        return false;
+    }
+
+    width = header->width;
+    height = header->height;
+    mipCount = header->mipMapCount == 0 ? 1 : header->mipMapCount;
+    return true;
+}
+
+
+_Use_decl_annotations_
+HRESULT GetDDSTextureInfo( const uint8_t* ddsData, size_t ddsDataSize, bool forceSRGB, DDSTextureInfo& info )
+{
+    static_assert(DDSTextureInfo::kMaxHeaderSize == sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10),
+        "Header size mismatch");
+
+    if (!ddsData || ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)) || *( const uint32_t* )( ddsData ) != DDS_MAGIC)
+        return E_FAIL;
+
+    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    if (header->size != sizeof(DDS_HEADER) || header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+        return E_FAIL;
+
+    info.DataOffset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC))
+        info.DataOffset += sizeof(DDS_HEADER_DXT10);
+
+    if (ddsDataSize < info.DataOffset)
+        return E_FAIL;
+
+    UINT width, height, depth, arraySize;
+    size_t mipCount;
+    DXGI_FORMAT format;
+    uint32_t resDim;
+
+    HRESULT hr = GetTextureLayout( header, width, height, depth, mipCount, arraySize, format, resDim, info.IsCubeMap );
+    if ( FAILED(hr) )
+        return hr;
+
+    D3D12_RESOURCE_DESC& desc = info.Desc;
+    desc.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>( resDim );
+    desc.Alignment = 0;
+    desc.Width = width;
+    desc.Height = height;
+    desc.DepthOrArraySize = static_cast<UINT16>( resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? depth : arraySize );
+    desc.MipLevels = static_cast<UINT16>( mipCount );
+    desc.Format = forceSRGB ? MakeSRGB( format ) : format;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+void CreateDDSTextureView( ID3D12Device* d3dDevice, ID3D12Resource* texture, const DDSTextureInfo& info,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    CreateTextureView( d3dDevice, texture, info.Desc, info.IsCubeMap, textureView );
+}
+
+
 _Use_decl_annotations_
 HRESULT CreateDDSTextureFromMemory(
     ID3D12Device* d3dDevice,
@@ -55,4 +55,37 @@ HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                             );
 
+// Read the full-resolution size and mip count from a DDS file's header without creating anything.
+// Returns false unless the file holds a single 2D texture.
+bool GetDDSTexture2DSize( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                        _In_ size_t ddsDataSize,
+                        _Out_ uint32_t& width,
+                        _Out_ uint32_t& height,
+                        _Out_ uint32_t& mipCount );
+
+// What a DDS file will create, from its headers alone.  The pixel data starts at DataOffset and holds
+// each subresource in D3D's order, tightly packed.
+struct DDSTextureInfo
+{
+    // Enough of the file to hold every header
+    enum { kMaxHeaderSize = 148 };
+
+    D3D12_RESOURCE_DESC Desc;
+    bool IsCubeMap;
+    size_t DataOffset;
+};
+
+// ddsData needs only the headers, at most kMaxHeaderSize bytes.  Fails for files CreateDDSTextureFromMemory()
+// would reject.
+HRESULT GetDDSTextureInfo( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                        _In_ size_t ddsDataSize,
+                        _In_ bool forceSRGB,
+                        _Out_ DDSTextureInfo& info );
+
+// Create the SRV for a resource created from info.Desc
+void CreateDDSTextureView( _In_ ID3D12Device* d3dDevice,
+                        _In_ ID3D12Resource* texture,
+                        _In_ const DDSTextureInfo& info,
+                        _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView );
+
 size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
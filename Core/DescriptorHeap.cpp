@@ -31,7 +31,7 @@ void DescriptorAllocator::DestroyAll(void)
 
 ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE Type)
 {
-    std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
+    // Called with sm_AllocationMutex held
 
     D3D12_DESCRIPTOR_HEAP_DESC Desc;
     Desc.Type = Type;
@@ -45,24 +45,93 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
     return pHeap.Get();
 }
 
+void DescriptorAllocator::ReleaseCompletedFrees( void )
+{
+    while (!m_PendingFrees.empty() && g_CommandManager.IsFenceComplete(m_PendingFrees.front().FenceValue))
+    {
+        const PendingFree& Pending = m_PendingFrees.front();
+        HeapRanges& Heap = *m_Heaps[Pending.HeapIndex];
+        Heap.Ranges.Free(Pending.Node);
+        Heap.FreeCount += Pending.Count;
+        m_PendingFreeCount -= Pending.Count;
+        m_PendingFrees.pop();
+    }
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
+    ASSERT(Count > 0 && Count <= sm_NumDescriptorsPerHeap);
+
+    std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
+
+    ReleaseCompletedFrees();
+
+    // Try the heap we last allocated from, then any other heap with enough free descriptors
+    uint32_t Node = AllocatorCore::TLSFOffsetAllocator::kInvalidNode;
+    if (m_CurrentHeap < m_Heaps.size() && m_Heaps[m_CurrentHeap]->FreeCount >= Count)
+        Node = m_Heaps[m_CurrentHeap]->Ranges.Allocate(Count);
+
+    for (size_t i = 0; Node == AllocatorCore::TLSFOffsetAllocator::kInvalidNode && i < m_Heaps.size(); ++i)
     {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
-        m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+        if (i != m_CurrentHeap && m_Heaps[i]->FreeCount >= Count)
+        {
+            Node = m_Heaps[i]->Ranges.Allocate(Count);
+            if (Node != AllocatorCore::TLSFOffsetAllocator::kInvalidNode)
+                m_CurrentHeap = i;
+        }
+    }
+
+    if (Node == AllocatorCore::TLSFOffsetAllocator::kInvalidNode)
+    {
+        ID3D12DescriptorHeap* NewHeap = RequestNewHeap(m_Type);
 
         if (m_DescriptorSize == 0)
             m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+
+        m_CurrentHeap = m_Heaps.size();
+        m_Heaps.emplace_back(new HeapRanges(NewHeap->GetCPUDescriptorHandleForHeapStart()));
+        m_HeapIndexByStart[m_Heaps.back()->Start.ptr] = m_CurrentHeap;
+        Node = m_Heaps.back()->Ranges.Allocate(Count);
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
-    m_CurrentHandle.ptr += Count * m_DescriptorSize;
-    m_RemainingFreeHandles -= Count;
+    HeapRanges& Heap = *m_Heaps[m_CurrentHeap];
+    const uint32_t Index = uint32_t(Heap.Ranges.GetOffset(Node));
+    Heap.NodeAtIndex[Index] = Node;
+    Heap.FreeCount -= Count;
+    m_LiveCount += Count;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE ret = Heap.Start;
+    ret.ptr += Index * m_DescriptorSize;
     return ret;
 }
 
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
+
+    auto iter = m_HeapIndexByStart.upper_bound(Handle.ptr);
+    ASSERT(iter != m_HeapIndexByStart.begin(), "Descriptor was not allocated by this allocator");
+    --iter;
+
+    HeapRanges& Heap = *m_Heaps[iter->second];
+    const uint32_t Index = uint32_t((Handle.ptr - Heap.Start.ptr) / m_DescriptorSize);
+    ASSERT(Index < sm_NumDescriptorsPerHeap && Heap.NodeAtIndex[Index] != AllocatorCore::TLSFOffsetAllocator::kInvalidNode,
+        "Descriptor was not allocated by this allocator");
+    ASSERT(Heap.Ranges.GetSize(Heap.NodeAtIndex[Index]) == Count);
+
+    // Command lists still being recorded or executed may refer to the descriptors
+    PendingFree Pending;
+    Pending.FenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    Pending.HeapIndex = iter->second;
+    Pending.Node = Heap.NodeAtIndex[Index];
+    Pending.Count = Count;
+    m_PendingFrees.push(Pending);
+
+    Heap.NodeAtIndex[Index] = AllocatorCore::TLSFOffsetAllocator::kInvalidNode;
+    m_LiveCount -= Count;
+    m_PendingFreeCount += Count;
+}
+
 //
 // DescriptorHeap implementation
 //
@@ -13,25 +13,39 @@
 
 #pragma once
 
+#include "AllocatorCore.h"
 #include <mutex>
 #include <vector>
 #include <queue>
+#include <map>
+#include <memory>
 #include <string>
 
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible
 // resource descriptors as resources are created.  For those that need to be made shader-visible, they
-// will need to be copied to a DescriptorHeap or a DynamicDescriptorHeap.
+// will need to be copied to a DescriptorHeap or a DynamicDescriptorHeap.  Freed ranges are reused once
+// the GPU has passed the fence that was pending when they were freed, so heaps only grow with the number
+// of live descriptors.
 class DescriptorAllocator
 {
 public:
     DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : 
-        m_Type(Type), m_CurrentHeap(nullptr), m_DescriptorSize(0)
+        m_Type(Type), m_DescriptorSize(0), m_CurrentHeap(0), m_LiveCount(0), m_PendingFreeCount(0)
     {
-        m_CurrentHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
     }
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
 
+    // Handle and Count must match an earlier Allocate()
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    // Descriptors allocated and not yet freed.  Engine buffers hold theirs for the whole run, so a count that
+    // keeps growing while content streams in and out points at a leak, not the count at shutdown.
+    uint32_t GetLiveCount(void) const { return m_LiveCount; }
+    // Descriptors freed but waiting on a fence before they can be reused
+    uint32_t GetPendingFreeCount(void) const { return m_PendingFreeCount; }
+    uint32_t GetCapacity(void) const { return uint32_t(m_Heaps.size()) * sm_NumDescriptorsPerHeap; }
+
     static void DestroyAll(void);
 
 protected:
@@ -41,11 +55,39 @@ protected:
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
+    // Free ranges of one heap in descriptor indices
+    struct HeapRanges
+    {
+        HeapRanges( D3D12_CPU_DESCRIPTOR_HANDLE HeapStart )
+            : Start(HeapStart), Ranges(sm_NumDescriptorsPerHeap, 1), FreeCount(sm_NumDescriptorsPerHeap)
+        {
+            std::fill(NodeAtIndex, NodeAtIndex + sm_NumDescriptorsPerHeap, (uint32_t)AllocatorCore::TLSFOffsetAllocator::kInvalidNode);
+        }
+
+        D3D12_CPU_DESCRIPTOR_HANDLE Start;
+        AllocatorCore::TLSFOffsetAllocator Ranges;
+        uint32_t NodeAtIndex[sm_NumDescriptorsPerHeap];
+        uint32_t FreeCount;
+    };
+
+    struct PendingFree
+    {
+        uint64_t FenceValue;
+        size_t HeapIndex;
+        uint32_t Node;
+        uint32_t Count;
+    };
+
+    void ReleaseCompletedFrees( void );
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
-    uint32_t m_RemainingFreeHandles;
+    std::vector<std::unique_ptr<HeapRanges>> m_Heaps;
+    std::map<size_t, size_t> m_HeapIndexByStart;
+    size_t m_CurrentHeap;
+    std::queue<PendingFree> m_PendingFrees;
+    uint32_t m_LiveCount;
+    uint32_t m_PendingFreeCount;
 };
 
 // This handle refers to a descriptor or a descriptor table (contiguous descriptors) that is shader visible.
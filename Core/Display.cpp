@@ -21,6 +21,8 @@
 #include "RootSignature.h"
 #include "ImageScaling.h"
 #include "TemporalEffects.h"
+#include "FrameArena.h"
+#include "TextureManager.h"
 
 #pragma comment(lib, "dxgi.lib") 
 
@@ -490,6 +492,10 @@ void Display::Present(void)
 
     g_CurrentBuffer = (g_CurrentBuffer + 1) % SWAP_CHAIN_BUFFER_COUNT;
 
+    DynamicDescriptorHeap::EndFrame();
+    FrameArena::BeginFrame();
+    TextureManager::UpdateStreaming();
+
     // Test robustness to handle spikes in CPU time
     //if (s_DropRandomFrames)
     //{
@@ -20,6 +20,15 @@
 
 using namespace Graphics;
 
+namespace
+{
+    BoolVar RingDescriptorHeaps("Graphics/Ring Descriptor Heaps", true);
+
+    // Ring sizes per heap type.  Shader-visible sampler heaps are capped at 2048 descriptors.
+    const uint32_t kRingHeapSize[2] = { 65536, 2048 };
+    const uint32_t kRingRegionSize[2] = { 1024, 256 };
+}
+
 //
 // DynamicDescriptorHeap Implementation
 //
@@ -28,6 +37,51 @@ std::mutex DynamicDescriptorHeap::sm_Mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
 std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
 std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+DynamicDescriptorHeap::RingHeap DynamicDescriptorHeap::sm_RingHeaps[4][2];
+
+std::atomic<uint32_t> DynamicDescriptorHeap::sm_HeapSwitches(0);
+std::atomic<uint32_t> DynamicDescriptorHeap::sm_DescriptorsCopied(0);
+std::atomic<uint32_t> DynamicDescriptorHeap::sm_CopyCalls(0);
+std::atomic<uint32_t> DynamicDescriptorHeap::sm_RingFallbacks(0);
+DynamicDescriptorHeap::FrameStats DynamicDescriptorHeap::sm_LastFrameStats = {};
+
+void DynamicDescriptorHeap::DestroyAll(void)
+{
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+
+    for (uint32_t idx = 0; idx < 2; ++idx)
+    {
+        sm_DescriptorHeapPool[idx].clear();
+        sm_RetiredDescriptorHeaps[idx] = std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>>();
+        sm_AvailableDescriptorHeaps[idx] = std::queue<ID3D12DescriptorHeap*>();
+
+        for (uint32_t QueueType = 0; QueueType < 4; ++QueueType)
+        {
+            RingHeap& Ring = sm_RingHeaps[QueueType][idx];
+            Ring.Heap = nullptr;
+            Ring.RegionFence.clear();
+            Ring.Head = Ring.Tail = 0;
+        }
+    }
+}
+
+void DynamicDescriptorHeap::EndFrame(void)
+{
+    FrameStats Stats;
+    Stats.HeapSwitches = sm_HeapSwitches.exchange(0);
+    Stats.DescriptorsCopied = sm_DescriptorsCopied.exchange(0);
+    Stats.CopyCalls = sm_CopyCalls.exchange(0);
+    Stats.RingFallbacks = sm_RingFallbacks.exchange(0);
+
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+    sm_LastFrameStats = Stats;
+}
+
+DynamicDescriptorHeap::FrameStats DynamicDescriptorHeap::GetFrameStats(void)
+{
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+    return sm_LastFrameStats;
+}
 
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 {
@@ -69,6 +123,64 @@ void DynamicDescriptorHeap::DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE H
         sm_RetiredDescriptorHeaps[idx].push(std::make_pair(FenceValue, *iter));
 }
 
+bool DynamicDescriptorHeap::RequestRingRegion( D3D12_COMMAND_LIST_TYPE QueueType, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t& Region,
+    ID3D12DescriptorHeap*& HeapPtr, DescriptorHandle& FirstDescriptor, uint32_t& RegionSize )
+{
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+
+    uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+    RingHeap& Ring = sm_RingHeaps[QueueType][idx];
+
+    if (Ring.Heap == nullptr)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC HeapDesc = {};
+        HeapDesc.Type = HeapType;
+        HeapDesc.NumDescriptors = kRingHeapSize[idx];
+        HeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        HeapDesc.NodeMask = 1;
+        ASSERT_SUCCEEDED(g_Device->CreateDescriptorHeap(&HeapDesc, MY_IID_PPV_ARGS(&Ring.Heap)));
+        Ring.Heap->SetName(L"DynamicDescriptorHeap Ring");
+
+        Ring.FirstDescriptor = DescriptorHandle(
+            Ring.Heap->GetCPUDescriptorHandleForHeapStart(),
+            Ring.Heap->GetGPUDescriptorHandleForHeapStart());
+        Ring.RegionSize = kRingRegionSize[idx];
+        Ring.NumRegions = kRingHeapSize[idx] / kRingRegionSize[idx];
+        Ring.RegionFence.assign(Ring.NumRegions, 0);
+        Ring.Head = Ring.Tail = 0;
+    }
+
+    // Reclaim in order.  A region still being recorded into holds back everything after it.
+    while (Ring.Tail < Ring.Head)
+    {
+        uint64_t FenceValue = Ring.RegionFence[Ring.Tail % Ring.NumRegions];
+        if (FenceValue == 0 || !g_CommandManager.IsFenceComplete(FenceValue))
+            break;
+        ++Ring.Tail;
+    }
+
+    if (Ring.Head - Ring.Tail == Ring.NumRegions)
+        return false;
+
+    Region = Ring.Head++;
+    uint32_t Slot = (uint32_t)(Region % Ring.NumRegions);
+    Ring.RegionFence[Slot] = 0;
+
+    HeapPtr = Ring.Heap.Get();
+    FirstDescriptor = Ring.FirstDescriptor + Slot * Ring.RegionSize * g_Device->GetDescriptorHandleIncrementSize(HeapType);
+    RegionSize = Ring.RegionSize;
+    return true;
+}
+
+void DynamicDescriptorHeap::DiscardRingRegions( D3D12_COMMAND_LIST_TYPE QueueType, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValue, const std::vector<uint64_t>& UsedRegions )
+{
+    uint32_t idx = HeapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+    std::lock_guard<std::mutex> LockGuard(sm_Mutex);
+    RingHeap& Ring = sm_RingHeaps[QueueType][idx];
+    for (auto iter = UsedRegions.begin(); iter != UsedRegions.end(); ++iter)
+        Ring.RegionFence[*iter % Ring.NumRegions] = FenceValue;
+}
+
 void DynamicDescriptorHeap::RetireCurrentHeap( void )
 {
     // Don't retire unused heaps.
@@ -79,22 +191,35 @@ void DynamicDescriptorHeap::RetireCurrentHeap( void )
     }
 
     ASSERT(m_CurrentHeapPtr != nullptr);
-    m_RetiredHeaps.push_back(m_CurrentHeapPtr);
+    if (m_CurrentRegion != kNoRegion)
+        m_RetiredRegions.push_back(m_CurrentRegion);
+    else
+        m_RetiredHeaps.push_back(m_CurrentHeapPtr);
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+    m_CurrentCapacity = 0;
+    m_CurrentRegion = kNoRegion;
 }
 
 void DynamicDescriptorHeap::RetireUsedHeaps( uint64_t fenceValue )
 {
     DiscardDescriptorHeaps(m_DescriptorType, fenceValue, m_RetiredHeaps);
     m_RetiredHeaps.clear();
+
+    if (!m_RetiredRegions.empty())
+    {
+        DiscardRingRegions(m_QueueType, m_DescriptorType, fenceValue, m_RetiredRegions);
+        m_RetiredRegions.clear();
+    }
 }
 
-DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
-    : m_OwningContext(OwningContext), m_DescriptorType(HeapType)
+DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, D3D12_COMMAND_LIST_TYPE QueueType)
+    : m_OwningContext(OwningContext), m_DescriptorType(HeapType), m_QueueType(QueueType)
 {
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+    m_CurrentCapacity = 0;
+    m_CurrentRegion = kNoRegion;
     m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(HeapType);
 }
 
@@ -110,18 +235,33 @@ void DynamicDescriptorHeap::CleanupUsedHeaps( uint64_t fenceValue )
     m_ComputeHandleCache.ClearCache();
 }
 
-inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
+bool DynamicDescriptorHeap::AcquireNewHeap( void )
 {
+    ID3D12DescriptorHeap* PrevHeapPtr = m_CurrentHeapPtr;
+    RetireCurrentHeap();
+
+    if (RingDescriptorHeaps)
+    {
+        if (!RequestRingRegion(m_QueueType, m_DescriptorType, m_CurrentRegion, m_CurrentHeapPtr, m_FirstDescriptor, m_CurrentCapacity))
+            ++sm_RingFallbacks;
+    }
+
     if (m_CurrentHeapPtr == nullptr)
     {
-        ASSERT(m_CurrentOffset == 0);
         m_CurrentHeapPtr = RequestDescriptorHeap(m_DescriptorType);
+        m_CurrentCapacity = kNumDescriptorsPerHeap;
         m_FirstDescriptor = DescriptorHandle(
             m_CurrentHeapPtr->GetCPUDescriptorHandleForHeapStart(),
             m_CurrentHeapPtr->GetGPUDescriptorHandleForHeapStart());
     }
 
-    return m_CurrentHeapPtr;
+    if (m_CurrentHeapPtr == PrevHeapPtr)
+        return false;
+
+    if (PrevHeapPtr != nullptr)
+        ++sm_HeapSwitches;
+
+    return true;
 }
 
 uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
@@ -143,7 +283,7 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
     return NeededSpace;
 }
 
-void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize,
     DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
@@ -176,14 +316,16 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 
     m_StaleRootParamsBitMap = 0;
 
-    static const uint32_t kMaxDescriptorsPerCopy = 16;
+    // The cache never holds more than kMaxNumDescriptors handles, so every stale table fits in one copy
     UINT NumDestDescriptorRanges = 0;
-    D3D12_CPU_DESCRIPTOR_HANDLE pDestDescriptorRangeStarts[kMaxDescriptorsPerCopy];
-    UINT pDestDescriptorRangeSizes[kMaxDescriptorsPerCopy];
+    D3D12_CPU_DESCRIPTOR_HANDLE pDestDescriptorRangeStarts[kMaxNumDescriptors];
+    UINT pDestDescriptorRangeSizes[kMaxNumDescriptors];
 
     UINT NumSrcDescriptorRanges = 0;
-    D3D12_CPU_DESCRIPTOR_HANDLE pSrcDescriptorRangeStarts[kMaxDescriptorsPerCopy];
-    UINT pSrcDescriptorRangeSizes[kMaxDescriptorsPerCopy];
+    D3D12_CPU_DESCRIPTOR_HANDLE pSrcDescriptorRangeStarts[kMaxNumDescriptors];
+    UINT pSrcDescriptorRangeSizes[kMaxNumDescriptors];
+
+    uint32_t NumCopied = 0;
 
     for (uint32_t i = 0; i < StaleParamCount; ++i)
     {
@@ -209,30 +351,27 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
             _BitScanForward64(&DescriptorCount, ~SetHandles);
             SetHandles >>= DescriptorCount;
 
-            // If we run out of temp room, copy what we've got so far
-            if (NumSrcDescriptorRanges + DescriptorCount > kMaxDescriptorsPerCopy)
-            {
-                g_Device->CopyDescriptors(
-                    NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
-                    NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
-                    Type);
-
-                NumSrcDescriptorRanges = 0;
-                NumDestDescriptorRanges = 0;
-            }
-
             // Setup destination range
             pDestDescriptorRangeStarts[NumDestDescriptorRanges] = CurDest;
             pDestDescriptorRangeSizes[NumDestDescriptorRanges] = DescriptorCount;
             ++NumDestDescriptorRanges;
 
-            // Setup source ranges (one descriptor each because we don't assume they are contiguous)
+            // Setup source ranges.  Handles aren't assumed to be contiguous, but neighbors in the same heap
+            // extend the previous range.
             for (uint32_t j = 0; j < DescriptorCount; ++j)
             {
+                if (NumSrcDescriptorRanges > 0 && SrcHandles[j].ptr == pSrcDescriptorRangeStarts[NumSrcDescriptorRanges - 1].ptr +
+                    pSrcDescriptorRangeSizes[NumSrcDescriptorRanges - 1] * DescriptorSize)
+                {
+                    ++pSrcDescriptorRangeSizes[NumSrcDescriptorRanges - 1];
+                    continue;
+                }
+
                 pSrcDescriptorRangeStarts[NumSrcDescriptorRanges] = SrcHandles[j];
                 pSrcDescriptorRangeSizes[NumSrcDescriptorRanges] = 1;
                 ++NumSrcDescriptorRanges;
             }
+            NumCopied += DescriptorCount;
 
             // Move the destination pointer forward by the number of descriptors we will copy
             SrcHandles += DescriptorCount;
@@ -240,26 +379,35 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
         }
     }
 
-    g_Device->CopyDescriptors(
-        NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
-        NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
-        Type);
+    if (NumCopied > 0)
+    {
+        g_Device->CopyDescriptors(
+            NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
+            NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
+            Type);
+    }
+
+    return NumCopied;
 }
     
 void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
     uint32_t NeededSize = HandleCache.ComputeStagedSize();
-    if (!HasSpace(NeededSize))
+
+    // Tables bound from an earlier region of the same heap stay valid, so only a new heap needs them re-copied
+    if (!HasSpace(NeededSize) && AcquireNewHeap())
     {
-        RetireCurrentHeap();
         UnbindAllValid();
         NeededSize = HandleCache.ComputeStagedSize();
     }
 
-    // This can trigger the creation of a new heap
-    m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
-    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+    m_OwningContext.SetDescriptorHeap(m_DescriptorType, m_CurrentHeapPtr);
+    uint32_t NumCopied = HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+
+    sm_DescriptorsCopied += NumCopied;
+    if (NumCopied > 0)
+        ++sm_CopyCalls;
 }
 
 void DynamicDescriptorHeap::UnbindAllValid( void )
@@ -270,18 +418,17 @@ void DynamicDescriptorHeap::UnbindAllValid( void )
 
 D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::UploadDirect( D3D12_CPU_DESCRIPTOR_HANDLE Handle )
 {
-    if (!HasSpace(1))
-    {
-        RetireCurrentHeap();
+    if (!HasSpace(1) && AcquireNewHeap())
         UnbindAllValid();
-    }
 
-    m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
+    m_OwningContext.SetDescriptorHeap(m_DescriptorType, m_CurrentHeapPtr);
 
     DescriptorHandle DestHandle = m_FirstDescriptor + m_CurrentOffset * m_DescriptorSize;
     m_CurrentOffset += 1;
 
     g_Device->CopyDescriptorsSimple(1, DestHandle, Handle, m_DescriptorType);
+    ++sm_DescriptorsCopied;
+    ++sm_CopyCalls;
 
     return DestHandle;
 }
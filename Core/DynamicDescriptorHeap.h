@@ -17,6 +17,7 @@
 #include "RootSignature.h"
 #include <vector>
 #include <queue>
+#include <atomic>
 
 namespace Graphics
 {
@@ -26,17 +27,30 @@ namespace Graphics
 // This class is a linear allocation system for dynamically generated descriptor tables.  It internally caches
 // CPU descriptor handles so that when not enough space is available in the current heap, necessary descriptors
 // can be re-copied to the new heap.
+//
+// In ring mode, every context recording for a queue carves regions out of one large shader-visible heap
+// instead of pulling whole heaps from a pool.  Moving to a new region keeps the same heap bound, so neither
+// SetDescriptorHeaps nor re-copying the live tables is needed.  A full ring falls back to the pool.
 class DynamicDescriptorHeap
 {
 public:
-    DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
+    DynamicDescriptorHeap(CommandContext& OwningContext, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, D3D12_COMMAND_LIST_TYPE QueueType);
     ~DynamicDescriptorHeap();
 
-    static void DestroyAll(void)
+    static void DestroyAll(void);
+
+    // Counters for the most recently completed frame
+    struct FrameStats
     {
-        sm_DescriptorHeapPool[0].clear();
-        sm_DescriptorHeapPool[1].clear();
-    }
+        uint32_t HeapSwitches;      // Times a context had to bind a different shader-visible heap
+        uint32_t DescriptorsCopied; // Descriptors copied into shader-visible heaps
+        uint32_t CopyCalls;         // CopyDescriptors calls made to copy them
+        uint32_t RingFallbacks;     // Pooled heaps handed out because a ring was full
+    };
+
+    // Latch this frame's counters and start counting the next frame
+    static void EndFrame(void);
+    static FrameStats GetFrameStats(void);
 
     void CleanupUsedHeaps( uint64_t fenceValue );
 
@@ -82,23 +96,51 @@ private:
 
     // Static members
     static const uint32_t kNumDescriptorsPerHeap = 1024;
+    static const uint64_t kNoRegion = ~0ull;
     static std::mutex sm_Mutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
     static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
     static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
 
+    // One large heap per queue and heap type, handed out in fixed-size regions.  Regions are reclaimed in
+    // the order they were handed out once the fence they were retired with has completed.
+    struct RingHeap
+    {
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+        DescriptorHandle FirstDescriptor;
+        uint32_t RegionSize;
+        uint32_t NumRegions;
+        uint64_t Head;                      // Sequence number of the next region to hand out
+        uint64_t Tail;                      // Oldest region not yet reclaimed
+        std::vector<uint64_t> RegionFence;  // Zero while a context still records into the region
+    };
+    static RingHeap sm_RingHeaps[4][2];     // [D3D12_COMMAND_LIST_TYPE][heap type]
+
+    static std::atomic<uint32_t> sm_HeapSwitches;
+    static std::atomic<uint32_t> sm_DescriptorsCopied;
+    static std::atomic<uint32_t> sm_CopyCalls;
+    static std::atomic<uint32_t> sm_RingFallbacks;
+    static FrameStats sm_LastFrameStats;
+
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
     static void DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValueForReset, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps );
+    static bool RequestRingRegion( D3D12_COMMAND_LIST_TYPE QueueType, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t& Region,
+        ID3D12DescriptorHeap*& HeapPtr, DescriptorHandle& FirstDescriptor, uint32_t& RegionSize );
+    static void DiscardRingRegions( D3D12_COMMAND_LIST_TYPE QueueType, D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValueForReset, const std::vector<uint64_t>& UsedRegions );
 
     // Non-static members
     CommandContext& m_OwningContext;
     ID3D12DescriptorHeap* m_CurrentHeapPtr;
     const D3D12_DESCRIPTOR_HEAP_TYPE m_DescriptorType;
+    const D3D12_COMMAND_LIST_TYPE m_QueueType;
     uint32_t m_DescriptorSize;
     uint32_t m_CurrentOffset;
+    uint32_t m_CurrentCapacity;             // Size of the current heap or ring region
+    uint64_t m_CurrentRegion;               // kNoRegion when the current heap came from the pool
     DescriptorHandle m_FirstDescriptor;
     std::vector<ID3D12DescriptorHeap*> m_RetiredHeaps;
+    std::vector<uint64_t> m_RetiredRegions;
 
     // Describes a descriptor table entry:  a region of the handle cache and which handles have been set
     struct DescriptorTableCache
@@ -131,7 +173,9 @@ private:
         static const uint32_t kMaxNumDescriptorTables = 16;
 
         uint32_t ComputeStagedSize();
-        void CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
+
+        // Copies every stale table with one CopyDescriptors call.  Returns the number of descriptors copied.
+        uint32_t CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
             void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
 
         DescriptorTableCache m_RootDescriptorTable[kMaxNumDescriptorTables];
@@ -147,12 +191,14 @@ private:
 
     bool HasSpace( uint32_t Count )
     {
-        return (m_CurrentHeapPtr != nullptr && m_CurrentOffset + Count <= kNumDescriptorsPerHeap);
+        return (m_CurrentHeapPtr != nullptr && m_CurrentOffset + Count <= m_CurrentCapacity);
     }
 
     void RetireCurrentHeap(void);
     void RetireUsedHeaps( uint64_t fenceValue );
-    ID3D12DescriptorHeap* GetHeapPointer();
+
+    // Retire the current heap or region and start a new one.  Returns true if the bound heap changed.
+    bool AcquireNewHeap(void);
 
     DescriptorHandle Allocate( UINT Count )
     {
@@ -19,6 +19,8 @@
 #include "GameInput.h"
 #include "GpuTimeManager.h"
 #include "CommandContext.h"
+#include "FrameArena.h"
+#include "TextureManager.h"
 #include <vector>
 #include <unordered_map>
 #include <array>
@@ -462,6 +464,26 @@ namespace EngineProfiling
 
         Text.DrawFormattedString( "CPU %7.3f ms, GPU %7.3f ms, %3u Hz\n",
             cpuTime, gpuTime, (uint32_t)(frameRate + 0.5f));
+
+#ifndef RELEASE
+        FrameArena::FrameStats arenaStats = FrameArena::GetFrameStats();
+        Text.DrawFormattedString( "Heap allocations %5u, frame arena %6u KB\n",
+            arenaStats.HeapAllocations, (uint32_t)(arenaStats.ArenaBytes / 1024));
+
+        TextureManager::CacheStats cacheStats = TextureManager::GetCacheStats();
+        Text.DrawFormattedString( "Textures %4u (%u unused), %5u / %5u MB, %u hits, %u misses, %u evicted\n",
+            cacheStats.NumTextures, cacheStats.NumUnreferenced,
+            (uint32_t)(cacheStats.ResidentBytes >> 20), (uint32_t)(cacheStats.BudgetBytes >> 20),
+            (uint32_t)cacheStats.Hits, (uint32_t)cacheStats.Misses, (uint32_t)cacheStats.Evictions);
+
+        TextureManager::StreamingStats streamStats = TextureManager::GetStreamingStats();
+        if (streamStats.NumTextures > 0)
+        {
+            Text.DrawFormattedString( "Streamed textures %4u, %2u in flight, %5u / %5u MB\n",
+                streamStats.NumTextures, streamStats.NumInFlight,
+                (uint32_t)(streamStats.ResidentBytes >> 20), (uint32_t)(streamStats.BudgetBytes >> 20));
+        }
+#endif
     }
 
     void DisplayPerfGraph( GraphicsContext& Context )
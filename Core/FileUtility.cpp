@@ -15,9 +15,24 @@
 #include "FileUtility.h"
 #include <fstream>
 #include <mutex>
+#include <climits>
+#include <algorithm>
+#include <unordered_set>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <ppl.h>
 #include <zlib.h> // From NuGet package 
+#ifdef USE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 using namespace std;
+using namespace concurrency;
 using namespace Utility;
 
 namespace Utility
@@ -25,103 +40,896 @@ namespace Utility
     ByteArray NullFile = make_shared<vector<byte> > (vector<byte>() );
 }
 
-ByteArray DecompressZippedFile( wstring& fileName );
+namespace
+{
+    // Compressed files are read in chunks this size, one ahead of decompression
+    const size_t kReadChunkSize = 256 * 1024;
+
+    // The largest ratio deflate can achieve, for rejecting nonsense sizes
+    const uint64_t kMaxDeflateRatio = 1032;
+
+    // Inflate a gzip or zlib stream from file into dest.  If the output doesn't fit and growable is
+    // given, dest is growable's storage and is enlarged as needed.  While one chunk is being
+    // inflated, the next is read on a background task.
+    int InflateFileStream( ifstream& file, uint64_t fileSize, byte* dest, size_t destSize,
+        vector<byte>* growable, size_t& outSize )
+    {
+        outSize = 0;
+
+        z_stream strm = {};
+        strm.data_type = Z_BINARY;
+        int err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+        if (err != Z_OK)
+            return err;
+
+        unique_ptr<byte[]> buffers[2] = { unique_ptr<byte[]>(new byte[kReadChunkSize]), unique_ptr<byte[]>(new byte[kReadChunkSize]) };
+        uint32_t current = 0;
+        uint64_t unread = fileSize;
+
+        auto StartRead = [&file, &unread]( byte* buffer )
+        {
+            size_t size = (size_t)min<uint64_t>(unread, kReadChunkSize);
+            unread -= size;
+            return create_task( [&file, buffer, size]
+            {
+                file.read((char*)buffer, size);
+                return (size_t)file.gcount();
+            });
+        };
+
+        task<size_t> pendingRead = StartRead(buffers[current].get());
+        bool reading = true;
+
+        while (err == Z_OK)
+        {
+            size_t bytesRead = pendingRead.get();
+            reading = false;
+            if (bytesRead == 0)
+            {
+                // Ran out of input before the end of the stream
+                err = Z_DATA_ERROR;
+                break;
+            }
+
+            strm.next_in = buffers[current].get();
+            strm.avail_in = (uInt)bytesRead;
+
+            current ^= 1;
+            if (unread > 0)
+            {
+                pendingRead = StartRead(buffers[current].get());
+                reading = true;
+            }
+
+            while (strm.avail_in > 0 && err == Z_OK)
+            {
+                byte overflow;
+                if (outSize == destSize && growable != nullptr)
+                {
+                    growable->resize(max(destSize * 2, kReadChunkSize));
+                    dest = growable->data();
+                    destSize = growable->size();
+                }
+
+                // With a full fixed-size destination, inflate into a single spare byte.  The stream
+                // may only have its trailer left, but any more output means it doesn't fit.
+                bool full = outSize == destSize;
+                strm.next_out = full ? &overflow : dest + outSize;
+                strm.avail_out = full ? 1 : (uInt)min<size_t>(destSize - outSize, UINT_MAX);
+
+                err = inflate(&strm, Z_NO_FLUSH);
+
+                if (full)
+                {
+                    if (strm.avail_out == 0)
+                        err = Z_BUF_ERROR;
+                }
+                else
+                {
+                    outSize = strm.next_out - dest;
+                }
+            }
+        }
+
+        if (reading)
+            pendingRead.wait();
+
+        inflateEnd(&strm);
+        return err == Z_STREAM_END ? Z_OK : err;
+    }
+
+    // The uncompressed size from a gzip file's trailer, or 0 if unknown.  The trailer holds the size
+    // modulo 2^32 of the last member only, so this is a starting size rather than a promise.
+    uint64_t ReadGzipSize( ifstream& file, uint64_t fileSize )
+    {
+        if (fileSize < 18)
+            return 0;
+
+        byte header[2], trailer[4];
+        file.read((char*)header, 2);
+        file.seekg(fileSize - 4);
+        file.read((char*)trailer, 4);
+        file.seekg(0);
+
+        if (!file || header[0] != 0x1f || header[1] != 0x8b)
+        {
+            file.clear();
+            file.seekg(0);
+            return 0;
+        }
+
+        uint64_t size = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+        return size <= fileSize * kMaxDeflateRatio ? size : 0;
+    }
+
+    bool OpenFile( const wstring& fileName, ifstream& file, uint64_t& fileSize )
+    {
+        struct _stat64 fileStat;
+        if (_wstat64(fileName.c_str(), &fileStat) == -1)
+            return false;
+
+        file.open(fileName, ios::in | ios::binary);
+        fileSize = fileStat.st_size;
+        return (bool)file;
+    }
+}
 
 ByteArray ReadFileHelper(const wstring& fileName)
 {
-    struct _stat64 fileStat;
-    int fileExists = _wstat64(fileName.c_str(), &fileStat);
-    if (fileExists == -1)
-        return NullFile;
-
-    ifstream file( fileName, ios::in | ios::binary );
-    if (!file)
+    ifstream file;
+    uint64_t fileSize;
+    if (!OpenFile(fileName, file, fileSize))
         return NullFile;
 
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( fileStat.st_size );
+    Utility::ByteArray byteArray = make_shared<vector<byte> >( fileSize );
     file.read( (char*)byteArray->data(), byteArray->size() );
     file.close();
 
     return byteArray;
 }
 
-ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
+ByteArray DecompressZippedFile( const wstring& fileName )
 {
-    std::wstring zippedFileName = *fileName + L".gz";
-    ByteArray firstTry = DecompressZippedFile(zippedFileName);
-    if (firstTry != NullFile)
-        return firstTry;
+    ifstream file;
+    uint64_t fileSize;
+    if (!OpenFile(fileName, file, fileSize))
+        return NullFile;
 
-    return ReadFileHelper(*fileName);
+    // Size the output from the trailer so that it is inflated in place without copying
+    Utility::ByteArray byteArray = make_shared<vector<byte> >( ReadGzipSize(file, fileSize) );
+
+    size_t outSize;
+    int error = InflateFileStream(file, fileSize, byteArray->data(), byteArray->size(), byteArray.get(), outSize);
+    if (error != Z_OK || outSize == 0)
+    {
+        Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
+        return NullFile;
+    }
+
+    byteArray->resize(outSize);
+    return byteArray;
 }
 
-ByteArray Inflate(ByteArray CompressedSource, int& err, uint32_t ChunkSize = 0x100000 ) 
+//
+// Chunked files:  a header, the compressed size of each chunk, then the chunks.  Every chunk but the
+// last holds ChunkSize bytes when decompressed.  A chunk whose compressed size equals its
+// decompressed size is stored uncompressed.
+//
+namespace
 {
-    // Create a dynamic buffer to hold compressed blocks
-    vector<unique_ptr<byte> > blocks;
+    const uint32_t kChunkedFileMagic = 'MCHK';
 
-    z_stream strm  = {};
-    strm.data_type = Z_BINARY;
-    strm.total_in  = strm.avail_in  = (uInt)CompressedSource->size();
-    strm.next_in   = CompressedSource->data();
+    struct ChunkedFileHeader
+    {
+        uint32_t Magic;
+        uint32_t CodecId;
+        uint64_t UncompressedSize;
+        uint32_t ChunkSize;
+        uint32_t NumChunks;
+    };
 
-    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+    size_t DeflateBound( size_t srcSize )
+    {
+        return compressBound((uLong)srcSize);
+    }
 
-    while (err == Z_OK || err == Z_BUF_ERROR)
+    size_t DeflateChunk( const void* src, size_t srcSize, void* dest, size_t destCapacity, int level )
     {
-        strm.avail_out = ChunkSize;
-        strm.next_out = (byte*)malloc(ChunkSize);
-        blocks.emplace_back(strm.next_out);
-        err = inflate(&strm, Z_NO_FLUSH);
+        uLongf destSize = (uLongf)destCapacity;
+        if (compress2((Bytef*)dest, &destSize, (const Bytef*)src, (uLong)srcSize, level == 0 ? Z_DEFAULT_COMPRESSION : level) != Z_OK)
+            return 0;
+        return destSize;
     }
 
-    if (err != Z_STREAM_END) 
+    size_t InflateChunk( const void* src, size_t srcSize, void* dest, size_t destSize )
     {
-        inflateEnd(&strm);
+        uLongf outSize = (uLongf)destSize;
+        if (uncompress((Bytef*)dest, &outSize, (const Bytef*)src, (uLong)srcSize) != Z_OK)
+            return 0;
+        return outSize;
+    }
+
+#ifdef USE_LZ4
+    size_t LZ4Bound( size_t srcSize )
+    {
+        return LZ4_compressBound((int)srcSize);
+    }
+
+    size_t LZ4Chunk( const void* src, size_t srcSize, void* dest, size_t destCapacity, int level )
+    {
+        int size = level > 0 ?
+            LZ4_compress_HC((const char*)src, (char*)dest, (int)srcSize, (int)destCapacity, level) :
+            LZ4_compress_default((const char*)src, (char*)dest, (int)srcSize, (int)destCapacity);
+        return size > 0 ? size : 0;
+    }
+
+    size_t UnLZ4Chunk( const void* src, size_t srcSize, void* dest, size_t destSize )
+    {
+        int size = LZ4_decompress_safe((const char*)src, (char*)dest, (int)srcSize, (int)destSize);
+        return size > 0 ? size : 0;
+    }
+#endif
+
+#ifdef USE_ZSTD
+    size_t ZstdBound( size_t srcSize )
+    {
+        return ZSTD_compressBound(srcSize);
+    }
+
+    size_t ZstdChunk( const void* src, size_t srcSize, void* dest, size_t destCapacity, int level )
+    {
+        size_t size = ZSTD_compress(dest, destCapacity, src, srcSize, level == 0 ? 19 : level);
+        return ZSTD_isError(size) ? 0 : size;
+    }
+
+    size_t UnZstdChunk( const void* src, size_t srcSize, void* dest, size_t destSize )
+    {
+        size_t size = ZSTD_decompress(dest, destSize, src, srcSize);
+        return ZSTD_isError(size) ? 0 : size;
+    }
+#endif
+
+    // Fastest decoders first
+    vector<FileCodec>& GetCodecs( void )
+    {
+        static vector<FileCodec> s_Codecs =
+        {
+#ifdef USE_LZ4
+            { L".lz4", 2, LZ4Bound, LZ4Chunk, UnLZ4Chunk },
+#endif
+#ifdef USE_ZSTD
+            { L".zst", 3, ZstdBound, ZstdChunk, UnZstdChunk },
+#endif
+            { L".zlc", 1, DeflateBound, DeflateChunk, InflateChunk },
+        };
+        return s_Codecs;
+    }
+
+    mutex s_CodecMutex;
+
+    // Validate the header and chunk table of a chunked file.  Returns nullptr if it's damaged or was
+    // written by a different codec.
+    const ChunkedFileHeader* ParseChunkedFile( const byte* data, uint64_t dataSize, const FileCodec& codec )
+    {
+        if (dataSize < sizeof(ChunkedFileHeader))
+            return nullptr;
+
+        const ChunkedFileHeader* header = (const ChunkedFileHeader*)data;
+        if (header->Magic != kChunkedFileMagic || header->CodecId != codec.Id || header->ChunkSize == 0 ||
+            header->NumChunks != (header->UncompressedSize + header->ChunkSize - 1) / header->ChunkSize)
+        {
+            return nullptr;
+        }
+
+        const uint32_t* chunkSizes = (const uint32_t*)(header + 1);
+        uint64_t totalSize = sizeof(ChunkedFileHeader) + header->NumChunks * sizeof(uint32_t);
+        if (totalSize > dataSize)
+            return nullptr;
+
+        // Chunks that don't shrink are stored as they are, so none is larger than ChunkSize
+        for (uint32_t i = 0; i < header->NumChunks; ++i)
+        {
+            if (chunkSizes[i] == 0 || chunkSizes[i] > header->ChunkSize)
+                return nullptr;
+            totalSize += chunkSizes[i];
+        }
+
+        return totalSize == dataSize ? header : nullptr;
+    }
+
+    // Decompress every chunk in parallel into dest, which must hold UncompressedSize bytes.  The chunks
+    // follow the header in memory.
+    bool DecodeChunkedFile( const ChunkedFileHeader& header, const FileCodec& codec, byte* dest )
+    {
+        const byte* base = (const byte*)&header;
+        const uint32_t* chunkSizes = (const uint32_t*)(&header + 1);
+
+        vector<size_t> chunkOffsets(header.NumChunks);
+        size_t offset = sizeof(ChunkedFileHeader) + header.NumChunks * sizeof(uint32_t);
+        for (uint32_t i = 0; i < header.NumChunks; ++i)
+        {
+            chunkOffsets[i] = offset;
+            offset += chunkSizes[i];
+        }
+
+        std::atomic<bool> failed(false);
+        parallel_for(0u, header.NumChunks, [&]( uint32_t i )
+        {
+            uint64_t start = (uint64_t)i * header.ChunkSize;
+            size_t size = (size_t)min<uint64_t>(header.ChunkSize, header.UncompressedSize - start);
+            const byte* src = base + chunkOffsets[i];
+
+            if (chunkSizes[i] == size)
+                memcpy(dest + start, src, size);
+            else if (codec.Decompress(src, chunkSizes[i], dest + start, size) != size)
+                failed = true;
+        });
+
+        return !failed;
+    }
+
+    vector<FileCodec> GetCodecList( void )
+    {
+        lock_guard<mutex> Guard(s_CodecMutex);
+        return GetCodecs();
+    }
+
+    // Read the chunked sibling of fileName for the first codec that has one.  Returns NullFile if
+    // there are none or the one found is damaged.
+    ByteArray ReadChunkedSibling( const wstring& fileName, FileCodec& codec, const ChunkedFileHeader*& header )
+    {
+        for (const FileCodec& candidate : GetCodecList())
+        {
+            ByteArray file = ReadFileHelper(fileName + candidate.Extension);
+            if (file == NullFile)
+                continue;
+
+            header = ParseChunkedFile(file->data(), file->size(), candidate);
+            if (header == nullptr)
+            {
+                Utility::Printf(L"Couldn't decompress file %s%s\n", fileName.c_str(), candidate.Extension);
+                return NullFile;
+            }
+
+            codec = candidate;
+            return file;
+        }
+
         return NullFile;
     }
 
-    ASSERT(strm.total_out > 0, "Nothing to decompress");
+    ByteArray DecompressChunkedFile( const wstring& fileName )
+    {
+        FileCodec codec;
+        const ChunkedFileHeader* header;
+        ByteArray file = ReadChunkedSibling(fileName, codec, header);
+        if (file == NullFile)
+            return NullFile;
+
+        ByteArray byteArray = make_shared<vector<byte> >( header->UncompressedSize );
+        if (!DecodeChunkedFile(*header, codec, byteArray->data()))
+        {
+            Utility::Printf(L"Couldn't decompress file %s%s\n", fileName.c_str(), codec.Extension);
+            return NullFile;
+        }
+
+        return byteArray;
+    }
+}
+
+void Utility::RegisterFileCodec( const FileCodec& codec )
+{
+    lock_guard<mutex> Guard(s_CodecMutex);
+    GetCodecs().push_back(codec);
+}
+
+bool Utility::FindFileCodec( const wstring& extension, FileCodec& codec )
+{
+    for (const FileCodec& candidate : GetCodecList())
+    {
+        if (extension == candidate.Extension)
+        {
+            codec = candidate;
+            return true;
+        }
+    }
+    return false;
+}
 
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( strm.total_out );
+// Compress source into the chunked format, appending it to dest
+static bool CompressChunked( const vector<byte>& source, const FileCodec& codec, int level, size_t chunkSize,
+    vector<byte>& dest )
+{
+    if (chunkSize == 0 || chunkSize > UINT_MAX)
+        return false;
 
-    // Allocate actual memory for this.
-    // copy the bits into that RAM.
-    // Free everything else up!!
-    void* curDest = byteArray->data();
-    size_t remaining = byteArray->size();
+    ChunkedFileHeader header;
+    header.Magic = kChunkedFileMagic;
+    header.CodecId = codec.Id;
+    header.UncompressedSize = source.size();
+    header.ChunkSize = (uint32_t)chunkSize;
+    header.NumChunks = (uint32_t)((source.size() + chunkSize - 1) / chunkSize);
 
-    for (size_t i = 0; i < blocks.size(); ++i)
+    // Compress the chunks in parallel, each into its own buffer
+    vector<vector<byte> > chunks(header.NumChunks);
+    std::atomic<bool> failed(false);
+    parallel_for(0u, header.NumChunks, [&]( uint32_t i )
     {
-        ASSERT(remaining > 0);
+        size_t start = i * chunkSize;
+        size_t size = min(chunkSize, source.size() - start);
+        vector<byte>& chunk = chunks[i];
+        chunk.resize(codec.CompressBound(size));
 
-        size_t CopySize = remaining < ChunkSize ? remaining : ChunkSize;
+        size_t compressedSize = codec.Compress(source.data() + start, size, chunk.data(), chunk.size(), level);
+        if (compressedSize == 0)
+            failed = true;
 
-        memcpy(curDest, blocks[i].get(), CopySize);
-        curDest = (byte*)curDest + CopySize;
-        remaining -= CopySize;
+        // Store chunks that don't shrink as they are
+        if (compressedSize == 0 || compressedSize >= size)
+            chunk.assign(source.data() + start, source.data() + start + size);
+        else
+            chunk.resize(compressedSize);
+    });
+
+    if (failed)
+        return false;
+
+    const byte* headerBytes = (const byte*)&header;
+    dest.insert(dest.end(), headerBytes, headerBytes + sizeof(header));
+    for (const vector<byte>& chunk : chunks)
+    {
+        uint32_t size = (uint32_t)chunk.size();
+        dest.insert(dest.end(), (const byte*)&size, (const byte*)&size + sizeof(size));
     }
+    for (const vector<byte>& chunk : chunks)
+        dest.insert(dest.end(), chunk.begin(), chunk.end());
+
+    return true;
+}
 
-    inflateEnd(&strm);
+bool Utility::CompressFile( const wstring& fileName, const FileCodec& codec, int level, size_t chunkSize )
+{
+    ByteArray source = ReadFileHelper(fileName);
+    vector<byte> compressed;
+    if (source == NullFile || !CompressChunked(*source, codec, level, chunkSize, compressed))
+        return false;
 
-    return byteArray;
+    ofstream file(fileName + codec.Extension, ios::out | ios::binary);
+    file.write((const char*)compressed.data(), compressed.size());
+    return (bool)file;
 }
 
-ByteArray DecompressZippedFile( wstring& fileName )
+//
+// Archives:  a header, the files' data, then a directory of entries sorted by path hash followed by
+// the null-terminated UTF-8 paths.  Paths are lowercase with forward slashes, relative to the
+// working directory the archive was packed from.  Each file's data starts on an Alignment boundary
+// and is either stored as is or in the chunked format of the codec CodecId.
+//
+namespace
 {
-    ByteArray CompressedFile = ReadFileHelper(fileName);
-    if (CompressedFile == NullFile)
-        return NullFile;
+    const uint32_t kArchiveMagic = 'MPAK';
+    const uint32_t kArchiveVersion = 1;
+    const uint32_t kArchiveAlignment = 4096;
 
-    int error;
-    ByteArray DecompressedFile = Inflate(CompressedFile, error);
-    if (DecompressedFile->size() == 0)
+    struct ArchiveHeader
     {
-        Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
-        return NullFile;
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t NumEntries;
+        uint32_t Alignment;
+        uint64_t DirectoryOffset;
+        uint64_t NamesSize;
+    };
+
+    struct ArchiveEntry
+    {
+        uint64_t PathHash;
+        uint64_t Offset;
+        uint64_t StoredSize;
+        uint64_t Size;
+        uint32_t NameOffset;
+        uint32_t CodecId;           // 0 when stored uncompressed
+    };
+
+    // Stored in archives, so this can't use HashState(), which picks a different hash on some CPUs
+    uint64_t HashArchivePath( const string& path )
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : path)
+        {
+            hash ^= (uint8_t)c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    string NormalizeArchivePath( const wstring& fileName )
+    {
+        string path = Utility::WideStringToUTF8(Utility::ToLower(fileName));
+        replace(path.begin(), path.end(), '\\', '/');
+        while (path.compare(0, 2, "./") == 0)
+            path.erase(0, 2);
+        return path;
+    }
+
+    // A memory mapped archive.  The file is opened once, and entries are read straight from the view.
+    class Archive
+    {
+    public:
+        Archive() : m_File(INVALID_HANDLE_VALUE), m_Mapping(nullptr), m_View(nullptr), m_Entries(nullptr), m_Names(nullptr), m_NumEntries(0) {}
+        ~Archive();
+
+        bool Open( const wstring& fileName );
+
+        const ArchiveEntry* Find( const string& path ) const;
+
+        const byte* GetData( const ArchiveEntry& entry ) const { return m_View + entry.Offset; }
+
+    private:
+        Archive( const Archive& ) = delete;
+        Archive& operator=( const Archive& ) = delete;
+
+        HANDLE m_File;
+        HANDLE m_Mapping;
+        const byte* m_View;
+        const ArchiveEntry* m_Entries;
+        const char* m_Names;
+        uint32_t m_NumEntries;
+    };
+
+    Archive::~Archive()
+    {
+        if (m_View != nullptr)
+            UnmapViewOfFile(m_View);
+        if (m_Mapping != nullptr)
+            CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE)
+            CloseHandle(m_File);
+    }
+
+    bool Archive::Open( const wstring& fileName )
+    {
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        m_File = CreateFile2(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+#else
+        m_File = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#endif
+        LARGE_INTEGER fileSize;
+        if (m_File == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(ArchiveHeader))
+            return false;
+
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+        m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping != nullptr)
+            m_View = (const byte*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        m_Mapping = CreateFileMappingFromApp(m_File, nullptr, PAGE_READONLY, 0, nullptr);
+        if (m_Mapping != nullptr)
+            m_View = (const byte*)MapViewOfFileFromApp(m_Mapping, FILE_MAP_READ, 0, 0);
+#endif
+        if (m_View == nullptr)
+            return false;
+
+        // Check everything the lookups rely on once, up front
+        const uint64_t size = fileSize.QuadPart;
+        const ArchiveHeader& header = *(const ArchiveHeader*)m_View;
+        if (header.Magic != kArchiveMagic || header.Version != kArchiveVersion || header.DirectoryOffset > size ||
+            (size - header.DirectoryOffset) / sizeof(ArchiveEntry) < header.NumEntries ||
+            size - header.DirectoryOffset - header.NumEntries * sizeof(ArchiveEntry) != header.NamesSize)
+        {
+            return false;
+        }
+
+        m_NumEntries = header.NumEntries;
+        m_Entries = (const ArchiveEntry*)(m_View + header.DirectoryOffset);
+        m_Names = (const char*)(m_Entries + m_NumEntries);
+
+        if (header.NamesSize > 0 && m_Names[header.NamesSize - 1] != '\0')
+            return false;
+
+        for (uint32_t i = 0; i < m_NumEntries; ++i)
+        {
+            const ArchiveEntry& entry = m_Entries[i];
+            if (entry.Offset > header.DirectoryOffset || entry.StoredSize > header.DirectoryOffset - entry.Offset ||
+                entry.NameOffset >= header.NamesSize || (entry.CodecId == 0 && entry.StoredSize != entry.Size) ||
+                (i > 0 && m_Entries[i - 1].PathHash > entry.PathHash))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    const ArchiveEntry* Archive::Find( const string& path ) const
+    {
+        uint64_t hash = HashArchivePath(path);
+        const ArchiveEntry* entry = lower_bound(m_Entries, m_Entries + m_NumEntries, hash,
+            []( const ArchiveEntry& e, uint64_t h ) { return e.PathHash < h; });
+
+        for (; entry != m_Entries + m_NumEntries && entry->PathHash == hash; ++entry)
+        {
+            if (path == m_Names + entry->NameOffset)
+                return entry;
+        }
+
+        return nullptr;
+    }
+
+    mutex s_ArchiveMutex;
+    vector<shared_ptr<Archive> > s_Archives;
+
+    // Looks in the most recently mounted archive first.  The returned archive keeps the entry mapped.
+    shared_ptr<Archive> FindInArchives( const wstring& fileName, const ArchiveEntry*& entry )
+    {
+        {
+            lock_guard<mutex> Guard(s_ArchiveMutex);
+            if (s_Archives.empty())
+                return nullptr;
+        }
+
+        string path = NormalizeArchivePath(fileName);
+
+        lock_guard<mutex> Guard(s_ArchiveMutex);
+        for (auto it = s_Archives.rbegin(); it != s_Archives.rend(); ++it)
+        {
+            entry = (*it)->Find(path);
+            if (entry != nullptr)
+                return *it;
+        }
+
+        return nullptr;
+    }
+
+    // Check that an entry's size agrees with its stored bytes before anything is sized from it.  Stored
+    // entries were checked against the archive length when it was opened.  Compressed ones must have a
+    // chunk table that accounts for exactly their stored bytes and decompresses to entry.Size.
+    bool ValidateArchiveEntry( const Archive& archive, const ArchiveEntry& entry, FileCodec& codec, const ChunkedFileHeader*& header )
+    {
+        header = nullptr;
+        if (entry.CodecId == 0)
+            return true;
+
+        for (const FileCodec& candidate : GetCodecList())
+        {
+            if (candidate.Id != entry.CodecId)
+                continue;
+
+            codec = candidate;
+            header = ParseChunkedFile(archive.GetData(entry), entry.StoredSize, codec);
+            return header != nullptr && header->UncompressedSize == entry.Size;
+        }
+
+        return false;
+    }
+
+    // Copy or decompress an entry into dest, which must hold entry.Size bytes
+    bool ReadArchiveEntry( const Archive& archive, const ArchiveEntry& entry, byte* dest )
+    {
+        FileCodec codec;
+        const ChunkedFileHeader* header;
+        if (!ValidateArchiveEntry(archive, entry, codec, header))
+            return false;
+
+        if (header == nullptr)
+        {
+            memcpy(dest, archive.GetData(entry), entry.Size);
+            return true;
+        }
+
+        return DecodeChunkedFile(*header, codec, dest);
+    }
+
+    ByteArray ReadFromArchives( const wstring& fileName )
+    {
+        const ArchiveEntry* entry;
+        shared_ptr<Archive> archive = FindInArchives(fileName, entry);
+        if (archive == nullptr)
+            return NullFile;
+
+        FileCodec codec;
+        const ChunkedFileHeader* header;
+        if (!ValidateArchiveEntry(*archive, *entry, codec, header))
+        {
+            Utility::Printf(L"Archive entry for %s is damaged\n", fileName.c_str());
+            return NullFile;
+        }
+
+        ByteArray byteArray = make_shared<vector<byte> >( entry->Size );
+        if (!ReadArchiveEntry(*archive, *entry, byteArray->data()))
+        {
+            Utility::Printf(L"Couldn't read %s from archive\n", fileName.c_str());
+            return NullFile;
+        }
+
+        return byteArray;
     }
 
-    return DecompressedFile;
+    // A file on disk, or its compressed sibling
+    ByteArray ReadLooseFile( const wstring& fileName )
+    {
+        ByteArray chunked = DecompressChunkedFile(fileName);
+        if (chunked != NullFile)
+            return chunked;
+
+        std::wstring zippedFileName = fileName + L".gz";
+        ByteArray firstTry = DecompressZippedFile(zippedFileName);
+        if (firstTry != NullFile)
+            return firstTry;
+
+        return ReadFileHelper(fileName);
+    }
+}
+
+bool Utility::MountArchive( const wstring& archiveFile )
+{
+    shared_ptr<Archive> archive = make_shared<Archive>();
+    if (!archive->Open(archiveFile))
+    {
+        Utility::Printf(L"Couldn't mount archive %s\n", archiveFile.c_str());
+        return false;
+    }
+
+    lock_guard<mutex> Guard(s_ArchiveMutex);
+    s_Archives.push_back(archive);
+    return true;
+}
+
+void Utility::UnmountArchives( void )
+{
+    lock_guard<mutex> Guard(s_ArchiveMutex);
+    s_Archives.clear();
+}
+
+bool Utility::PackArchive( const wstring& archiveFile, const vector<wstring>& files, const wstring& codecExtension, int level )
+{
+    FileCodec codec = {};
+    if (!codecExtension.empty() && !FindFileCodec(codecExtension, codec))
+        return false;
+
+    ofstream file(archiveFile, ios::out | ios::binary);
+    if (!file)
+        return false;
+
+    ArchiveHeader header = {};
+    header.Magic = kArchiveMagic;
+    header.Version = kArchiveVersion;
+    header.Alignment = kArchiveAlignment;
+    file.write((const char*)&header, sizeof(header));
+
+    vector<ArchiveEntry> entries;
+    vector<char> names;
+    unordered_set<string> packed;
+    uint64_t offset = sizeof(header);
+    const byte padding[kArchiveAlignment] = {};
+
+    for (const wstring& fileName : files)
+    {
+        string path = NormalizeArchivePath(fileName);
+        if (!packed.insert(path).second)
+            continue;
+
+        ByteArray data = ReadLooseFile(fileName);
+        if (data == NullFile)
+        {
+            Utility::Printf(L"Couldn't read %s\n", fileName.c_str());
+            return false;
+        }
+
+        // Keep the compressed form only if it saves at least 1/16th
+        vector<byte> compressed;
+        bool useCodec = codec.Extension != nullptr && CompressChunked(*data, codec, level, 1 << 20, compressed) &&
+            compressed.size() < data->size() - data->size() / 16;
+        const vector<byte>& stored = useCodec ? compressed : *data;
+
+        uint64_t alignedOffset = (offset + kArchiveAlignment - 1) & ~(uint64_t)(kArchiveAlignment - 1);
+        file.write((const char*)padding, alignedOffset - offset);
+        file.write((const char*)stored.data(), stored.size());
+        offset = alignedOffset + stored.size();
+
+        ArchiveEntry entry;
+        entry.PathHash = HashArchivePath(path);
+        entry.Offset = alignedOffset;
+        entry.StoredSize = stored.size();
+        entry.Size = data->size();
+        entry.NameOffset = (uint32_t)names.size();
+        entry.CodecId = useCodec ? codec.Id : 0;
+        entries.push_back(entry);
+
+        names.insert(names.end(), path.begin(), path.end());
+        names.push_back('\0');
+    }
+
+    sort(entries.begin(), entries.end(), []( const ArchiveEntry& a, const ArchiveEntry& b ) { return a.PathHash < b.PathHash; });
+
+    header.NumEntries = (uint32_t)entries.size();
+    header.DirectoryOffset = offset;
+    header.NamesSize = names.size();
+    file.write((const char*)entries.data(), entries.size() * sizeof(ArchiveEntry));
+    file.write(names.data(), names.size());
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(header));
+
+    return (bool)file;
+}
+
+ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
+{
+    ByteArray archived = ReadFromArchives(*fileName);
+    if (archived != NullFile)
+        return archived;
+
+    return ReadLooseFile(*fileName);
+}
+
+size_t Utility::GetFileSize( const wstring& fileName )
+{
+    const ArchiveEntry* entry;
+    if (FindInArchives(fileName, entry) != nullptr)
+        return (size_t)entry->Size;
+
+    ifstream file;
+    uint64_t fileSize;
+    for (const FileCodec& codec : GetCodecList())
+    {
+        ChunkedFileHeader header;
+        if (OpenFile(fileName + codec.Extension, file, fileSize) && fileSize >= sizeof(header) &&
+            file.read((char*)&header, sizeof(header)) && header.Magic == kChunkedFileMagic && header.CodecId == codec.Id)
+        {
+            return (size_t)header.UncompressedSize;
+        }
+        file.close();
+    }
+
+    if (OpenFile(fileName + L".gz", file, fileSize))
+        return (size_t)ReadGzipSize(file, fileSize);
+
+    if (OpenFile(fileName, file, fileSize))
+        return (size_t)fileSize;
+
+    return 0;
+}
+
+size_t Utility::ReadFileSync( const wstring& fileName, void* dest, size_t destSize )
+{
+    const ArchiveEntry* entry;
+    shared_ptr<Archive> archive = FindInArchives(fileName, entry);
+    if (archive != nullptr)
+    {
+        if (entry->Size > destSize || !ReadArchiveEntry(*archive, *entry, (byte*)dest))
+            return 0;
+        return (size_t)entry->Size;
+    }
+
+    FileCodec codec;
+    const ChunkedFileHeader* header;
+    ByteArray chunked = ReadChunkedSibling(fileName, codec, header);
+    if (chunked != NullFile)
+    {
+        if (header->UncompressedSize > destSize || !DecodeChunkedFile(*header, codec, (byte*)dest))
+            return 0;
+        return (size_t)header->UncompressedSize;
+    }
+
+    ifstream file;
+    uint64_t fileSize;
+    if (OpenFile(fileName + L".gz", file, fileSize))
+    {
+        size_t outSize;
+        int error = InflateFileStream(file, fileSize, (byte*)dest, destSize, nullptr, outSize);
+        if (error != Z_OK)
+        {
+            Utility::Printf(L"Couldn't unzip file %s.gz:  Error = %d\n", fileName.c_str(), error);
+            return 0;
+        }
+        return outSize;
+    }
+
+    if (!OpenFile(fileName, file, fileSize) || fileSize > destSize)
+        return 0;
+
+    file.read((char*)dest, fileSize);
+    return (size_t)file.gcount();
 }
 
 ByteArray Utility::ReadFileSync( const wstring& fileName)
@@ -129,8 +937,202 @@ ByteArray Utility::ReadFileSync( const wstring& fileName)
     return ReadFileHelperEx(make_shared<wstring>(fileName));
 }
 
-task<ByteArray> Utility::ReadFileAsync(const wstring& fileName)
+ByteArray Utility::ReadLooseFileSync( const wstring& fileName )
+{
+    return ReadFileHelper(fileName);
+}
+
+bool Utility::FileRangeReader::Open( const wstring& fileName )
+{
+    m_Archive = nullptr;
+    m_ArchiveData = nullptr;
+    m_Size = 0;
+    m_Position = 0;
+    m_File.close();
+    m_File.clear();
+
+    const ArchiveEntry* entry;
+    shared_ptr<Archive> archive = FindInArchives(fileName, entry);
+    if (archive != nullptr)
+    {
+        if (entry->CodecId != 0)
+            return false;
+
+        m_Archive = archive;
+        m_ArchiveData = archive->GetData(*entry);
+        m_Size = entry->Size;
+        return true;
+    }
+
+    // Compressed siblings take precedence over the file itself
+    struct _stat64 fileStat;
+    for (const FileCodec& codec : GetCodecList())
+    {
+        if (_wstat64((fileName + codec.Extension).c_str(), &fileStat) == 0)
+            return false;
+    }
+    if (_wstat64((fileName + L".gz").c_str(), &fileStat) == 0)
+        return false;
+
+    return OpenFile(fileName, m_File, m_Size);
+}
+
+bool Utility::FileRangeReader::Read( uint64_t offset, void* dest, size_t size )
+{
+    if (offset > m_Size || size > m_Size - offset)
+        return false;
+
+    if (m_ArchiveData != nullptr)
+    {
+        memcpy(dest, m_ArchiveData + offset, size);
+        return true;
+    }
+
+    // Seeking discards the stream's buffer, so sequential reads don't
+    if (offset != m_Position)
+        m_File.seekg(offset);
+    m_File.read((char*)dest, size);
+    m_Position = offset + size;
+    return (size_t)m_File.gcount() == size;
+}
+
+//
+// Asynchronous reads run on a few dedicated I/O threads.  Each thread takes the queued requests in
+// batches.  Files found in archives or as compressed siblings are resolved first; the plain files
+// left over are then read in turn.
+//
+namespace
+{
+    const size_t kMaxReadBatch = 32;
+
+    struct ReadRequest
+    {
+        wstring FileName;
+        function<void(ByteArray)> OnComplete;
+    };
+
+    mutex s_ReadMutex;
+    condition_variable s_ReadQueued;
+    condition_variable s_ReadsFinished;
+    deque<ReadRequest> s_ReadQueue;
+    vector<thread> s_IOThreads;
+    size_t s_ReadsPending = 0;      // Queued or in progress
+    bool s_StopIOThreads = false;
+
+    void ReadBatch( vector<ReadRequest>& batch, vector<ByteArray>& results )
+    {
+        vector<size_t> plainFiles;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const wstring& fileName = batch[i].FileName;
+            results[i] = ReadFromArchives(fileName);
+            if (results[i] == NullFile)
+                results[i] = DecompressChunkedFile(fileName);
+            if (results[i] == NullFile)
+                results[i] = DecompressZippedFile(fileName + L".gz");
+            if (results[i] == NullFile)
+                plainFiles.push_back(i);
+        }
+
+        for (size_t i : plainFiles)
+            results[i] = ReadFileHelper(batch[i].FileName);
+    }
+
+    void IOThreadMain( void )
+    {
+        vector<ReadRequest> batch;
+        vector<ByteArray> results;
+
+        for (;;)
+        {
+            {
+                unique_lock<mutex> Lock(s_ReadMutex);
+                s_ReadQueued.wait(Lock, [] { return s_StopIOThreads || !s_ReadQueue.empty(); });
+                if (s_ReadQueue.empty())
+                    return;
+
+                // Leave some of a long queue for the other threads
+                size_t count = min(kMaxReadBatch, (s_ReadQueue.size() + s_IOThreads.size() - 1) / s_IOThreads.size());
+                batch.assign(make_move_iterator(s_ReadQueue.begin()), make_move_iterator(s_ReadQueue.begin() + count));
+                s_ReadQueue.erase(s_ReadQueue.begin(), s_ReadQueue.begin() + count);
+            }
+
+            results.assign(batch.size(), NullFile);
+            ReadBatch(batch, results);
+
+            for (size_t i = 0; i < batch.size(); ++i)
+                batch[i].OnComplete(results[i]);
+
+            lock_guard<mutex> Guard(s_ReadMutex);
+            s_ReadsPending -= batch.size();
+            if (s_ReadsPending == 0)
+                s_ReadsFinished.notify_all();
+        }
+    }
+
+    // Threads start with the first read
+    void QueueReads( vector<ReadRequest>& requests )
+    {
+        lock_guard<mutex> Guard(s_ReadMutex);
+
+        if (s_IOThreads.empty())
+        {
+            s_StopIOThreads = false;
+            uint32_t numThreads = max(2u, min(8u, thread::hardware_concurrency() / 2));
+            for (uint32_t i = 0; i < numThreads; ++i)
+                s_IOThreads.emplace_back(IOThreadMain);
+        }
+
+        s_ReadsPending += requests.size();
+        for (ReadRequest& request : requests)
+            s_ReadQueue.push_back(move(request));
+
+        s_ReadQueued.notify_all();
+    }
+}
+
+void Utility::ReadFileAsync( const wstring& fileName, function<void(ByteArray)> onComplete )
+{
+    vector<ReadRequest> requests(1);
+    requests[0].FileName = fileName;
+    requests[0].OnComplete = move(onComplete);
+    QueueReads(requests);
+}
+
+future<ByteArray> Utility::ReadFileAsync( const wstring& fileName )
+{
+    shared_ptr<promise<ByteArray> > result = make_shared<promise<ByteArray> >();
+    ReadFileAsync(fileName, [result]( ByteArray file ) { result->set_value(file); });
+    return result->get_future();
+}
+
+void Utility::ReadFilesAsync( const vector<wstring>& fileNames, function<void(size_t, ByteArray)> onComplete )
+{
+    vector<ReadRequest> requests(fileNames.size());
+    for (size_t i = 0; i < fileNames.size(); ++i)
+    {
+        requests[i].FileName = fileNames[i];
+        requests[i].OnComplete = [i, onComplete]( ByteArray file ) { onComplete(i, file); };
+    }
+    QueueReads(requests);
+}
+
+void Utility::WaitForFileReads( void )
 {
-    shared_ptr<wstring> SharedPtr = make_shared<wstring>(fileName);
-    return create_task( [=] { return ReadFileHelperEx(SharedPtr); } );
+    unique_lock<mutex> Lock(s_ReadMutex);
+    s_ReadsFinished.wait(Lock, [] { return s_ReadsPending == 0; });
+}
+
+void Utility::ShutdownFileIO( void )
+{
+    {
+        lock_guard<mutex> Guard(s_ReadMutex);
+        s_StopIOThreads = true;
+    }
+    s_ReadQueued.notify_all();
+
+    // Threads finish what is queued before stopping
+    for (thread& ioThread : s_IOThreads)
+        ioThread.join();
+    s_IOThreads.clear();
 }
@@ -16,22 +16,100 @@
 #include "pch.h"
 #include <vector>
 #include <string>
-#include <ppl.h>
+#include <functional>
+#include <future>
+#include <fstream>
 
 namespace Utility
 {
     using namespace std;
-    using namespace concurrency;
 
     typedef shared_ptr<vector<byte> > ByteArray;
     extern ByteArray NullFile;
 
-    // Reads the entire contents of a binary file.  If the file with the same name except with an additional
-    // ".gz" suffix exists, it will be loaded and decompressed instead.
+    // Reads the entire contents of a binary file, from a mounted archive if one holds it.  Otherwise, if the
+    // file with the same name except with an additional codec suffix (see FileCodec) or ".gz" suffix
+    // exists, it will be loaded and decompressed instead.
     // This operation blocks until the entire file is read.
     ByteArray ReadFileSync(const wstring& fileName);
 
-    // Same as previous except that it does not block but instead returns a task.
-    task<ByteArray> ReadFileAsync(const wstring& fileName);
+    // Reads the file on disk exactly as named, ignoring archives and compressed siblings.  For reading
+    // back a file that was just written.
+    ByteArray ReadLooseFileSync(const wstring& fileName);
+
+    // Same as previous except that it does not block.  Reads run on a small pool of I/O threads, so
+    // callbacks should hand any heavy processing of the file off to another thread.
+    future<ByteArray> ReadFileAsync(const wstring& fileName);
+    void ReadFileAsync(const wstring& fileName, function<void(ByteArray)> onComplete);
+
+    // Queues several reads at once.  onComplete receives each file's index in fileNames as it finishes,
+    // in any order.  Batches let the I/O threads keep many reads in flight.
+    void ReadFilesAsync(const vector<wstring>& fileNames, function<void(size_t, ByteArray)> onComplete);
+
+    // Blocks until every queued read has completed
+    void WaitForFileReads(void);
+
+    // Finishes queued reads and stops the I/O threads.  They start again with the next read.
+    void ShutdownFileIO(void);
+
+    // Reads a file from an archive or disk, or decompresses its codec or ".gz" sibling, directly into a
+    // buffer.  Returns the number of bytes written, or 0 if the file is missing, damaged, or larger than
+    // destSize.
+    size_t ReadFileSync(const wstring& fileName, void* dest, size_t destSize);
+
+    // The size ReadFileSync() will produce, without reading the file.  For compressed files this
+    // comes from the chunk header or gzip trailer, and is 0 if a ".gz" file isn't gzip.  Returns 0 if the file is missing.
+    size_t GetFileSize(const wstring& fileName);
+
+    // Reads parts of a file without loading all of it, from a mounted archive or disk.  Files that exist
+    // only compressed can't be opened this way and must be read whole.
+    class FileRangeReader
+    {
+    public:
+        FileRangeReader() : m_ArchiveData(nullptr), m_Size(0), m_Position(0) {}
+
+        bool Open(const wstring& fileName);
+        uint64_t GetSize(void) const { return m_Size; }
+
+        // Fails if the range extends past the end of the file
+        bool Read(uint64_t offset, void* dest, size_t size);
+
+    private:
+        shared_ptr<void> m_Archive;     // Keeps the archive mapped
+        const byte* m_ArchiveData;
+        ifstream m_File;
+        uint64_t m_Size;
+        uint64_t m_Position;
+    };
+
+    // A block compressor for chunked asset files.  Chunked files are split into independently compressed
+    // chunks so that they decompress in parallel.  Compress and Decompress return the size written, or 0
+    // on failure; Decompress must fill the whole destination.  Level 0 is the codec's default.
+    struct FileCodec
+    {
+        const wchar_t* Extension;       // Appended to the original file name, e.g. L".lz4"
+        uint32_t Id;                    // Stored in the file so a misnamed file isn't misread
+        size_t (*CompressBound)(size_t srcSize);
+        size_t (*Compress)(const void* src, size_t srcSize, void* dest, size_t destCapacity, int level);
+        size_t (*Decompress)(const void* src, size_t srcSize, void* dest, size_t destSize);
+    };
+
+    // ".zlc" (chunked zlib) is always available.  ".lz4" and ".zst" are built in when USE_LZ4 or
+    // USE_ZSTD are defined.  Readers try codecs in the order they were registered.
+    void RegisterFileCodec(const FileCodec& codec);
+    bool FindFileCodec(const wstring& extension, FileCodec& codec);
+
+    // Writes fileName plus the codec's extension next to fileName
+    bool CompressFile(const wstring& fileName, const FileCodec& codec, int level = 0, size_t chunkSize = 1 << 20);
+
+    // Archives pack many files into one file that is opened and memory mapped once.  While archives are
+    // mounted, the reads above look in them before the file system, most recently mounted first.  Paths
+    // are matched without case, relative to the working directory the archive was packed from.
+    bool MountArchive(const wstring& archiveFile);
+    void UnmountArchives(void);
+
+    // Packs loose files into an archive.  With a codec extension, each file is compressed if that makes it
+    // meaningfully smaller.
+    bool PackArchive(const wstring& archiveFile, const vector<wstring>& files, const wstring& codecExtension = L"", int level = 0);
 
 } // namespace Utility
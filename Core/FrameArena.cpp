@@ -0,0 +1,151 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "FrameArena.h"
+#include <atomic>
+#include <cstdlib>
+
+#ifndef RELEASE
+
+static std::atomic<uint32_t> s_HeapAllocations(0);
+
+static void* CountedAlloc( size_t Size )
+{
+    s_HeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(Size == 0 ? 1 : Size);
+}
+
+void* operator new( size_t Size )
+{
+    void* Memory = CountedAlloc(Size);
+    if (Memory == nullptr)
+        throw std::bad_alloc();
+    return Memory;
+}
+
+void* operator new[]( size_t Size )
+{
+    void* Memory = CountedAlloc(Size);
+    if (Memory == nullptr)
+        throw std::bad_alloc();
+    return Memory;
+}
+
+void* operator new( size_t Size, const std::nothrow_t& ) noexcept { return CountedAlloc(Size); }
+void* operator new[]( size_t Size, const std::nothrow_t& ) noexcept { return CountedAlloc(Size); }
+void operator delete( void* Memory ) noexcept { std::free(Memory); }
+void operator delete[]( void* Memory ) noexcept { std::free(Memory); }
+void operator delete( void* Memory, const std::nothrow_t& ) noexcept { std::free(Memory); }
+void operator delete[]( void* Memory, const std::nothrow_t& ) noexcept { std::free(Memory); }
+void operator delete( void* Memory, size_t ) noexcept { std::free(Memory); }
+void operator delete[]( void* Memory, size_t ) noexcept { std::free(Memory); }
+
+#endif
+
+LinearArena::LinearArena( size_t ChunkSize ) :
+    m_ChunkSize(ChunkSize), m_Offset(0), m_BytesUsed(0), m_Capacity(0)
+{
+}
+
+LinearArena::~LinearArena()
+{
+    for (auto& Chunk : m_Chunks)
+        std::free(Chunk.Memory);
+}
+
+void LinearArena::AddChunk( size_t MinSize )
+{
+    Chunk NewChunk;
+    NewChunk.Size = MinSize > m_ChunkSize ? MinSize : m_ChunkSize;
+    NewChunk.Memory = (uint8_t*)std::malloc(NewChunk.Size);
+    ASSERT(NewChunk.Memory != nullptr, "Out of memory for frame arena");
+
+    // Any space left at the end of the previous chunk counts as used
+    if (!m_Chunks.empty())
+        m_BytesUsed += m_Chunks.back().Size - m_Offset;
+
+    m_Chunks.push_back(NewChunk);
+    m_Offset = 0;
+    m_Capacity += NewChunk.Size;
+}
+
+void* LinearArena::Allocate( size_t Size, size_t Alignment )
+{
+    ASSERT(Math::IsPowerOfTwo(Alignment));
+
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    size_t AlignedOffset = 0;
+    if (!m_Chunks.empty())
+        AlignedOffset = Math::AlignUp((size_t)m_Chunks.back().Memory + m_Offset, Alignment) - (size_t)m_Chunks.back().Memory;
+
+    if (m_Chunks.empty() || AlignedOffset + Size > m_Chunks.back().Size)
+    {
+        AddChunk(Size + Alignment);
+        AlignedOffset = Math::AlignUp((size_t)m_Chunks.back().Memory, Alignment) - (size_t)m_Chunks.back().Memory;
+    }
+
+    m_BytesUsed += AlignedOffset + Size - m_Offset;
+    m_Offset = AlignedOffset + Size;
+    return m_Chunks.back().Memory + AlignedOffset;
+}
+
+void LinearArena::Reset( void )
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    if (m_Chunks.size() > 1)
+    {
+        for (auto& Chunk : m_Chunks)
+            std::free(Chunk.Memory);
+        m_Chunks.clear();
+
+        // Grow the default so the next spill isn't far off
+        m_ChunkSize = Math::AlignUp(m_Capacity, 64 * 1024);
+        m_Capacity = 0;
+        AddChunk(m_ChunkSize);
+    }
+
+    m_Offset = 0;
+    m_BytesUsed = 0;
+}
+
+namespace FrameArena
+{
+    static LinearArena s_Arenas[kNumBufferedFrames];
+    static uint32_t s_CurrentArena = 0;
+    static FrameStats s_LastFrameStats = {};
+}
+
+LinearArena& FrameArena::Get( void )
+{
+    return s_Arenas[s_CurrentArena];
+}
+
+void FrameArena::BeginFrame( void )
+{
+    s_LastFrameStats.ArenaBytes = s_Arenas[s_CurrentArena].GetBytesUsed();
+#ifndef RELEASE
+    s_LastFrameStats.HeapAllocations = s_HeapAllocations.exchange(0, std::memory_order_relaxed);
+#endif
+
+    s_CurrentArena = (s_CurrentArena + 1) % kNumBufferedFrames;
+    s_Arenas[s_CurrentArena].Reset();
+}
+
+FrameArena::FrameStats FrameArena::GetFrameStats( void )
+{
+    return s_LastFrameStats;
+}
+
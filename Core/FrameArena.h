@@ -0,0 +1,125 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Bump allocation for CPU data that lives no longer than a frame, such as sort keys and draw lists.
+// A LinearArena hands out memory from large chunks and frees everything at once on Reset().  The
+// FrameArena keeps one LinearArena per buffered frame and resets the oldest when a frame begins, so
+// memory allocated during a frame stays valid until the swap chain has cycled back to it.
+//
+// ArenaAllocator adapts an arena to the STL so containers can be built on it.  Deallocation is a
+// no-op; the memory comes back when the arena is reset.
+//
+// In non-release builds, global operator new is replaced with a counting version so the number of
+// heap allocations made each frame can be shown and driven toward zero.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+class LinearArena
+{
+public:
+    explicit LinearArena( size_t ChunkSize = 1024 * 1024 );
+    ~LinearArena();
+
+    // Thread-safe.  Never returns nullptr.
+    void* Allocate( size_t Size, size_t Alignment = 16 );
+
+    // Free every allocation.  If the last cycle spilled into more than one chunk, they are replaced
+    // by a single chunk large enough to hold all of it, so a steady workload stops allocating.
+    void Reset( void );
+
+    size_t GetBytesUsed( void ) const { return m_BytesUsed; }
+    size_t GetCapacity( void ) const { return m_Capacity; }
+
+private:
+    LinearArena( const LinearArena& );
+    LinearArena& operator=( const LinearArena& );
+
+    struct Chunk
+    {
+        uint8_t* Memory;
+        size_t Size;
+    };
+
+    void AddChunk( size_t MinSize );
+
+    std::mutex m_Mutex;
+    std::vector<Chunk> m_Chunks;
+    size_t m_ChunkSize;
+    size_t m_Offset;        // Into the last chunk
+    size_t m_BytesUsed;     // Across all chunks, including alignment padding
+    size_t m_Capacity;
+};
+
+namespace FrameArena
+{
+    // Must match the number of frames the swap chain can have in flight
+    enum { kNumBufferedFrames = 3 };
+
+    // The arena for the frame being recorded
+    LinearArena& Get( void );
+
+    inline void* Allocate( size_t Size, size_t Alignment = 16 ) { return Get().Allocate(Size, Alignment); }
+
+    // Called by Display::Present().  Latches this frame's counters, then moves to the next arena and
+    // resets it.
+    void BeginFrame( void );
+
+    struct FrameStats
+    {
+        size_t ArenaBytes;          // Bytes handed out by the frame arena
+        uint32_t HeapAllocations;   // Calls to global operator new, from any thread.  Zero in release builds.
+    };
+
+    FrameStats GetFrameStats( void );
+}
+
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    // Defaults to the arena for the current frame
+    ArenaAllocator() : m_Arena(&FrameArena::Get()) {}
+    explicit ArenaAllocator( LinearArena& Arena ) : m_Arena(&Arena) {}
+
+    template <typename U>
+    ArenaAllocator( const ArenaAllocator<U>& Other ) : m_Arena(Other.GetArena()) {}
+
+    T* allocate( size_t Count )
+    {
+        return static_cast<T*>(m_Arena->Allocate(Count * sizeof(T), alignof(T) < 16 ? 16 : alignof(T)));
+    }
+
+    void deallocate( T*, size_t ) {}
+
+    LinearArena* GetArena( void ) const { return m_Arena; }
+
+private:
+    LinearArena* m_Arena;
+};
+
+template <typename T, typename U>
+inline bool operator==( const ArenaAllocator<T>& A, const ArenaAllocator<U>& B ) { return A.GetArena() == B.GetArena(); }
+
+template <typename T, typename U>
+inline bool operator!=( const ArenaAllocator<T>& A, const ArenaAllocator<U>& B ) { return A.GetArena() != B.GetArena(); }
+
+// A vector whose storage comes from the current frame's arena
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -21,6 +21,7 @@
 #include "PostEffects.h"
 #include "Display.h"
 #include "Util/CommandLineArg.h"
+#include "FileUtility.h"
 #include <shellapi.h>
 
 #pragma comment(lib, "runtimeobject.lib") 
@@ -37,6 +38,11 @@ namespace GameCore
         LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
         CommandLineArgs::Initialize(argc, argv);
 
+        // Mount before anything is loaded so that the PSO cache and fonts come from the archive too
+        std::wstring archiveFile;
+        if (CommandLineArgs::GetString(L"archive", archiveFile))
+            Utility::MountArchive(archiveFile);
+
         Graphics::Initialize();
         SystemTime::Initialize();
         GameInput::Initialize();
@@ -52,6 +58,9 @@ namespace GameCore
         game.Cleanup();
 
         GameInput::Shutdown();
+
+        Utility::ShutdownFileIO();
+        Utility::UnmountArchives();
     }
 
     bool UpdateApplication( IGameApp& game )
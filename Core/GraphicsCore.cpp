@@ -49,6 +49,7 @@ namespace Graphics
 
     bool g_bTypedUAVLoadSupport_R11G11B10_FLOAT = false;
     bool g_bTypedUAVLoadSupport_R16G16B16A16_FLOAT = false;
+    D3D12_RESOURCE_BINDING_TIER g_ResourceBindingTier = D3D12_RESOURCE_BINDING_TIER_1;
 
     ID3D12Device* g_Device = nullptr;
     CommandListManager g_CommandManager;
@@ -153,6 +154,13 @@ namespace Graphics
 // Initialize the DirectX resources required to run.
 void Graphics::Initialize(void)
 {
+    // Reuse pipelines compiled by earlier runs.  Use -psocache 0 to compile everything from scratch.
+    // The file is read in the background while the device is created.
+    uint32_t usePSOCache = 1;
+    CommandLineArgs::GetInteger(L"psocache", usePSOCache);
+    if (usePSOCache)
+        PSO::LoadCache(L"PipelineCache.bin");
+
     Microsoft::WRL::ComPtr<ID3D12Device> pDevice;
 
     uint32_t useDebugLayers = 0;
@@ -347,6 +355,8 @@ void Graphics::Initialize(void)
     D3D12_FEATURE_DATA_D3D12_OPTIONS FeatureData = {};
     if (SUCCEEDED(g_Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &FeatureData, sizeof(FeatureData))))
     {
+        g_ResourceBindingTier = FeatureData.ResourceBindingTier;
+
         if (FeatureData.TypedUAVLoadAdditionalFormats)
         {
             D3D12_FEATURE_DATA_FORMAT_SUPPORT Support =
@@ -394,8 +404,10 @@ void Graphics::Shutdown( void )
     CommandContext::DestroyAllContexts();
     g_CommandManager.Shutdown();
     GpuTimeManager::Shutdown();
+    PSO::SaveCache();
     PSO::DestroyAll();
     RootSignature::DestroyAll();
+
     DescriptorAllocator::DestroyAll();
 
     DestroyCommonState();
@@ -43,10 +43,17 @@ namespace Graphics
     extern D3D_FEATURE_LEVEL g_D3DFeatureLevel;
     extern bool g_bTypedUAVLoadSupport_R11G11B10_FLOAT;
     extern bool g_bTypedUAVLoadSupport_R16G16B16A16_FLOAT;
+    extern D3D12_RESOURCE_BINDING_TIER g_ResourceBindingTier;
 
     extern DescriptorAllocator g_DescriptorAllocator[];
     inline D3D12_CPU_DESCRIPTOR_HANDLE AllocateDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE Type, UINT Count = 1 )
     {
         return g_DescriptorAllocator[Type].Allocate(Count);
     }
+
+    // The descriptors are reused once the GPU is done with work submitted so far
+    inline void FreeDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE Type, D3D12_CPU_DESCRIPTOR_HANDLE Handle, UINT Count = 1 )
+    {
+        g_DescriptorAllocator[Type].Free(Handle, Count);
+    }
 }
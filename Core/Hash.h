@@ -12,49 +12,197 @@
 
 #pragma once
 
-#include "Math/Common.h"
-
-// This requires SSE4.2 which is present on Intel Nehalem (Nov. 2008)
-// and AMD Bulldozer (Oct. 2011) processors.  I could put a runtime
-// check for this, but I'm just going to assume people playing with
-// DirectX 12 on Windows 10 have fairly recent machines.
-#ifdef _M_X64
-#define ENABLE_SSE_CRC32 1
-#else
-#define ENABLE_SSE_CRC32 0
-#endif
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
-#if ENABLE_SSE_CRC32
-#pragma intrinsic(_mm_crc32_u32)
-#pragma intrinsic(_mm_crc32_u64)
+// State hashing uses the CRC32C instruction (SSE4.2 on x64, the CRC extension on ARMv8) when the
+// CPU has it, and otherwise falls back to a multi-lane multiply-rotate hash in the style of
+// xxHash64.  The choice is made once at run time, so a single binary runs everywhere.  Hash
+// values are only meaningful within a process because the paths produce different results.
+#if defined(_M_X64) || defined(__x86_64__)
+    #define ENABLE_HW_CRC32 1
+    #include <nmmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define HW_CRC32_TARGET
+    #else
+        #include <cpuid.h>
+        #define HW_CRC32_TARGET __attribute__((target("sse4.2")))
+    #endif
+    #define HW_CRC32_U32(Crc, Value) _mm_crc32_u32(Crc, Value)
+    #define HW_CRC32_U64(Crc, Value) _mm_crc32_u64(Crc, Value)
+#elif defined(_M_ARM64) || defined(__aarch64__)
+    #define ENABLE_HW_CRC32 1
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define HW_CRC32_TARGET
+    #else
+        #include <arm_acle.h>
+        #ifdef __linux__
+            #include <sys/auxv.h>
+            #include <asm/hwcap.h>
+        #endif
+        #define HW_CRC32_TARGET __attribute__((target("+crc")))
+    #endif
+    #define HW_CRC32_U32(Crc, Value) __crc32cw(Crc, Value)
+    #define HW_CRC32_U64(Crc, Value) __crc32cd(Crc, Value)
+#else
+    #define ENABLE_HW_CRC32 0
 #endif
 
 namespace Utility
 {
-    inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
+    namespace HashImpl
     {
-#if ENABLE_SSE_CRC32
-        const uint64_t* Iter64 = (const uint64_t*)Math::AlignUp(Begin, 8);
-        const uint64_t* const End64 = (const uint64_t* const)Math::AlignDown(End, 8);
+        static const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+        static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+        static const uint64_t kPrime3 = 0x165667B19E3779F9ull;
+        static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+        static const uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+        inline uint64_t Read64( const uint8_t* Ptr ) { uint64_t Value; memcpy(&Value, Ptr, 8); return Value; }
+        inline uint32_t Read32( const uint8_t* Ptr ) { uint32_t Value; memcpy(&Value, Ptr, 4); return Value; }
+        inline uint64_t RotateLeft( uint64_t Value, int Bits ) { return (Value << Bits) | (Value >> (64 - Bits)); }
+
+        inline uint64_t Round( uint64_t Acc, uint64_t Input )
+        {
+            Acc += Input * kPrime2;
+            return RotateLeft(Acc, 31) * kPrime1;
+        }
+
+        inline uint64_t MergeRound( uint64_t Acc, uint64_t Lane )
+        {
+            Acc ^= Round(0, Lane);
+            return Acc * kPrime1 + kPrime4;
+        }
+
+        inline uint64_t Avalanche( uint64_t Hash )
+        {
+            Hash ^= Hash >> 33;
+            Hash *= kPrime2;
+            Hash ^= Hash >> 29;
+            Hash *= kPrime3;
+            Hash ^= Hash >> 32;
+            return Hash;
+        }
+
+        // Four independent lanes over 32-byte stripes keep several multiplies in flight at once
+        inline uint64_t HashRangePortable( const uint32_t* Begin, const uint32_t* End, uint64_t Seed )
+        {
+            const uint8_t* Iter = (const uint8_t*)Begin;
+            const uint8_t* const Last = (const uint8_t*)End;
+            const uint64_t Length = (uint64_t)(Last - Iter);
+            uint64_t Hash;
+
+            if (Length >= 32)
+            {
+                uint64_t Lane1 = Seed + kPrime1 + kPrime2;
+                uint64_t Lane2 = Seed + kPrime2;
+                uint64_t Lane3 = Seed;
+                uint64_t Lane4 = Seed - kPrime1;
+
+                do
+                {
+                    Lane1 = Round(Lane1, Read64(Iter));
+                    Lane2 = Round(Lane2, Read64(Iter + 8));
+                    Lane3 = Round(Lane3, Read64(Iter + 16));
+                    Lane4 = Round(Lane4, Read64(Iter + 24));
+                    Iter += 32;
+                }
+                while (Last - Iter >= 32);
+
+                Hash = RotateLeft(Lane1, 1) + RotateLeft(Lane2, 7) + RotateLeft(Lane3, 12) + RotateLeft(Lane4, 18);
+                Hash = MergeRound(Hash, Lane1);
+                Hash = MergeRound(Hash, Lane2);
+                Hash = MergeRound(Hash, Lane3);
+                Hash = MergeRound(Hash, Lane4);
+            }
+            else
+            {
+                Hash = Seed + kPrime5;
+            }
+
+            Hash += Length;
+
+            for (; Last - Iter >= 8; Iter += 8)
+                Hash = RotateLeft(Hash ^ Round(0, Read64(Iter)), 27) * kPrime1 + kPrime4;
+
+            if (Last - Iter >= 4)
+                Hash = RotateLeft(Hash ^ (Read32(Iter) * kPrime1), 23) * kPrime2 + kPrime3;
 
-        // If not 64-bit aligned, start with a single u32
-        if ((uint32_t*)Iter64 > Begin)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *Begin);
+            return Avalanche(Hash);
+        }
 
-        // Iterate over consecutive u64 values
-        while (Iter64 < End64)
-            Hash = _mm_crc32_u64((uint64_t)Hash, *Iter64++);
+#if ENABLE_HW_CRC32
+        // Two CRC lanes over alternating words hide the instruction's latency and together
+        // produce 64 bits instead of 32
+        HW_CRC32_TARGET inline uint64_t HashRangeCRC( const uint32_t* Begin, const uint32_t* End, uint64_t Seed )
+        {
+            const uint8_t* Iter = (const uint8_t*)Begin;
+            const uint8_t* const Last = (const uint8_t*)End;
+            uint64_t Lane1 = (uint32_t)Seed;
+            uint64_t Lane2 = (uint32_t)(Seed >> 32) ^ (uint32_t)kPrime5;
 
-        // If there is a 32-bit remainder, accumulate that
-        if ((uint32_t*)Iter64 < End)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *(uint32_t*)Iter64);
+            for (; Last - Iter >= 16; Iter += 16)
+            {
+                Lane1 = HW_CRC32_U64(Lane1, Read64(Iter));
+                Lane2 = HW_CRC32_U64(Lane2, Read64(Iter + 8));
+            }
+
+            if (Last - Iter >= 8)
+            {
+                Lane1 = HW_CRC32_U64(Lane1, Read64(Iter));
+                Iter += 8;
+            }
+
+            if (Last - Iter >= 4)
+                Lane2 = HW_CRC32_U32((uint32_t)Lane2, Read32(Iter));
+
+            // Mix the length in so that runs of zeros of different lengths differ
+            return Avalanche((Lane2 << 32 | (uint32_t)Lane1) + (uint64_t)(Last - (const uint8_t*)Begin) * kPrime1);
+        }
+
+        inline bool CPUSupportsCRC32C( void )
+        {
+#if defined(_M_X64) || defined(__x86_64__)
+    #ifdef _MSC_VER
+            int CPUInfo[4];
+            __cpuid(CPUInfo, 1);
+            return (CPUInfo[2] & (1 << 20)) != 0;
+    #else
+            unsigned int EAX, EBX, ECX, EDX;
+            return __get_cpuid(1, &EAX, &EBX, &ECX, &EDX) && (ECX & bit_SSE4_2) != 0;
+    #endif
+#elif defined(_WIN32)
+            return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != FALSE;
+#elif defined(__linux__)
+            return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#elif defined(__APPLE__)
+            return true;
 #else
-        // An inexpensive hash for CPUs lacking SSE4.2
-        for (const uint32_t* Iter = Begin; Iter < End; ++Iter)
-            Hash = 16777619U * Hash ^ *Iter;
+            return false;
+#endif
+        }
+#endif // ENABLE_HW_CRC32
+
+        typedef uint64_t (*HashRangeFunc)( const uint32_t*, const uint32_t*, uint64_t );
+
+        inline HashRangeFunc SelectHashRange( void )
+        {
+#if ENABLE_HW_CRC32
+            if (CPUSupportsCRC32C())
+                return HashRangeCRC;
 #endif
+            return HashRangePortable;
+        }
 
-        return Hash;
+    } // namespace HashImpl
+
+    inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
+    {
+        static const HashImpl::HashRangeFunc s_HashRange = HashImpl::SelectHashRange();
+        return (size_t)s_HashRange(Begin, End, Hash);
     }
 
     template <typename T> inline size_t HashState( const T* StateDesc, size_t Count = 1, size_t Hash = 2166136261U )
@@ -63,4 +211,11 @@ namespace Utility
         return HashRange((uint32_t*)StateDesc, (uint32_t*)(StateDesc + Count), Hash);
     }
 
+    // The same result on every CPU, for hashes that are saved to disk or compared between machines
+    template <typename T> inline uint64_t HashStatePortable( const T* StateDesc, size_t Count = 1, uint64_t Hash = 2166136261U )
+    {
+        static_assert((sizeof(T) & 3) == 0 && alignof(T) >= 4, "State object is not word-aligned");
+        return HashImpl::HashRangePortable((const uint32_t*)StateDesc, (const uint32_t*)(StateDesc + Count), Hash);
+    }
+
 } // namespace Utility
@@ -24,6 +24,8 @@ using namespace std;
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
 
 LinearAllocatorPageManager::LinearAllocatorPageManager()
+    : m_PagePool(LinearAllocationPageProvider(sm_AutoType),
+        [](uint64_t FenceValue) { return g_CommandManager.IsFenceComplete(FenceValue); })
 {
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
@@ -32,57 +34,20 @@ LinearAllocatorPageManager::LinearAllocatorPageManager()
 
 LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
-LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
-{
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
-    {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
-    }
-
-    LinearAllocationPage* PagePtr = nullptr;
-
-    if (!m_AvailablePages.empty())
-    {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
-    }
-    else
-    {
-        PagePtr = CreateNewPage();
-        m_PagePool.emplace_back(PagePtr);
-    }
-
-    return PagePtr;
-}
-
 void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+    m_PagePool.DiscardPages(FenceValue, UsedPages);
 }
 
 void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
-    {
-        delete m_DeletionQueue.front().second;
-        m_DeletionQueue.pop();
-    }
-
     for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
-    {
         (*iter)->Unmap();
-        m_DeletionQueue.push(make_pair(FenceValue, *iter));
-    }
+
+    m_PagePool.FreeLargePages(FenceValue, LargePages);
 }
 
-LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
+LinearAllocationPage* LinearAllocationPageProvider::CreatePage( size_t PageSize )
 {
     D3D12_HEAP_PROPERTIES HeapProps;
     HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
@@ -134,7 +99,7 @@ void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
 
     m_RetiredPages.push_back(m_CurPage);
     m_CurPage = nullptr;
-    m_CurOffset = 0;
+    m_Offsets.EndPage();
 
     sm_PageManager[m_AllocationType].DiscardPages(FenceID, m_RetiredPages);
     m_RetiredPages.clear();
@@ -165,29 +130,24 @@ DynAlloc LinearAllocator::Allocate(size_t SizeInBytes, size_t Alignment)
     // Align the allocation
     const size_t AlignedSize = Math::AlignUpWithMask(SizeInBytes, AlignmentMask);
 
-    if (AlignedSize > m_PageSize)
+    if (AlignedSize > m_Offsets.GetPageSize())
         return AllocateLargePage(AlignedSize);
 
-    m_CurOffset = Math::AlignUp(m_CurOffset, Alignment);
+    size_t Offset = m_Offsets.Allocate(AlignedSize, Alignment);
 
-    if (m_CurOffset + AlignedSize > m_PageSize)
+    if (Offset == AllocatorCore::LinearOffsetAllocator::kInvalidOffset)
     {
-        ASSERT(m_CurPage != nullptr);
-        m_RetiredPages.push_back(m_CurPage);
-        m_CurPage = nullptr;
-    }
+        if (m_CurPage != nullptr)
+            m_RetiredPages.push_back(m_CurPage);
 
-    if (m_CurPage == nullptr)
-    {
         m_CurPage = sm_PageManager[m_AllocationType].RequestPage();
-        m_CurOffset = 0;
+        m_Offsets.StartPage();
+        Offset = m_Offsets.Allocate(AlignedSize, Alignment);
     }
 
-    DynAlloc ret(*m_CurPage, m_CurOffset, AlignedSize);
-    ret.DataPtr = (uint8_t*)m_CurPage->m_CpuVirtualAddress + m_CurOffset;
-    ret.GpuAddress = m_CurPage->m_GpuVirtualAddress + m_CurOffset;
-
-    m_CurOffset += AlignedSize;
+    DynAlloc ret(*m_CurPage, Offset, AlignedSize);
+    ret.DataPtr = (uint8_t*)m_CurPage->m_CpuVirtualAddress + Offset;
+    ret.GpuAddress = m_CurPage->m_GpuVirtualAddress + Offset;
 
     return ret;
 }
@@ -13,8 +13,8 @@
 // Description:  This is a dynamic graphics memory allocator for DX12.  It's designed to work in concert
 // with the CommandContext class and to do so in a thread-safe manner.  There may be many command contexts,
 // each with its own linear allocators.  They act as windows into a global memory pool by reserving a
-// context-local memory page.  Requesting a new page is done in a thread-safe manner by guarding accesses
-// with a mutex lock.
+// context-local memory page.  Page recycling and offset bookkeeping are done by the device-independent
+// FencedPagePool and LinearOffsetAllocator in AllocatorCore.h; this file supplies the D3D12 pages.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
@@ -23,9 +23,11 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "AllocatorCore.h"
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <functional>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
 #define DEFAULT_ALIGN 256
@@ -96,13 +98,32 @@ enum
     kCpuAllocatorPageSize = 0x200000	// 2MB
 };
 
+// Creates the D3D12 buffers backing LinearAllocator pages
+class LinearAllocationPageProvider
+{
+public:
+    typedef LinearAllocationPage PageType;
+
+    explicit LinearAllocationPageProvider( LinearAllocatorType Type ) : m_AllocationType(Type) {}
+
+    LinearAllocationPage* CreatePage( size_t PageSize );
+    void DestroyPage( LinearAllocationPage* Page ) { delete Page; }
+
+private:
+    LinearAllocatorType m_AllocationType;
+};
+
 class LinearAllocatorPageManager
 {
 public:
 
+    // Tells whether the GPU has passed a fence value.  Replaceable so that page recycling can be
+    // exercised against a fake fence.
+    typedef std::function<bool(uint64_t)> FenceQuery;
+
     LinearAllocatorPageManager();
-    LinearAllocationPage* RequestPage( void );
-    LinearAllocationPage* CreateNewPage( size_t PageSize = 0 );
+    LinearAllocationPage* RequestPage( void ) { return m_PagePool.RequestPage(); }
+    LinearAllocationPage* CreateNewPage( size_t PageSize = 0 ) { return m_PagePool.CreateLargePage(PageSize); }
 
     // Discarded pages will get recycled.  This is for fixed size pages.
     void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
@@ -111,28 +132,27 @@ public:
     // "large" pages.
     void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    void Destroy( void ) { m_PagePool.Destroy(); }
+
+    // Defaults to asking g_CommandManager
+    void SetFenceQuery( const FenceQuery& IsFenceComplete ) { m_PagePool.SetFenceQuery(IsFenceComplete); }
 
 private:
 
     static LinearAllocatorType sm_AutoType;
 
     LinearAllocatorType m_AllocationType;
-    std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
-    std::mutex m_Mutex;
+    AllocatorCore::FencedPagePool<LinearAllocationPageProvider, FenceQuery> m_PagePool;
 };
 
 class LinearAllocator
 {
 public:
 
-    LinearAllocator(LinearAllocatorType Type) : m_AllocationType(Type), m_PageSize(0), m_CurOffset(~(size_t)0), m_CurPage(nullptr)
+    LinearAllocator(LinearAllocatorType Type) : m_AllocationType(Type),
+        m_Offsets(Type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize), m_CurPage(nullptr)
     {
         ASSERT(Type > kInvalidAllocator && Type < kNumAllocatorTypes);
-        m_PageSize = (Type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize);
     }
 
     DynAlloc Allocate( size_t SizeInBytes, size_t Alignment = DEFAULT_ALIGN );
@@ -152,8 +172,7 @@ private:
     static LinearAllocatorPageManager sm_PageManager[2];
 
     LinearAllocatorType m_AllocationType;
-    size_t m_PageSize;
-    size_t m_CurOffset;
+    AllocatorCore::LinearOffsetAllocator m_Offsets;
     LinearAllocationPage* m_CurPage;
     std::vector<LinearAllocationPage*> m_RetiredPages;
     std::vector<LinearAllocationPage*> m_LargePageList;
@@ -15,22 +15,370 @@
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "Hash.h"
+#include "FileUtility.h"
 #include <map>
-#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+// Each entry owns a reference to its pipeline once it has been published
+static map< size_t, PSO::SharedPipeline > s_GraphicsPSOHashMap;
+static map< size_t, PSO::SharedPipeline > s_ComputePSOHashMap;
+
+static mutex s_PublishMutex;
+static condition_variable s_PublishedCV;
+static atomic<uint32_t> s_PendingCompiles(0);
+
+// Find the shared pipeline for a description hash.  If there is none, reserve one so the next
+// inquiry will find that someone got here first, and tell the caller to compile it.
+static PSO::SharedPipeline* FindOrReserve( map< size_t, PSO::SharedPipeline >& HashMap, size_t HashCode, bool& FirstCompile )
+{
+    static mutex s_HashMapMutex;
+    lock_guard<mutex> CS(s_HashMapMutex);
+
+    auto iter = HashMap.find(HashCode);
+    FirstCompile = iter == HashMap.end();
+    if (!FirstCompile)
+        return &iter->second;
+
+    PSO::SharedPipeline& Entry = HashMap[HashCode];
+    Entry.store(nullptr, memory_order_relaxed);
+    return &Entry;
+}
+
+static void Publish( PSO::SharedPipeline& Entry, ID3D12PipelineState* NewPSO, bool FromAsyncCompile = false )
+{
+    {
+        lock_guard<mutex> Lock(s_PublishMutex);
+        Entry.store(NewPSO, memory_order_release);
+        if (FromAsyncCompile)
+            --s_PendingCompiles;
+    }
+    s_PublishedCV.notify_all();
+}
+
+// Block until another thread publishes the pipeline
+static ID3D12PipelineState* WaitForPublish( const PSO::SharedPipeline& Entry )
+{
+    ID3D12PipelineState* Ready = Entry.load(memory_order_acquire);
+    if (Ready != nullptr)
+        return Ready;
+
+    unique_lock<mutex> Lock(s_PublishMutex);
+    s_PublishedCV.wait(Lock, [&Entry] { return Entry.load(memory_order_acquire) != nullptr; });
+    return Entry.load(memory_order_acquire);
+}
+
+static void WaitForPendingCompiles( void )
+{
+    unique_lock<mutex> Lock(s_PublishMutex);
+    s_PublishedCV.wait(Lock, [] { return s_PendingCompiles == 0; });
+}
+
+static void ReleaseAll( map< size_t, PSO::SharedPipeline >& HashMap )
+{
+    for (auto& iter : HashMap)
+    {
+        ID3D12PipelineState* Pipeline = iter.second.load();
+        if (Pipeline != nullptr)
+            Pipeline->Release();
+    }
+    HashMap.clear();
+}
+
+//
+// Persistent pipeline cache.  The in-memory maps above are keyed on descriptions that contain
+// pointers to shader bytecode and root signatures, which move from run to run.  Cache entries
+// are keyed on what those pointers refer to instead, with the portable hash so that a cache file
+// means the same thing on any CPU.  Entries that go unused for a few runs are dropped on save.
+//
+
+struct PSOCacheHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t NumEntries;
+    uint32_t Reserved;
+};
+
+struct PSOCacheEntry
+{
+    uint64_t Key;
+    uint64_t Size;
+    uint32_t UnusedRuns;        // Consecutive runs that didn't create this pipeline
+    uint32_t Reserved;
+};
+
+struct CachedBlob
+{
+    Utility::ByteArray Data;
+    uint32_t UnusedRuns;
+};
+
+static const uint32_t kPSOCacheMagic = 0x4F535043; // "CPSO"
+static const uint32_t kPSOCacheVersion = 2;
+static const uint32_t kMaxUnusedRuns = 4;
+
+static bool s_CacheEnabled = false;
+static wstring s_CacheFileName;
+static concurrency::task<void> s_CacheLoadTask;
+static map< uint64_t, CachedBlob > s_CachedBlobs;
+static map< uint64_t, ComPtr<ID3D12PipelineState> > s_PipelinesToCache;
+static mutex s_PipelinesToCacheMutex;
+static atomic<uint32_t> s_CacheHits(0);
+static atomic<uint32_t> s_CacheMisses(0);
+static atomic<uint32_t> s_CacheRejects(0);
+
+static uint64_t HashShader( const D3D12_SHADER_BYTECODE& Shader, uint64_t Hash )
+{
+    // Shader containers are always a whole number of dwords
+    return Utility::HashStatePortable((const uint32_t*)Shader.pShaderBytecode, Shader.BytecodeLength / 4, Hash);
+}
+
+static uint64_t HashString( const char* String, uint64_t Hash )
+{
+    for (; *String != '\0'; ++String)
+    {
+        uint32_t Char = (uint8_t)*String;
+        Hash = Utility::HashStatePortable(&Char, 1, Hash);
+    }
+    return Hash;
+}
+
+static uint64_t ComputeCacheKey( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, const RootSignature& RootSig )
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC StableDesc = Desc;
+    StableDesc.pRootSignature = nullptr;
+    StableDesc.VS = StableDesc.PS = StableDesc.DS = StableDesc.HS = StableDesc.GS = D3D12_SHADER_BYTECODE{};
+    StableDesc.StreamOutput = D3D12_STREAM_OUTPUT_DESC{};
+    StableDesc.InputLayout.pInputElementDescs = nullptr;
+    StableDesc.CachedPSO = D3D12_CACHED_PIPELINE_STATE{};
+
+    uint64_t RootSigHash = RootSig.GetHash();
+    uint64_t Hash = Utility::HashStatePortable(&StableDesc);
+    Hash = Utility::HashStatePortable(&RootSigHash, 1, Hash);
+    Hash = HashShader(Desc.VS, Hash);
+    Hash = HashShader(Desc.PS, Hash);
+    Hash = HashShader(Desc.DS, Hash);
+    Hash = HashShader(Desc.HS, Hash);
+    Hash = HashShader(Desc.GS, Hash);
+
+    for (UINT i = 0; i < Desc.InputLayout.NumElements; ++i)
+    {
+        D3D12_INPUT_ELEMENT_DESC Element = Desc.InputLayout.pInputElementDescs[i];
+        Hash = HashString(Element.SemanticName, Hash);
+        Element.SemanticName = nullptr;
+        Hash = Utility::HashStatePortable(&Element, 1, Hash);
+    }
+
+    return Hash;
+}
+
+static uint64_t ComputeCacheKey( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, const RootSignature& RootSig )
+{
+    D3D12_COMPUTE_PIPELINE_STATE_DESC StableDesc = Desc;
+    StableDesc.pRootSignature = nullptr;
+    StableDesc.CS = D3D12_SHADER_BYTECODE{};
+    StableDesc.CachedPSO = D3D12_CACHED_PIPELINE_STATE{};
+
+    uint64_t RootSigHash = RootSig.GetHash();
+    uint64_t Hash = Utility::HashStatePortable(&StableDesc);
+    Hash = Utility::HashStatePortable(&RootSigHash, 1, Hash);
+    return HashShader(Desc.CS, Hash);
+}
+
+static HRESULT CreatePipelineState( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** ppPSO )
+{
+    return g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(ppPSO));
+}
+
+static HRESULT CreatePipelineState( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, ID3D12PipelineState** ppPSO )
+{
+    return g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(ppPSO));
+}
+
+// Create a pipeline, starting from a cached blob when one is available
+template <typename DESC>
+static ID3D12PipelineState* CreateCachedPipelineState( DESC& Desc, const RootSignature& RootSig )
+{
+    ID3D12PipelineState* NewPSO = nullptr;
+    uint64_t CacheKey = 0;
+
+    if (s_CacheEnabled)
+    {
+        CacheKey = ComputeCacheKey(Desc, RootSig);
+
+        // The cache file is only read once, so lookups need no lock after it has loaded.  Loading starts
+        // before the device is created, so this rarely has to wait.
+        s_CacheLoadTask.wait();
+        auto iter = s_CachedBlobs.find(CacheKey);
+
+        if (iter == s_CachedBlobs.end())
+        {
+            ++s_CacheMisses;
+        }
+        else
+        {
+            Desc.CachedPSO.pCachedBlob = iter->second.Data->data();
+            Desc.CachedPSO.CachedBlobSizeInBytes = iter->second.Data->size();
+
+            // Blobs are rejected after a driver or adapter change.  Fall back to a full compile.
+            if (SUCCEEDED(CreatePipelineState(Desc, &NewPSO)))
+                ++s_CacheHits;
+            else
+            {
+                NewPSO = nullptr;
+                ++s_CacheRejects;
+            }
+
+            Desc.CachedPSO = D3D12_CACHED_PIPELINE_STATE{};
+        }
+    }
+
+    if (NewPSO == nullptr)
+        ASSERT_SUCCEEDED( CreatePipelineState(Desc, &NewPSO) );
+
+    if (s_CacheEnabled)
+    {
+        lock_guard<mutex> CS(s_PipelinesToCacheMutex);
+        s_PipelinesToCache[CacheKey] = NewPSO;
+    }
+
+    return NewPSO;
+}
+
+void PSO::LoadCache( const std::wstring& FileName )
+{
+    ASSERT(!s_CacheEnabled, "Pipeline cache already loaded");
+
+    s_CacheFileName = FileName;
+    s_CacheEnabled = true;
+
+    s_CacheLoadTask = concurrency::create_task( []
+    {
+        Utility::ByteArray File = Utility::ReadFileSync(s_CacheFileName);
+        const uint8_t* Iter = (const uint8_t*)File->data();
+        const uint8_t* End = Iter + File->size();
+
+        if (File->size() < sizeof(PSOCacheHeader))
+            return;
+
+        const PSOCacheHeader& Header = *(const PSOCacheHeader*)Iter;
+        if (Header.Magic != kPSOCacheMagic || Header.Version != kPSOCacheVersion)
+        {
+            Utility::Printf(L"Ignoring out-of-date pipeline cache %s\n", s_CacheFileName.c_str());
+            return;
+        }
+        Iter += sizeof(PSOCacheHeader);
+
+        for (uint32_t i = 0; i < Header.NumEntries; ++i)
+        {
+            if ((size_t)(End - Iter) < sizeof(PSOCacheEntry))
+                break;
+
+            PSOCacheEntry Entry;
+            memcpy(&Entry, Iter, sizeof(PSOCacheEntry));
+            Iter += sizeof(PSOCacheEntry);
+
+            if ((uint64_t)(End - Iter) < Entry.Size)
+                break;
+
+            CachedBlob& Blob = s_CachedBlobs[Entry.Key];
+            Blob.Data = make_shared<Utility::ByteArray::element_type>(Iter, Iter + Entry.Size);
+            Blob.UnusedRuns = Entry.UnusedRuns;
+            Iter += Entry.Size;
+        }
+    });
+}
+
+void PSO::SaveCache( void )
+{
+    if (!s_CacheEnabled)
+        return;
+
+    WaitForPendingCompiles();
+    s_CacheLoadTask.wait();
+
+    // Pipelines created this run replace any blob loaded under the same key.  Other loaded blobs are
+    // kept until they have gone unused for kMaxUnusedRuns runs, so that the file doesn't grow forever.
+    map< uint64_t, ComPtr<ID3DBlob> > NewBlobs;
+    {
+        lock_guard<mutex> CS(s_PipelinesToCacheMutex);
+        for (auto& iter : s_PipelinesToCache)
+        {
+            ComPtr<ID3DBlob> Blob;
+            if (SUCCEEDED(iter.second->GetCachedBlob(&Blob)))
+                NewBlobs[iter.first] = Blob;
+        }
+        s_PipelinesToCache.clear();
+    }
+
+    uint32_t NumEntries = (uint32_t)NewBlobs.size();
+    uint32_t NumPruned = 0;
+    for (auto iter = s_CachedBlobs.begin(); iter != s_CachedBlobs.end(); )
+    {
+        if (NewBlobs.find(iter->first) != NewBlobs.end())
+        {
+            iter = s_CachedBlobs.erase(iter);
+        }
+        else if (++iter->second.UnusedRuns > kMaxUnusedRuns)
+        {
+            iter = s_CachedBlobs.erase(iter);
+            ++NumPruned;
+        }
+        else
+        {
+            ++NumEntries;
+            ++iter;
+        }
+    }
+
+    ofstream File(s_CacheFileName, ios::out | ios::binary | ios::trunc);
+    if (File)
+    {
+        PSOCacheHeader Header = { kPSOCacheMagic, kPSOCacheVersion, NumEntries, 0 };
+        File.write((const char*)&Header, sizeof(Header));
+
+        for (auto& iter : NewBlobs)
+        {
+            PSOCacheEntry Entry = { iter.first, iter.second->GetBufferSize(), 0, 0 };
+            File.write((const char*)&Entry, sizeof(Entry));
+            File.write((const char*)iter.second->GetBufferPointer(), (streamsize)Entry.Size);
+        }
+
+        // Only blobs that weren't recreated this run are left
+        for (auto& iter : s_CachedBlobs)
+        {
+            PSOCacheEntry Entry = { iter.first, iter.second.Data->size(), iter.second.UnusedRuns, 0 };
+            File.write((const char*)&Entry, sizeof(Entry));
+            File.write((const char*)iter.second.Data->data(), (streamsize)Entry.Size);
+        }
+    }
+
+    Utility::Printf(L"Pipeline cache: %u hits, %u misses, %u rejected by driver.  Saved %u pipelines to %s, dropped %u unused\n",
+        (uint32_t)s_CacheHits, (uint32_t)s_CacheMisses, (uint32_t)s_CacheRejects, NumEntries, s_CacheFileName.c_str(), NumPruned);
+
+    s_CachedBlobs.clear();
+    s_CacheEnabled = false;
+}
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    WaitForPendingCompiles();
+    ReleaseAll(s_GraphicsPSOHashMap);
+    ReleaseAll(s_ComputePSOHashMap);
+    s_PipelinesToCache.clear();
+}
+
+uint32_t PSO::GetPendingCompileCount(void)
+{
+    return s_PendingCompiles;
 }
 
 
@@ -115,88 +463,114 @@ void GraphicsPSO::SetInputLayout( UINT NumElements, const D3D12_INPUT_ELEMENT_DE
         m_InputLayouts = nullptr;
 }
 
-void GraphicsPSO::Finalize()
+size_t GraphicsPSO::HashDesc()
 {
     // Make sure the root signature is finalized first
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
+    ASSERT(m_PSODesc.DepthStencilState.DepthEnable != (m_PSODesc.DSVFormat == DXGI_FORMAT_UNKNOWN));
 
     m_PSODesc.InputLayout.pInputElementDescs = nullptr;
     size_t HashCode = Utility::HashState(&m_PSODesc);
     HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
+    return HashCode;
+}
 
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+void GraphicsPSO::Finalize()
+{
+    bool firstCompile = false;
+    m_SharedPipeline = FindOrReserve(s_GraphicsPSOHashMap, HashDesc(), firstCompile);
 
     if (firstCompile)
     {
-        ASSERT(m_PSODesc.DepthStencilState.DepthEnable != (m_PSODesc.DSVFormat == DXGI_FORMAT_UNKNOWN));
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
+        m_PSO = CreateCachedPipelineState(m_PSODesc, *m_RootSignature);
         m_PSO->SetName(m_Name);
+        Publish(*m_SharedPipeline, m_PSO);
     }
     else
     {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
+        m_PSO = WaitForPublish(*m_SharedPipeline);
     }
 }
 
-void ComputePSO::Finalize()
+void GraphicsPSO::FinalizeAsync()
+{
+    bool firstCompile = false;
+    m_SharedPipeline = FindOrReserve(s_GraphicsPSOHashMap, HashDesc(), firstCompile);
+    m_PSO = nullptr;
+
+    if (!firstCompile)
+        return;
+
+    ++s_PendingCompiles;
+
+    // The task keeps its own copy of the description along with the input layout it points to
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+    shared_ptr<const D3D12_INPUT_ELEMENT_DESC> InputLayouts = m_InputLayouts;
+    const RootSignature* RootSig = m_RootSignature;
+    const wchar_t* Name = m_Name;
+    SharedPipeline* Entry = m_SharedPipeline;
+
+    concurrency::create_task( [Desc, InputLayouts, RootSig, Name, Entry]() mutable
+    {
+        ID3D12PipelineState* NewPSO = CreateCachedPipelineState(Desc, *RootSig);
+        NewPSO->SetName(Name);
+        Publish(*Entry, NewPSO, true);
+    });
+}
+
+size_t ComputePSO::HashDesc()
 {
     // Make sure the root signature is finalized first
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    size_t HashCode = Utility::HashState(&m_PSODesc);
+    return Utility::HashState(&m_PSODesc);
+}
 
-    ID3D12PipelineState** PSORef = nullptr;
+void ComputePSO::Finalize()
+{
     bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+    m_SharedPipeline = FindOrReserve(s_ComputePSOHashMap, HashDesc(), firstCompile);
 
     if (firstCompile)
     {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
+        m_PSO = CreateCachedPipelineState(m_PSODesc, *m_RootSignature);
         m_PSO->SetName(m_Name);
+        Publish(*m_SharedPipeline, m_PSO);
     }
     else
     {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
+        m_PSO = WaitForPublish(*m_SharedPipeline);
     }
 }
 
+void ComputePSO::FinalizeAsync()
+{
+    bool firstCompile = false;
+    m_SharedPipeline = FindOrReserve(s_ComputePSOHashMap, HashDesc(), firstCompile);
+    m_PSO = nullptr;
+
+    if (!firstCompile)
+        return;
+
+    ++s_PendingCompiles;
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = m_PSODesc;
+    const RootSignature* RootSig = m_RootSignature;
+    const wchar_t* Name = m_Name;
+    SharedPipeline* Entry = m_SharedPipeline;
+
+    concurrency::create_task( [Desc, RootSig, Name, Entry]() mutable
+    {
+        ID3D12PipelineState* NewPSO = CreateCachedPipelineState(Desc, *RootSig);
+        NewPSO->SetName(Name);
+        Publish(*Entry, NewPSO, true);
+    });
+}
+
 ComputePSO::ComputePSO(const wchar_t* Name)
     : PSO(Name)
 {
@@ -14,6 +14,7 @@
 #pragma once
 
 #include "pch.h"
+#include <atomic>
 
 class CommandContext;
 class RootSignature;
@@ -28,10 +29,27 @@ class PSO
 {
 public:
 
-    PSO(const wchar_t* Name) : m_Name(Name), m_RootSignature(nullptr), m_PSO(nullptr) {}
+    // Every PSO with an identical description shares one of these.  It holds null while the
+    // pipeline compiles and the pipeline state object once it is ready.
+    typedef std::atomic<ID3D12PipelineState*> SharedPipeline;
+
+    PSO(const wchar_t* Name) : m_Name(Name), m_RootSignature(nullptr), m_PSO(nullptr), m_SharedPipeline(nullptr) {}
 
     static void DestroyAll( void );
 
+    // Begin reading previously compiled pipelines from disk on a background thread.  Finalize()
+    // creates pipelines from these blobs when it finds a match instead of compiling from scratch.
+    // Call before creating the device so that the read overlaps it.  The cache holds blobs but not
+    // the descriptions they were built from, so pipelines are still created on first use.
+    static void LoadCache( const std::wstring& FileName );
+
+    // Write every pipeline compiled or loaded this run back to the cache file, along with loaded ones
+    // that were used in the last few runs, and report hits and misses.
+    static void SaveCache( void );
+
+    // Number of pipelines queued by FinalizeAsync() that have not finished compiling
+    static uint32_t GetPendingCompileCount( void );
+
     void SetRootSignature( const RootSignature& BindMappings )
     {
         m_RootSignature = &BindMappings;
@@ -43,7 +61,18 @@ public:
         return *m_RootSignature;
     }
 
-    ID3D12PipelineState* GetPipelineStateObject( void ) const { return m_PSO; }
+    // Returns null while a pipeline started with FinalizeAsync() is still compiling
+    ID3D12PipelineState* GetPipelineStateObject( void ) const
+    {
+        if (m_PSO != nullptr || m_SharedPipeline == nullptr)
+            return m_PSO;
+        return m_SharedPipeline->load(std::memory_order_acquire);
+    }
+
+    bool IsReady( void ) const { return GetPipelineStateObject() != nullptr; }
+
+    // Identifies the pipeline before it has finished compiling
+    const SharedPipeline* GetSharedPipeline( void ) const { return m_SharedPipeline; }
 
 protected:
 
@@ -52,6 +81,8 @@ protected:
     const RootSignature* m_RootSignature;
 
     ID3D12PipelineState* m_PSO;
+
+    SharedPipeline* m_SharedPipeline;
 };
 
 class GraphicsPSO : public PSO
@@ -90,8 +121,14 @@ public:
     // Perform validation and compute a hash value for fast state block comparisons
     void Finalize();
 
+    // Same as Finalize() except that it returns immediately and compiles on a worker thread.
+    // Check IsReady() before drawing with it.
+    void FinalizeAsync();
+
 private:
 
+    size_t HashDesc( void );
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC m_PSODesc;
     std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC> m_InputLayouts;
 };
@@ -108,8 +145,11 @@ public:
     void SetComputeShader( const D3D12_SHADER_BYTECODE& Binary ) { m_PSODesc.CS = Binary; }
 
     void Finalize();
+    void FinalizeAsync();
 
 private:
 
+    size_t HashDesc( void );
+
     D3D12_COMPUTE_PIPELINE_STATE_DESC m_PSODesc;
 };
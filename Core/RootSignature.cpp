@@ -103,8 +103,9 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
     m_DescriptorTableBitMap = 0;
     m_SamplerTableBitMap = 0;
 
-    size_t HashCode = Utility::HashState(&RootDesc.Flags);
-    HashCode = Utility::HashState( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
+    // Portable so that pipeline cache keys built from it are the same on every machine
+    size_t HashCode = (size_t)Utility::HashStatePortable(&RootDesc.Flags);
+    HashCode = (size_t)Utility::HashStatePortable( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
 
     for (UINT Param = 0; Param < m_NumParameters; ++Param)
     {
@@ -115,22 +116,35 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
         {
             ASSERT(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
-            HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
+            HashCode = (size_t)Utility::HashStatePortable( RootParam.DescriptorTable.pDescriptorRanges,
                 RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
 
+            bool Unbounded = false;
+            for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
+            {
+                UINT NumDescriptors = RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
+                if (NumDescriptors == UINT_MAX)
+                    Unbounded = true;
+                else
+                    m_DescriptorTableSize[Param] += NumDescriptors;
+            }
+
+            // Unbounded tables point straight into a shader-visible heap.  They can't be staged
+            // through the dynamic descriptor cache, so leave them out of its bitmaps.
+            if (Unbounded)
+                m_DescriptorTableSize[Param] = 0;
             // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
-            if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
+            else if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
                 m_SamplerTableBitMap |= (1 << Param);
             else
                 m_DescriptorTableBitMap |= (1 << Param);
-
-            for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
-                m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
         }
         else
-            HashCode = Utility::HashState( &RootParam, 1, HashCode );
+            HashCode = (size_t)Utility::HashStatePortable( &RootParam, 1, HashCode );
     }
 
+    m_Hash = HashCode;
+
     ID3D12RootSignature** RSRef = nullptr;
     bool firstCompile = false;
     {
@@ -0,0 +1,110 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "pch.h"
+#include "TLSFAllocator.h"
+#include "GraphicsCore.h"
+#include "CommandListManager.h"
+
+using namespace Graphics;
+using namespace std;
+
+TLSFAllocator::TLSFAllocator(size_t totalSize, size_t alignment)
+    : m_Ranges(totalSize, alignment)
+    , m_requestedSize(0)
+{
+}
+
+void TLSFAllocator::Initialize()
+{
+    m_BackingResource.Create(L"TLSF Allocator Backing Resource", uint32_t(m_Ranges.GetTotalSize()), 1, nullptr);
+}
+
+void TLSFAllocator::Destroy()
+{
+    lock_guard<mutex> LockGuard(m_mutex);
+
+    while (!m_deferredDeletionQueue.empty())
+    {
+        delete m_deferredDeletionQueue.front();
+        m_deferredDeletionQueue.pop();
+    }
+
+    m_Ranges.Reset();
+    m_requestedSize = 0;
+    m_BackingResource.Destroy();
+}
+
+BuddyBlock* TLSFAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
+{
+    const size_t size = size_t(numElements) * elementSize;
+
+    // The node table may grow under another thread's Allocate(), so read the range while locked
+    uint32_t node, offset, allocatedSize;
+    {
+        lock_guard<mutex> LockGuard(m_mutex);
+        node = m_Ranges.Allocate(size);
+        if (node == AllocatorCore::TLSFOffsetAllocator::kInvalidNode)
+            return new BuddyBlock();
+        offset = uint32_t(m_Ranges.GetOffset(node));
+        allocatedSize = uint32_t(m_Ranges.GetSize(node));
+        m_requestedSize += size;
+    }
+
+    BuddyBlock* pBlock = new BuddyBlock(offset, allocatedSize, uint32_t(size));
+    pBlock->m_allocatorNode = node;
+    pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
+    return pBlock;
+}
+
+void TLSFAllocator::Deallocate(BuddyBlock* pBlock)
+{
+    // The null block returned by a failed Allocate() owns no range
+    if (pBlock->m_allocatorNode == AllocatorCore::TLSFOffsetAllocator::kInvalidNode)
+    {
+        ASSERT(pBlock->GetSize() == 0);
+        delete pBlock;
+        return;
+    }
+
+    ASSERT(IsOwner(*pBlock));
+
+    lock_guard<mutex> LockGuard(m_mutex);
+    pBlock->m_fenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    m_deferredDeletionQueue.push(pBlock);
+}
+
+void TLSFAllocator::CleanUpAllocations()
+{
+    lock_guard<mutex> LockGuard(m_mutex);
+
+    while (!m_deferredDeletionQueue.empty() &&
+        g_CommandManager.IsFenceComplete(m_deferredDeletionQueue.front()->m_fenceValue))
+    {
+        BuddyBlock* pBlock = m_deferredDeletionQueue.front();
+        m_deferredDeletionQueue.pop();
+
+        m_Ranges.Free(pBlock->m_allocatorNode);
+        m_requestedSize -= pBlock->m_unpaddedSize;
+        delete pBlock;
+    }
+}
+
+AllocatorCore::SubAllocatorStats TLSFAllocator::GetStats()
+{
+    lock_guard<mutex> LockGuard(m_mutex);
+
+    AllocatorCore::SubAllocatorStats stats = m_Ranges.GetStats();
+    stats.RequestedSize = m_requestedSize;
+    return stats;
+}
@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Sub-allocates blocks out of a single large buffer using two-level segregated fit.
+// This is an alternative to the BuddyAllocator's kManualSubAllocationStrategy for
+// read-only buffers such as vertex and index buffers.  Requests are only rounded up
+// to the alignment rather than to a power of two, so odd-sized buffers waste little
+// space.  Freed blocks are returned to the pool once the GPU has finished with them.
+//
+
+#pragma once
+
+#include "BuddyAllocator.h"
+#include "AllocatorCore.h"
+#include <queue>
+#include <mutex>
+
+class TLSFAllocator
+{
+public:
+
+    TLSFAllocator(size_t totalSize, size_t alignment = 16);
+
+    void Initialize();
+
+    void Destroy();
+
+    // Returns a block with a null buffer if there is no free range large enough
+    BuddyBlock* Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData = nullptr);
+
+    // The block's range is reused once the GPU has passed the next graphics queue fence
+    void Deallocate(BuddyBlock* pBlock);
+
+    // Returns the ranges of deallocated blocks whose fence has passed to the pool
+    void CleanUpAllocations();
+
+    inline bool IsOwner(const BuddyBlock& block) const
+    {
+        return block.m_pBuffer == &m_BackingResource;
+    }
+
+    // Occupancy for comparison with other sub-allocation strategies
+    AllocatorCore::SubAllocatorStats GetStats();
+
+private:
+    ByteAddressBuffer m_BackingResource;
+
+    AllocatorCore::TLSFOffsetAllocator m_Ranges;
+    size_t m_requestedSize;
+
+    std::queue<BuddyBlock*> m_deferredDeletionQueue;
+    std::mutex m_mutex;
+};
@@ -19,8 +19,13 @@
 #include "FileUtility.h"
 #include "GraphicsCommon.h"
 #include "CommandContext.h"
-#include <map>
+#include "CommandListManager.h"
+#include "TextureStreamingCore.h"
+#include <unordered_map>
+#include <list>
 #include <thread>
+#include <condition_variable>
+#include <cfloat>
 
 using namespace std;
 using namespace Graphics;
@@ -28,8 +33,9 @@ using Utility::ByteArray;
 
 //
 // A ManagedTexture allows for multiple threads to request a Texture load of the same
-// file.  It also contains a reference count of the Texture so that it can be freed
-// when it is no longer referenced.
+// file.  It also contains a reference count of the Texture.  When it is no longer
+// referenced it stays cached, and is freed least recently used first when the cache
+// is over budget.
 //
 // Raw ManagedTexture pointers are not exposed to clients.  
 //
@@ -39,106 +45,462 @@ class ManagedTexture : public Texture
 
 public:
     ManagedTexture( const wstring& FileName );
+    ~ManagedTexture();
 
     void WaitForLoad(void) const;
-    void CreateFromMemory(ByteArray memory, eDefaultTexture fallback, bool sRGB);
+    // With a streamPath, only the mip tail is created and the other mips are read from that file as needed
+    void CreateFromMemory(ByteArray memory, eDefaultTexture fallback, bool sRGB, const wstring& streamPath = wstring());
+
+    // Give the texture its own descriptor holding the fallback, to be overwritten when loaded
+    void CreatePlaceholder(eDefaultTexture fallback);
+
+    // Read the file and create the texture on background tasks
+    void LoadAsync(const wstring& filePath, eDefaultTexture fallback, bool sRGB, bool streamed);
+
+    // Load new textures together, on a background task if async.  See TextureManager::LoadDDSBatch().
+    static void LoadBatch(vector<ManagedTexture*> textures, vector<wstring> filePaths, eDefaultTexture fallback, bool sRGB, bool async);
+
+    // A non-streamed load of the same file wants every mip
+    void Pin(void) { m_Pinned = true; }
+
+    const wstring& GetKey(void) const { return m_MapKey; }
+
+    // Take the texture off the unused list when it is found again.  Requires s_Mutex.
+    void Reuse(void);
 
 private:
 
+    static void CreateBatch(const vector<ManagedTexture*>& textures, const vector<wstring>& filePaths, eDefaultTexture fallback, bool sRGB);
+
+    // Publish the descriptor and wake anything waiting for the load
+    void FinishLoading(void);
+
     bool IsValid(void) const { return m_IsValid; }
+    bool NotifyWhenLoaded(std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> callback);
     void Unload();
 
+    // Track the memory of the current resource in the cache total
+    void UpdateResidentBytes(void);
+
+    // Remember the file so that other mip ranges can be read from it later.  Returns false if the texture
+    // can't be streamed, in which case it should be created in full.
+    bool RegisterForStreaming(const wstring& filePath, uint32_t fullWidth, uint32_t fullHeight, uint32_t fullMipCount, bool sRGB);
+    void RequestScreenSize(float pixels);
+
+    // Take a reference unless the count has already reached zero
+    bool TryAddReference(void);
+
+    friend void TextureManager::UpdateStreaming(void);
+
     std::wstring m_MapKey;		// For deleting from the map later
     bool m_IsValid;
-    bool m_IsLoading;
-    size_t m_ReferenceCount;
+    bool m_IsLoading;			// Guarded by s_LoadMutex
+    bool m_OwnsDescriptor;		// False when pointing at a default texture
+    std::atomic<size_t> m_ReferenceCount;
+    std::vector<std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>> m_LoadCallbacks;
+
+    // Cache state.  The unused list entries are guarded by s_Mutex.
+    uint64_t m_ResidentBytes;
+    bool m_IsUnused;
+    std::list<ManagedTexture*>::iterator m_UnusedPosition;
+
+    // Streaming state.  m_StreamIndex is guarded by s_StreamMutex.
+    bool m_Streamed;
+    bool m_ForceSRGB;
+    wstring m_FilePath;		// Only the mips being created are read, so the file isn't kept in memory
+    uint32_t m_FullWidth;
+    uint32_t m_FullHeight;
+    uint32_t m_StreamIndex;
+    std::atomic<float> m_ScreenSize;	// Largest request since the last update
+    std::atomic<bool> m_Pinned;
+
+    // The heap the resource is placed in, when it was created by a batch.  Each texture has its own so
+    // that evicting it frees its memory.
+    Microsoft::WRL::ComPtr<ID3D12Heap> m_Heap;
 };
 
 namespace TextureManager
 {
+    BoolVar AsyncLoading("Graphics/Textures/Async Loading", true);
+    BoolVar Streaming("Graphics/Textures/Streaming", true);
+    IntVar StreamingBudgetMB("Graphics/Textures/Streaming Budget (MB)", 512, 16, 16384, 16);
+    IntVar CacheBudgetMB("Graphics/Textures/Cache Budget (MB)", 1024, 0, 65536, 64);
+
     wstring s_RootPath = L"";
-    map<wstring, std::unique_ptr<ManagedTexture>> s_TextureCache;
+    unordered_map<wstring, std::unique_ptr<ManagedTexture>> s_TextureCache;
+
+    // Unreferenced textures, most recently released first.  Guarded by s_Mutex, as are the counters.
+    list<ManagedTexture*> s_UnusedTextures;
+    std::atomic<uint64_t> s_ResidentBytes(0);
+    uint64_t s_CacheHits = 0;
+    uint64_t s_CacheMisses = 0;
+    uint64_t s_CacheEvictions = 0;
+
+    // Signaled whenever a texture finishes loading
+    mutex s_LoadMutex;
+    condition_variable s_LoadCompleted;
+    uint32_t s_PendingLoads = 0;
+
+    std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> s_UpdateListener;
+
+    // Mip changes are throttled so that a camera cut doesn't stall on a burst of uploads
+    enum { kMaxStreamsInFlight = 8 };
+    const uint64_t kMaxUploadBytesPerUpdate = 32 * 1024 * 1024;
+
+    struct FinishedStream
+    {
+        ManagedTexture* Texture;
+        uint32_t Mip;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;    // Null if creation failed
+        D3D12_CPU_DESCRIPTOR_HANDLE SRV;
+    };
+
+    // Replaced resources are released once the GPU is done with them.  A fence of zero is
+    // assigned at the next update.
+    struct RetiredResource
+    {
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        uint64_t FenceValue;
+        Microsoft::WRL::ComPtr<ID3D12Heap> Heap;    // For placed resources
+    };
+
+    // The state and texture arrays are parallel.  Lock order is s_Mutex, then s_StreamMutex.
+    mutex s_StreamMutex;
+    vector<StreamingCore::TextureState> s_StreamStates;
+    vector<ManagedTexture*> s_StreamTextures;
+    vector<FinishedStream> s_FinishedStreams;
+    vector<RetiredResource> s_RetiredResources;
+    StreamingCore::ResidencyPlanner s_Planner;
+    vector<StreamingCore::Change> s_Changes;
+    uint32_t s_StreamsInFlight = 0;
+
+    void NotifyUpdated( D3D12_CPU_DESCRIPTOR_HANDLE SRV )
+    {
+        if (s_UpdateListener)
+            s_UpdateListener(SRV);
+    }
 
     void Initialize( const wstring& TextureLibRoot )
     {
         s_RootPath = TextureLibRoot;
     }
 
+    void WaitForPendingLoads( void )
+    {
+        unique_lock<mutex> Lock(s_LoadMutex);
+        s_LoadCompleted.wait(Lock, [] { return s_PendingLoads == 0; });
+    }
+
+    void SetUpdateListener( std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> listener )
+    {
+        s_UpdateListener = std::move(listener);
+    }
+
     void Shutdown( void )
     {
+        WaitForPendingLoads();
+
+        {
+            lock_guard<mutex> Guard(s_StreamMutex);
+            for (auto& Result : s_FinishedStreams)
+                FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Result.SRV);
+            s_FinishedStreams.clear();
+            s_StreamsInFlight = 0;
+        }
+
+        s_UnusedTextures.clear();
         s_TextureCache.clear();
+        s_RetiredResources.clear();
+        s_UpdateListener = nullptr;
     }
 
     mutex s_Mutex;
 
-    ManagedTexture* FindOrLoadTexture( const wstring& fileName, eDefaultTexture fallback, bool forceSRGB )
+    // Free unreferenced textures, oldest first, until the cache fits its budget.  Requires s_Mutex.
+    void TrimCache( void )
     {
-        ManagedTexture* tex = nullptr;
-
+        const uint64_t budget = (uint64_t)CacheBudgetMB * 1024 * 1024;
+        while (s_ResidentBytes > budget && !s_UnusedTextures.empty())
         {
-            lock_guard<mutex> Guard(s_Mutex);
+            ManagedTexture* tex = s_UnusedTextures.back();
+            s_UnusedTextures.pop_back();
+            ++s_CacheEvictions;
+            s_TextureCache.erase(tex->GetKey());
+        }
+    }
 
-            wstring key = fileName;
-            if (forceSRGB)
-                key += L"_sRGB";
+    CacheStats GetCacheStats( void )
+    {
+        lock_guard<mutex> Guard(s_Mutex);
 
-            // Search for an existing managed texture
-            auto iter = s_TextureCache.find(key);
-            if (iter != s_TextureCache.end())
-            {
-                // If a texture was already created make sure it has finished loading before
-                // returning a point to it.
-                tex = iter->second.get();
-                tex->WaitForLoad();
-                return tex;
-            }
-            else
-            {
-                // If it's not found, create a new managed texture and start loading it
-                tex = new ManagedTexture(key);
-                s_TextureCache[key].reset(tex);
-            }
+        CacheStats stats;
+        stats.NumTextures = (uint32_t)s_TextureCache.size();
+        stats.NumUnreferenced = (uint32_t)s_UnusedTextures.size();
+        stats.ResidentBytes = s_ResidentBytes;
+        stats.BudgetBytes = (uint64_t)CacheBudgetMB * 1024 * 1024;
+        stats.Hits = s_CacheHits;
+        stats.Misses = s_CacheMisses;
+        stats.Evictions = s_CacheEvictions;
+        return stats;
+    }
+
+    // Search for an existing managed texture, or create one that the caller must load.  Requires s_Mutex.
+    ManagedTexture* FindOrCreateTexture( const wstring& fileName, eDefaultTexture fallback, bool forceSRGB, bool async, bool& requested )
+    {
+        wstring key = fileName;
+        if (forceSRGB)
+            key += L"_sRGB";
+
+        auto iter = s_TextureCache.find(key);
+        if (iter != s_TextureCache.end())
+        {
+            ManagedTexture* tex = iter->second.get();
+            tex->Reuse();
+            ++s_CacheHits;
+            requested = false;
+            return tex;
         }
 
-        Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-        tex->CreateFromMemory(ba, fallback, forceSRGB);
+        ManagedTexture* tex = new ManagedTexture(key);
+        s_TextureCache[key].reset(tex);
+        requested = true;
+        ++s_CacheMisses;
+
+        // Others may find it as soon as the lock is released, so it needs a descriptor now
+        if (async)
+            tex->CreatePlaceholder(fallback);
 
-        // This was the first time it was requested, so indicate that the caller must read the file
         return tex;
     }
 
-    void DestroyTexture(const wstring& key)
+    // Another caller is loading the texture
+    void UseRequestedTexture( ManagedTexture* tex, bool async, bool streamed )
     {
-        lock_guard<mutex> Guard(s_Mutex);
+        if (!streamed)
+            tex->Pin();
 
-        auto iter = s_TextureCache.find(key);
-        if (iter != s_TextureCache.end())
-            s_TextureCache.erase(iter);
+        // A texture loading in the background already shows its fallback, so only
+        // synchronous callers need to wait for it.
+        if (!async || tex->GetSRV().ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+            tex->WaitForLoad();
+    }
+
+    // The reference is taken under the lock so the texture can't be evicted before the caller has it
+    TextureRef FindOrLoadTexture( const wstring& fileName, eDefaultTexture fallback, bool forceSRGB, bool streamed = false )
+    {
+        bool requested;
+        bool async = AsyncLoading;
+
+        unique_lock<mutex> Lock(s_Mutex);
+        ManagedTexture* tex = FindOrCreateTexture(fileName, fallback, forceSRGB, async, requested);
+        TextureRef ref(tex);
+        Lock.unlock();
+
+        if (!requested)
+        {
+            UseRequestedTexture(tex, async, streamed);
+            return ref;
+        }
+
+        if (async)
+        {
+            tex->LoadAsync(s_RootPath + fileName, fallback, forceSRGB, streamed);
+        }
+        else
+        {
+            const wstring filePath = s_RootPath + fileName;
+            Utility::ByteArray ba = Utility::ReadFileSync( filePath );
+            tex->CreateFromMemory(ba, fallback, forceSRGB, streamed ? filePath : wstring());
+        }
+
+        return ref;
     }
 
 } // namespace TextureManager
 
 ManagedTexture::ManagedTexture( const wstring& FileName )
-    : m_MapKey(FileName), m_IsValid(false), m_IsLoading(true), m_ReferenceCount(0)
+    : m_MapKey(FileName), m_IsValid(false), m_IsLoading(true), m_OwnsDescriptor(false), m_ReferenceCount(0),
+    m_ResidentBytes(0), m_IsUnused(false),
+    m_Streamed(false), m_ForceSRGB(false), m_FullWidth(0), m_FullHeight(0), m_StreamIndex(0), m_ScreenSize(0.0f), m_Pinned(false)
 {
     m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
 }
 
-void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bool forceSRGB)
+ManagedTexture::~ManagedTexture()
+{
+    if (m_Streamed)
+    {
+        using namespace TextureManager;
+
+        lock_guard<mutex> Guard(s_StreamMutex);
+
+        // Swap with the last entry and fix up the moved texture's index
+        uint32_t Last = (uint32_t)s_StreamTextures.size() - 1;
+        s_StreamStates[m_StreamIndex] = s_StreamStates[Last];
+        s_StreamTextures[m_StreamIndex] = s_StreamTextures[Last];
+        s_StreamTextures[m_StreamIndex]->m_StreamIndex = m_StreamIndex;
+        s_StreamStates.pop_back();
+        s_StreamTextures.pop_back();
+    }
+
+    // The GPU may still be reading from the resource
+    if (m_pResource != nullptr)
+    {
+        lock_guard<mutex> Guard(TextureManager::s_StreamMutex);
+        TextureManager::RetiredResource Retired = { m_pResource, 0, m_Heap };
+        TextureManager::s_RetiredResources.push_back(Retired);
+    }
+
+    TextureManager::s_ResidentBytes -= m_ResidentBytes;
+
+    if (m_OwnsDescriptor)
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_hCpuDescriptorHandle);
+}
+
+void ManagedTexture::UpdateResidentBytes(void)
+{
+    uint64_t bytes = 0;
+    if (m_Heap != nullptr)
+    {
+        // The whole heap is released with the texture
+        bytes = m_Heap->GetDesc().SizeInBytes;
+    }
+    else if (m_pResource != nullptr)
+    {
+        D3D12_RESOURCE_DESC desc = m_pResource->GetDesc();
+        bytes = g_Device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+    }
+
+    TextureManager::s_ResidentBytes += bytes - m_ResidentBytes;
+    m_ResidentBytes = bytes;
+}
+
+void ManagedTexture::Reuse(void)
+{
+    if (m_IsUnused)
+    {
+        TextureManager::s_UnusedTextures.erase(m_UnusedPosition);
+        m_IsUnused = false;
+    }
+}
+
+void ManagedTexture::CreatePlaceholder(eDefaultTexture fallback)
+{
+    m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_OwnsDescriptor = true;
+    g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, GetDefaultTexture(fallback),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void ManagedTexture::LoadAsync(const wstring& filePath, eDefaultTexture fallback, bool forceSRGB, bool streamed)
+{
+    using namespace TextureManager;
+
+    {
+        lock_guard<mutex> Guard(s_LoadMutex);
+        ++s_PendingLoads;
+    }
+
+    // Keep the texture alive until the load completes, even if every reference is dropped
+    ++m_ReferenceCount;
+
+    // The read runs on an I/O thread and the DDS parsing and upload on a task, so while one texture
+    // is uploading the next can be reading
+    const wstring streamPath = streamed ? filePath : wstring();
+    Utility::ReadFileAsync(filePath, [this, fallback, forceSRGB, streamPath](ByteArray ba)
+    {
+        Concurrency::create_task([this, ba, fallback, forceSRGB, streamPath]
+        {
+            CreateFromMemory(ba, fallback, forceSRGB, streamPath);
+
+            if (--m_ReferenceCount == 0)
+                Unload();
+
+            lock_guard<mutex> Guard(s_LoadMutex);
+            --s_PendingLoads;
+            s_LoadCompleted.notify_all();
+        });
+    });
+}
+
+void ManagedTexture::LoadBatch(vector<ManagedTexture*> textures, vector<wstring> filePaths, eDefaultTexture fallback, bool forceSRGB, bool async)
+{
+    using namespace TextureManager;
+
+    if (!async)
+    {
+        CreateBatch(textures, filePaths, fallback, forceSRGB);
+        return;
+    }
+
+    {
+        lock_guard<mutex> Guard(s_LoadMutex);
+        ++s_PendingLoads;
+    }
+
+    // Keep the textures alive until the batch completes, even if every reference is dropped
+    for (ManagedTexture* tex : textures)
+        ++tex->m_ReferenceCount;
+
+    Concurrency::create_task([textures, filePaths, fallback, forceSRGB]
+    {
+        CreateBatch(textures, filePaths, fallback, forceSRGB);
+
+        for (ManagedTexture* tex : textures)
+        {
+            if (--tex->m_ReferenceCount == 0)
+                tex->Unload();
+        }
+
+        lock_guard<mutex> Guard(s_LoadMutex);
+        --s_PendingLoads;
+        s_LoadCompleted.notify_all();
+    });
+}
+
+void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bool forceSRGB, const wstring& streamPath)
 {
     if (ba->size() == 0)
     {
-        m_hCpuDescriptorHandle = GetDefaultTexture(fallback);
+        // A placeholder already holds the fallback
+        if (!m_OwnsDescriptor)
+            m_hCpuDescriptorHandle = GetDefaultTexture(fallback);
     }
     else
     {
         // We probably have a texture to load, so let's allocate a new descriptor
-        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        if (!m_OwnsDescriptor)
+        {
+            m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            m_OwnsDescriptor = true;
+        }
+
+        // A streamed texture starts with only its tail, which is never evicted
+        uint32_t fullWidth, fullHeight, fullMipCount;
+        bool streamed = !streamPath.empty() && GetDDSTexture2DSize((const uint8_t*)ba->data(), ba->size(), fullWidth, fullHeight, fullMipCount) &&
+            fullMipCount <= StreamingCore::kMaxMips &&
+            StreamingCore::MipForMaxSize(fullWidth, fullHeight, fullMipCount, StreamingCore::kTailSize) > 0;
 
         if ( SUCCEEDED( CreateDDSTextureFromMemory( g_Device, (const uint8_t*)ba->data(), ba->size(),
-            0, forceSRGB, m_pResource.GetAddressOf(), m_hCpuDescriptorHandle) ) )
+            streamed ? StreamingCore::kTailSize : 0, forceSRGB, m_pResource.GetAddressOf(), m_hCpuDescriptorHandle) ) )
         {
+            if (streamed && !RegisterForStreaming(streamPath, fullWidth, fullHeight, fullMipCount, forceSRGB))
+            {
+                // Not streamable after all, so replace the tail with the full chain.  The descriptor
+                // may already have been copied, so the tail is retired rather than released.
+                Microsoft::WRL::ComPtr<ID3D12Resource> fullResource;
+                if ( SUCCEEDED( CreateDDSTextureFromMemory( g_Device, (const uint8_t*)ba->data(), ba->size(),
+                    0, forceSRGB, fullResource.GetAddressOf(), m_hCpuDescriptorHandle) ) )
+                {
+                    lock_guard<mutex> Guard(TextureManager::s_StreamMutex);
+                    TextureManager::RetiredResource Retired = { m_pResource, 0 };
+                    TextureManager::s_RetiredResources.push_back(Retired);
+                    m_pResource = fullResource;
+                }
+            }
+
             m_IsValid = true;
+            UpdateResidentBytes();
             D3D12_RESOURCE_DESC desc = GetResource()->GetDesc();
             m_Width = (uint32_t)desc.Width;
             m_Height = desc.Height;
@@ -151,18 +513,552 @@ void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bo
         }
     }
 
-    m_IsLoading = false;
+    FinishLoading();
+}
+
+void ManagedTexture::FinishLoading(void)
+{
+    std::vector<std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)>> callbacks;
+    {
+        lock_guard<mutex> Guard(TextureManager::s_LoadMutex);
+        m_IsLoading = false;
+        callbacks.swap(m_LoadCallbacks);
+    }
+    TextureManager::s_LoadCompleted.notify_all();
+
+    for (auto& callback : callbacks)
+        callback(m_hCpuDescriptorHandle);
+
+    TextureManager::NotifyUpdated(m_hCpuDescriptorHandle);
+}
+
+namespace
+{
+    // Reads tightly packed subresources from a DDS file into upload memory laid out for the copy.  Rows are
+    // only padded in the upload layout, so files whose rows are already aligned are read in one piece.
+    bool ReadSubresources( Utility::FileRangeReader& file, uint64_t fileOffset, uint32_t numSubresources,
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const UINT* numRows, const UINT64* rowSizes, void* upload )
+    {
+        for (uint32_t s = 0; s < numSubresources; ++s)
+        {
+            const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout = layouts[s];
+            uint8_t* dest = (uint8_t*)upload + layout.Offset;
+            const size_t rowSize = (size_t)rowSizes[s];
+            const size_t rows = (size_t)numRows[s] * layout.Footprint.Depth;
+
+            if (rowSize == layout.Footprint.RowPitch)
+            {
+                if (!file.Read(fileOffset, dest, rowSize * rows))
+                    return false;
+            }
+            else
+            {
+                for (size_t row = 0; row < rows; ++row)
+                {
+                    if (!file.Read(fileOffset + row * rowSize, dest + row * layout.Footprint.RowPitch, rowSize))
+                        return false;
+                }
+            }
+
+            fileOffset += rowSize * rows;
+        }
+        return true;
+    }
+
+    // Creates a streamed texture's mips from firstMip down, reading only that part of the file.  Files that
+    // can't be read in parts, such as those that exist only compressed, are read whole for the duration.
+    HRESULT CreateMipRangeFromFile( const wstring& filePath, uint32_t firstMip, size_t maxSize, bool forceSRGB,
+        ID3D12Resource** texture, D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+    {
+        *texture = nullptr;
+
+        Utility::FileRangeReader file;
+        if (!file.Open(filePath))
+        {
+            ByteArray ba = Utility::ReadFileSync(filePath);
+            return CreateDDSTextureFromMemory(g_Device, (const uint8_t*)ba->data(), ba->size(),
+                maxSize, forceSRGB, texture, textureView);
+        }
+
+        DDSTextureInfo info;
+        uint8_t header[DDSTextureInfo::kMaxHeaderSize];
+        size_t headerSize = (size_t)(std::min)(file.GetSize(), (uint64_t)sizeof(header));
+        if (!file.Read(0, header, headerSize) || FAILED(GetDDSTextureInfo(header, headerSize, forceSRGB, info)))
+            return E_FAIL;
+
+        // Streamed textures are single 2D textures, so their subresources are just the mips
+        D3D12_RESOURCE_DESC& desc = info.Desc;
+        if (firstMip >= desc.MipLevels || desc.DepthOrArraySize != 1)
+            return E_INVALIDARG;
+
+        vector<UINT> fullRows(desc.MipLevels);
+        vector<UINT64> fullRowSizes(desc.MipLevels);
+        g_Device->GetCopyableFootprints(&desc, 0, desc.MipLevels, 0, nullptr, fullRows.data(), fullRowSizes.data(), nullptr);
+
+        uint64_t fileOffset = info.DataOffset;
+        for (uint32_t mip = 0; mip < firstMip; ++mip)
+            fileOffset += fullRowSizes[mip] * fullRows[mip];
+
+        desc.Width = (std::max)(desc.Width >> firstMip, (UINT64)1);
+        desc.Height = (std::max)(desc.Height >> firstMip, 1u);
+        desc.MipLevels = (UINT16)(desc.MipLevels - firstMip);
+
+        const uint32_t numSubresources = desc.MipLevels;
+        vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+        vector<UINT> numRows(numSubresources);
+        vector<UINT64> rowSizes(numSubresources);
+        UINT64 uploadSize;
+        g_Device->GetCopyableFootprints(&desc, 0, numSubresources, 0, layouts.data(), numRows.data(), rowSizes.data(), &uploadSize);
+
+        uint64_t dataSize = 0;
+        for (uint32_t s = 0; s < numSubresources; ++s)
+            dataSize += rowSizes[s] * numRows[s];
+        if (fileOffset + dataSize > file.GetSize())
+            return E_FAIL;
+
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+        HRESULT hr = g_Device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(resource.GetAddressOf()));
+        if (FAILED(hr))
+            return hr;
+
+        GpuResource dest(resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+        CommandContext& context = CommandContext::Begin(L"Stream Texture Mips");
+        DynAlloc upload = context.ReserveUploadMemory((size_t)uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        if (!ReadSubresources(file, fileOffset, numSubresources, layouts.data(), numRows.data(), rowSizes.data(), upload.DataPtr))
+        {
+            // Nothing was recorded, so the resource can be released now
+            context.Finish();
+            return E_FAIL;
+        }
+
+        context.CopyTextureFromUpload(dest, numSubresources, layouts.data(), upload);
+        context.TransitionResource(dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+        context.Finish(true);
+
+        CreateDDSTextureView(g_Device, resource.Get(), info, textureView);
+        *texture = resource.Detach();
+        return S_OK;
+    }
+}
+
+void ManagedTexture::CreateBatch(const vector<ManagedTexture*>& textures, const vector<wstring>& filePaths, eDefaultTexture fallback, bool forceSRGB)
+{
+    // Uploads are submitted in parts so that the batch doesn't hold all of its pixels in upload memory at once
+    const uint64_t kMaxUploadBytes = 64 * 1024 * 1024;
+
+    struct BatchEntry
+    {
+        DDSTextureInfo Info;
+        uint32_t NumSubresources;
+        vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Layouts;
+        vector<UINT> NumRows;
+        vector<UINT64> RowSizes;
+        uint64_t UploadSize;
+        D3D12_RESOURCE_ALLOCATION_INFO Allocation;
+        bool Placed;
+    };
+
+    const size_t numTextures = textures.size();
+    vector<BatchEntry> entries(numTextures);
+
+    // Phase one reads only the headers, so that every texture is sized before any pixels are read.  Files
+    // are reopened for their pixels rather than all held open at once.
+    for (size_t i = 0; i < numTextures; ++i)
+    {
+        BatchEntry& entry = entries[i];
+        entry.Placed = false;
+
+        Utility::FileRangeReader file;
+        uint8_t header[DDSTextureInfo::kMaxHeaderSize];
+        if (!file.Open(filePaths[i]))
+            continue;
+
+        size_t headerSize = (size_t)(std::min)(file.GetSize(), (uint64_t)sizeof(header));
+        if (!file.Read(0, header, headerSize) || FAILED(GetDDSTextureInfo(header, headerSize, forceSRGB, entry.Info)))
+            continue;
+
+        const D3D12_RESOURCE_DESC& desc = entry.Info.Desc;
+        entry.NumSubresources = desc.MipLevels * (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize);
+        entry.Layouts.resize(entry.NumSubresources);
+        entry.NumRows.resize(entry.NumSubresources);
+        entry.RowSizes.resize(entry.NumSubresources);
+        g_Device->GetCopyableFootprints(&desc, 0, entry.NumSubresources, 0, entry.Layouts.data(),
+            entry.NumRows.data(), entry.RowSizes.data(), &entry.UploadSize);
+
+        // Reject truncated files before their resources exist
+        uint64_t dataSize = 0;
+        for (uint32_t s = 0; s < entry.NumSubresources; ++s)
+            dataSize += entry.RowSizes[s] * entry.NumRows[s] * entry.Layouts[s].Footprint.Depth;
+        if (entry.Info.DataOffset + dataSize > file.GetSize())
+            continue;
+
+        entry.Allocation = g_Device->GetResourceAllocationInfo(0, 1, &desc);
+        if (entry.Allocation.SizeInBytes == UINT64_MAX)
+            continue;
+
+        entry.Placed = true;
+    }
+
+    // Every texture is placed in a heap of its own.  Sharing heaps would keep a whole heap alive until the
+    // last of its textures was evicted, so the cache could never give memory back one texture at a time.
+    for (size_t i = 0; i < numTextures; ++i)
+    {
+        BatchEntry& entry = entries[i];
+        ManagedTexture* tex = textures[i];
+        if (!entry.Placed)
+            continue;
+
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = entry.Allocation.SizeInBytes;
+        heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        heapDesc.Alignment = entry.Allocation.Alignment;
+        heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        if (FAILED(g_Device->CreateHeap(&heapDesc, MY_IID_PPV_ARGS(heap.GetAddressOf()))) ||
+            FAILED(g_Device->CreatePlacedResource(heap.Get(), 0, &entry.Info.Desc, D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr, MY_IID_PPV_ARGS(tex->m_pResource.ReleaseAndGetAddressOf()))))
+        {
+            tex->m_pResource = nullptr;
+            entry.Placed = false;
+            continue;
+        }
+
+        tex->m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
+        tex->m_Heap = heap;
+    }
+
+    // Phase two reads each file's pixels straight into upload memory, laid out for the copy
+    CommandContext* context = nullptr;
+    vector<size_t> uploaded;
+    uint64_t uploadedBytes = 0;
+
+    // Wait for the copies so that the textures are complete before their descriptors are published
+    auto finishUploads = [&]
+    {
+        context->Finish(true);
+        context = nullptr;
+
+        for (size_t i : uploaded)
+        {
+            ManagedTexture* tex = textures[i];
+            if (!tex->m_OwnsDescriptor)
+            {
+                tex->m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+                tex->m_OwnsDescriptor = true;
+            }
+            CreateDDSTextureView(g_Device, tex->GetResource(), entries[i].Info, tex->m_hCpuDescriptorHandle);
+
+            tex->m_IsValid = true;
+            tex->UpdateResidentBytes();
+            const D3D12_RESOURCE_DESC& desc = entries[i].Info.Desc;
+            tex->m_Width = (uint32_t)desc.Width;
+            tex->m_Height = desc.Height;
+            tex->m_Depth = desc.DepthOrArraySize;
+            tex->FinishLoading();
+        }
+
+        uploaded.clear();
+        uploadedBytes = 0;
+    };
+
+    for (size_t i = 0; i < numTextures; ++i)
+    {
+        BatchEntry& entry = entries[i];
+        ManagedTexture* tex = textures[i];
+        if (!entry.Placed)
+            continue;
+
+        if (context == nullptr)
+            context = &CommandContext::Begin(L"Load Texture Batch");
+
+        DynAlloc upload = context->ReserveUploadMemory((size_t)entry.UploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        Utility::FileRangeReader file;
+        if (!file.Open(filePaths[i]) || !ReadSubresources(file, entry.Info.DataOffset, entry.NumSubresources,
+            entry.Layouts.data(), entry.NumRows.data(), entry.RowSizes.data(), upload.DataPtr))
+        {
+            // Nothing has been recorded for the resource, so it can be released now
+            tex->m_pResource = nullptr;
+            tex->m_Heap = nullptr;
+            entry.Placed = false;
+            continue;
+        }
+
+        context->CopyTextureFromUpload(*tex, entry.NumSubresources, entry.Layouts.data(), upload);
+        context->TransitionResource(*tex, D3D12_RESOURCE_STATE_GENERIC_READ);
+        uploaded.push_back(i);
+        uploadedBytes += entry.UploadSize;
+
+        if (uploadedBytes >= kMaxUploadBytes)
+            finishUploads();
+    }
+
+    if (context != nullptr)
+        finishUploads();
+
+    // Anything that couldn't be read in parts is loaded whole
+    for (size_t i = 0; i < numTextures; ++i)
+    {
+        if (!entries[i].Placed)
+            textures[i]->CreateFromMemory(Utility::ReadFileSync(filePaths[i]), fallback, forceSRGB);
+    }
+}
+
+bool ManagedTexture::RegisterForStreaming(const wstring& filePath, uint32_t fullWidth, uint32_t fullHeight, uint32_t fullMipCount, bool forceSRGB)
+{
+    using namespace TextureManager;
+
+    // Ask the device what each possible mip range costs.  Mips below the tail are never the top of
+    // a resource, so they are priced as the tail.
+    const D3D12_RESOURCE_DESC tailDesc = GetResource()->GetDesc();
+    const uint32_t tailMip = StreamingCore::MipForMaxSize(fullWidth, fullHeight, fullMipCount, StreamingCore::kTailSize);
+    bool supported = true;
+
+    StreamingCore::TextureState state = StreamingCore::MakeTextureState(fullWidth, fullHeight, fullMipCount,
+        [&](uint32_t mip) -> uint64_t
+    {
+        mip = (std::min)(mip, tailMip);
+        D3D12_RESOURCE_DESC desc = tailDesc;
+        desc.Width = (std::max)(fullWidth >> mip, 1u);
+        desc.Height = (std::max)(fullHeight >> mip, 1u);
+        desc.MipLevels = (UINT16)(fullMipCount - mip);
+        uint64_t size = g_Device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+        if (size == UINT64_MAX)
+            supported = false;
+        return size;
+    });
+
+    if (!supported || state.TailMip != tailMip)
+        return false;
+
+    m_Streamed = true;
+    m_ForceSRGB = forceSRGB;
+    m_FilePath = filePath;
+    m_FullWidth = fullWidth;
+    m_FullHeight = fullHeight;
+
+    lock_guard<mutex> Guard(s_StreamMutex);
+    m_StreamIndex = (uint32_t)s_StreamTextures.size();
+    s_StreamStates.push_back(state);
+    s_StreamTextures.push_back(this);
+    return true;
+}
+
+void ManagedTexture::RequestScreenSize(float pixels)
+{
+    float current = m_ScreenSize.load(std::memory_order_relaxed);
+    while (pixels > current && !m_ScreenSize.compare_exchange_weak(current, pixels, std::memory_order_relaxed))
+        ;
+}
+
+bool ManagedTexture::TryAddReference(void)
+{
+    size_t count = m_ReferenceCount.load();
+    while (count != 0 && !m_ReferenceCount.compare_exchange_weak(count, count + 1))
+        ;
+    return count != 0;
+}
+
+void TextureManager::UpdateStreaming( void )
+{
+    // Apply budget changes and the growth of textures still in use
+    {
+        lock_guard<mutex> Guard(s_Mutex);
+        TrimCache();
+    }
+
+    vector<FinishedStream> finished;
+    {
+        lock_guard<mutex> Guard(s_StreamMutex);
+        finished.swap(s_FinishedStreams);
+    }
+
+    // Swap in finished mip changes.  Each holds a reference to its texture, so the texture is
+    // still registered.
+    for (auto& result : finished)
+    {
+        ManagedTexture* tex = result.Texture;
+
+        {
+            lock_guard<mutex> Guard(s_StreamMutex);
+            StreamingCore::TextureState& state = s_StreamStates[tex->m_StreamIndex];
+            state.Busy = false;
+
+            if (result.Resource != nullptr)
+            {
+                RetiredResource retired = { tex->m_pResource, 0 };
+                s_RetiredResources.push_back(retired);
+
+                tex->m_pResource = result.Resource;
+                tex->UpdateResidentBytes();
+                D3D12_RESOURCE_DESC desc = result.Resource->GetDesc();
+                tex->m_Width = (uint32_t)desc.Width;
+                tex->m_Height = desc.Height;
+                state.ResidentMip = result.Mip;
+
+                g_Device->CopyDescriptorsSimple(1, tex->m_hCpuDescriptorHandle, result.SRV,
+                    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            }
+            else
+            {
+                // Don't keep retrying a mip that can't be created
+                state.TailMip = state.ResidentMip;
+            }
+            state.PendingMip = state.ResidentMip;
+
+            FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, result.SRV);
+        }
+
+        if (result.Resource != nullptr)
+            NotifyUpdated(tex->m_hCpuDescriptorHandle);
+
+        // May destroy the texture, which takes s_StreamMutex
+        if (--tex->m_ReferenceCount == 0)
+            tex->Unload();
+    }
+
+    lock_guard<mutex> Guard(s_StreamMutex);
+
+    // Frames already submitted may still read replaced resources
+    for (size_t i = 0; i < s_RetiredResources.size(); )
+    {
+        RetiredResource& retired = s_RetiredResources[i];
+        if (retired.FenceValue == 0)
+            retired.FenceValue = g_CommandManager.GetGraphicsQueue().IncrementFence();
+
+        if (g_CommandManager.IsFenceComplete(retired.FenceValue))
+        {
+            retired = s_RetiredResources.back();
+            s_RetiredResources.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Turn this frame's screen-size requests into mip requests.  With streaming turned off, every
+    // texture asks for full resolution.
+    const bool streaming = Streaming;
+    for (size_t i = 0; i < s_StreamTextures.size(); ++i)
+    {
+        ManagedTexture* tex = s_StreamTextures[i];
+        StreamingCore::TextureState& state = s_StreamStates[i];
+        float screenSize = tex->m_ScreenSize.exchange(0.0f, std::memory_order_relaxed);
+
+        if (!streaming || tex->m_Pinned)
+        {
+            state.RequestedMip = 0;
+            state.Priority = FLT_MAX;
+        }
+        else
+        {
+            state.RequestedMip = StreamingCore::MipForScreenSize(tex->m_FullWidth, tex->m_FullHeight, state.MipCount, screenSize);
+            state.Priority = screenSize;
+        }
+    }
+
+    uint64_t budget = (uint64_t)StreamingBudgetMB * 1024 * 1024;
+    s_Planner.Plan(s_StreamStates, budget, kMaxUploadBytesPerUpdate, s_Changes);
+
+    // Demotions come first and are never held back, since the plan made room for promotions with them
+    for (const StreamingCore::Change& change : s_Changes)
+    {
+        StreamingCore::TextureState& state = s_StreamStates[change.Index];
+        if (change.NewMip < state.ResidentMip && s_StreamsInFlight >= kMaxStreamsInFlight)
+            break;
+
+        ManagedTexture* tex = s_StreamTextures[change.Index];
+
+        // Keep the texture alive until the result is swapped in
+        if (!tex->TryAddReference())
+            continue;
+
+        state.Busy = true;
+        state.PendingMip = change.NewMip;
+        ++s_StreamsInFlight;
+        {
+            lock_guard<mutex> LoadGuard(s_LoadMutex);
+            ++s_PendingLoads;
+        }
+
+        wstring filePath = tex->m_FilePath;
+        size_t maxSize = StreamingCore::MaxSizeForMip(tex->m_FullWidth, tex->m_FullHeight, change.NewMip);
+        bool forceSRGB = tex->m_ForceSRGB;
+        uint32_t mip = change.NewMip;
+
+        // Create the new mip range in a fresh resource and view, to be swapped in on the main thread
+        Concurrency::create_task([tex, filePath, maxSize, forceSRGB, mip]
+        {
+            FinishedStream result;
+            result.Texture = tex;
+            result.Mip = mip;
+            result.SRV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            if (FAILED(CreateMipRangeFromFile(filePath, mip, maxSize, forceSRGB, result.Resource.GetAddressOf(), result.SRV)))
+            {
+                result.Resource = nullptr;
+            }
+
+            {
+                lock_guard<mutex> Guard(s_StreamMutex);
+                s_FinishedStreams.push_back(result);
+                --s_StreamsInFlight;
+            }
+
+            lock_guard<mutex> LoadGuard(s_LoadMutex);
+            --s_PendingLoads;
+            s_LoadCompleted.notify_all();
+        });
+    }
+}
+
+TextureManager::StreamingStats TextureManager::GetStreamingStats( void )
+{
+    lock_guard<mutex> Guard(s_StreamMutex);
+
+    StreamingStats stats = {};
+    stats.NumTextures = (uint32_t)s_StreamStates.size();
+    stats.NumInFlight = s_StreamsInFlight;
+    stats.BudgetBytes = (uint64_t)StreamingBudgetMB * 1024 * 1024;
+    for (const StreamingCore::TextureState& state : s_StreamStates)
+        stats.ResidentBytes += state.ResidentBytes();
+    return stats;
 }
 
 void ManagedTexture::WaitForLoad( void ) const
 {
-    while ((volatile bool&)m_IsLoading)
-        this_thread::yield();
+    unique_lock<mutex> Lock(TextureManager::s_LoadMutex);
+    TextureManager::s_LoadCompleted.wait(Lock, [this] { return !m_IsLoading; });
+}
+
+bool ManagedTexture::NotifyWhenLoaded(std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> callback)
+{
+    lock_guard<mutex> Guard(TextureManager::s_LoadMutex);
+    if (!m_IsLoading)
+        return false;
+    m_LoadCallbacks.push_back(std::move(callback));
+    return true;
 }
 
 void ManagedTexture::Unload()
 {
-    TextureManager::DestroyTexture(m_MapKey);
+    using namespace TextureManager;
+
+    lock_guard<mutex> Guard(s_Mutex);
+
+    // Another thread may have found the texture again since the count reached zero
+    if (m_ReferenceCount != 0 || m_IsUnused)
+        return;
+
+    s_UnusedTextures.push_front(this);
+    m_UnusedPosition = s_UnusedTextures.begin();
+    m_IsUnused = true;
+
+    // May free this texture
+    TrimCache();
 }
 
 TextureRef::TextureRef( const TextureRef& ref ) : m_ref(ref.m_ref)
@@ -185,21 +1081,22 @@ TextureRef::~TextureRef()
 
 void TextureRef::operator= (std::nullptr_t)
 {
-    if (m_ref != nullptr)
-        --m_ref->m_ReferenceCount;
+    if (m_ref != nullptr && --m_ref->m_ReferenceCount == 0)
+        m_ref->Unload();
 
     m_ref = nullptr;
 }
 
 void TextureRef::operator= (TextureRef& rhs)
 {
-    if (m_ref != nullptr)
-        --m_ref->m_ReferenceCount;
+    // Take the new reference first in case both point to the same texture
+    if (rhs.m_ref != nullptr)
+        ++rhs.m_ref->m_ReferenceCount;
 
-    m_ref = rhs.m_ref;
+    if (m_ref != nullptr && --m_ref->m_ReferenceCount == 0)
+        m_ref->Unload();
 
-    if (m_ref != nullptr)
-        ++m_ref->m_ReferenceCount;
+    m_ref = rhs.m_ref;
 }
 
 bool TextureRef::IsValid() const
@@ -207,6 +1104,23 @@ bool TextureRef::IsValid() const
     return m_ref && m_ref->IsValid();
 }
 
+void TextureRef::WaitForLoad() const
+{
+    if (m_ref != nullptr)
+        m_ref->WaitForLoad();
+}
+
+void TextureRef::RequestScreenSize( float pixels ) const
+{
+    if (m_ref != nullptr)
+        m_ref->RequestScreenSize(pixels);
+}
+
+bool TextureRef::NotifyWhenLoaded( std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> Callback ) const
+{
+    return m_ref != nullptr && m_ref->NotifyWhenLoaded(std::move(Callback));
+}
+
 const Texture* TextureRef::Get( void ) const
 {
     return m_ref;
@@ -236,3 +1150,46 @@ TextureRef TextureManager::LoadDDSFromFile( const string& filePath, eDefaultText
 {
     return LoadDDSFromFile(Utility::UTF8ToWideString(filePath), fallback, forceSRGB);
 }
+
+TextureRef TextureManager::LoadStreamedDDSFromFile( const wstring& filePath, eDefaultTexture fallback, bool forceSRGB )
+{
+    return FindOrLoadTexture(filePath, fallback, forceSRGB, Streaming);
+}
+
+void TextureManager::LoadDDSBatch( const vector<wstring>& filePaths, vector<TextureRef>& textures, eDefaultTexture fallback, bool forceSRGB )
+{
+    const bool async = AsyncLoading;
+    const size_t numTextures = filePaths.size();
+
+    vector<ManagedTexture*> requested;
+    vector<wstring> requestedPaths;
+    vector<ManagedTexture*> found;
+
+    textures.clear();
+    textures.reserve(numTextures);
+    {
+        lock_guard<mutex> Guard(s_Mutex);
+        for (size_t i = 0; i < numTextures; ++i)
+        {
+            bool newTexture;
+            ManagedTexture* tex = FindOrCreateTexture(filePaths[i], fallback, forceSRGB, async, newTexture);
+            textures.push_back(TextureRef(tex));
+            if (newTexture)
+            {
+                requested.push_back(tex);
+                requestedPaths.push_back(s_RootPath + filePaths[i]);
+            }
+            else
+            {
+                found.push_back(tex);
+            }
+        }
+    }
+
+    if (!requested.empty())
+        ManagedTexture::LoadBatch(std::move(requested), std::move(requestedPaths), fallback, forceSRGB, async);
+
+    // A file listed twice is found by its second lookup, so this comes after the batch
+    for (ManagedTexture* tex : found)
+        UseRequestedTexture(tex, async, false);
+}
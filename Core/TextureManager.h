@@ -18,6 +18,8 @@
 #include "Utility.h"
 #include "Texture.h"
 #include "GraphicsCommon.h"
+#include <atomic>
+#include <functional>
 
 // A referenced-counted pointer to a Texture.  See methods below.
 class TextureRef;
@@ -26,20 +28,81 @@ class TextureRef;
 // Texture file loading system.
 //
 // References to textures are passed around so that a texture may be shared.  When
-// all references to a texture expire, the texture memory is reclaimed.
+// all references to a texture expire, the texture stays cached in case it is loaded
+// again.  Unreferenced textures are freed, least recently used first, whenever the
+// memory of all textures exceeds the cache budget.
+//
+// With async loading, files are read and uploaded by background tasks.  The texture's
+// descriptor shows the fallback until then, and is overwritten in place once loaded.
+// Anything that copied the descriptor elsewhere can ask to be told when that happens.
+//
+// With streaming, textures loaded through LoadStreamedDDSFromFile() start with only
+// their low mips.  The renderer reports how large each texture appears on screen, and
+// once per frame the manager promotes and demotes textures to fit a memory budget.
+// A change creates the new mip range in the background, then swaps it in and rewrites
+// the texture's descriptor, notifying the update listener.
 //
 namespace TextureManager
 {
     using Graphics::eDefaultTexture;
     using Graphics::kMagenta2D;
 
+    extern BoolVar AsyncLoading;
+    extern BoolVar Streaming;
+    extern IntVar StreamingBudgetMB;
+    extern IntVar CacheBudgetMB;
+
     void Initialize( const std::wstring& RootPath );
     void Shutdown(void);
 
+    // Block until every background load has finished
+    void WaitForPendingLoads(void);
+
+    // Called with a texture's SRV whenever a background load or streaming rewrites it, so that
+    // copies of the descriptor can be refreshed.  May be called from any thread.
+    void SetUpdateListener( std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> listener );
+
+    // Called once per frame by Display::Present().  Swaps in finished mip changes and starts new ones.
+    void UpdateStreaming(void);
+
+    struct StreamingStats
+    {
+        uint32_t NumTextures;       // Textures being streamed
+        uint32_t NumInFlight;       // Mip changes being created
+        uint64_t ResidentBytes;
+        uint64_t BudgetBytes;
+    };
+
+    StreamingStats GetStreamingStats(void);
+
+    struct CacheStats
+    {
+        uint32_t NumTextures;       // Cached textures, referenced or not
+        uint32_t NumUnreferenced;   // Candidates for eviction
+        uint64_t ResidentBytes;     // Memory of every cached texture
+        uint64_t BudgetBytes;
+        uint64_t Hits;              // Loads that found the texture already cached
+        uint64_t Misses;
+        uint64_t Evictions;
+    };
+
+    CacheStats GetCacheStats(void);
+
     // Load a texture from a DDS file.  Never returns null references, but if a 
     // texture cannot be found, ref->IsValid() will return false.
     TextureRef LoadDDSFromFile( const std::wstring& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
     TextureRef LoadDDSFromFile( const std::string& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
+
+    // As above, but when streaming is enabled only the low mips are created at first.  Use for
+    // textures whose on-screen size is reported through TextureRef::RequestScreenSize().
+    TextureRef LoadStreamedDDSFromFile( const std::wstring& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
+
+    // Load many DDS files together, such as a model's.  Only the headers are read at first, so that every
+    // texture can be sized and placed in a heap of its own, then pixels are read straight into upload
+    // memory.  Files that can't be read in parts, such as compressed ones, are loaded individually.
+    // textures[i] is the reference for filePaths[i].  Models only use this with Streaming off.
+    void LoadDDSBatch( const std::vector<std::wstring>& filePaths, std::vector<TextureRef>& textures,
+        eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
 }
 
 // Forward declaration; private implementation
@@ -64,6 +127,18 @@ public:
     // Check that this points to a valid texture (which loaded successfully)
     bool IsValid() const;
 
+    // Call Callback with the SRV once a background load finishes.  The callback runs on the loading
+    // thread.  Returns false without calling it if the texture isn't loading, in which case GetSRV()
+    // already holds the final descriptor.  Register before copying GetSRV() to avoid missing an update.
+    bool NotifyWhenLoaded( std::function<void(D3D12_CPU_DESCRIPTOR_HANDLE)> Callback ) const;
+
+    // Block until a background load has finished, for callers that need IsValid() or the resource
+    void WaitForLoad() const;
+
+    // Ask for enough detail to cover a surface this many pixels across.  The largest request
+    // since the last streaming update wins.  Ignored unless the texture is streamed.
+    void RequestScreenSize( float pixels ) const;
+
     // Gets the SRV descriptor handle.  If the reference is invalid,
     // returns a valid descriptor handle (specified by the fallback)
     D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const;
@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Description:  Device-independent decisions for texture mip streaming, used by the TextureManager.
+// Nothing here touches D3D12.  Each streamed texture is described by the memory each possible top mip
+// would cost, the mip it has resident, and the mip and priority the renderer asked for this frame.  The
+// planner picks which textures to promote or demote so that the resident total stays within a budget.
+//
+// Mip numbers follow D3D: 0 is full resolution and larger numbers are smaller.  A texture's "resident
+// mip" is the most detailed mip it holds; every mip below it is resident too.  The tail mip is the most
+// detailed mip that is always resident.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace StreamingCore
+{
+    enum : uint32_t
+    {
+        kMaxMips = 16,
+        kTailSize = 128,        // Mips this size or smaller in both dimensions are never evicted
+    };
+
+    // Number of mips in a full chain for the given size
+    inline uint32_t FullMipCount( uint32_t Width, uint32_t Height )
+    {
+        uint32_t Count = 1;
+        for (uint32_t Size = (std::max)(Width, Height); Size > 1; Size >>= 1)
+            ++Count;
+        return Count;
+    }
+
+    // The most detailed mip no larger than MaxSize in either dimension
+    inline uint32_t MipForMaxSize( uint32_t Width, uint32_t Height, uint32_t MipCount, uint32_t MaxSize )
+    {
+        uint32_t Mip = 0;
+        while (Mip + 1 < MipCount && ((Width >> Mip) > MaxSize || (Height >> Mip) > MaxSize))
+            ++Mip;
+        return Mip;
+    }
+
+    // Inverse of MipForMaxSize, for loaders that are told a maximum size rather than a mip
+    inline uint32_t MaxSizeForMip( uint32_t Width, uint32_t Height, uint32_t Mip )
+    {
+        return (std::max)((std::max)(Width >> Mip, Height >> Mip), 1u);
+    }
+
+    // Screen-space diameter in pixels of a sphere at the given view depth.  ProjScale is the projection
+    // matrix's Y scale times half the viewport height.
+    inline float ProjectedDiameter( float Radius, float ViewDepth, float ProjScale, float NearDepth = 0.1f )
+    {
+        return 2.0f * Radius * ProjScale / (std::max)(ViewDepth, NearDepth);
+    }
+
+    // The mip whose size best matches a surface spanning ScreenSize pixels.  Assumes the texture maps
+    // once across the surface, so tiled textures are under-requested.
+    inline uint32_t MipForScreenSize( uint32_t Width, uint32_t Height, uint32_t MipCount, float ScreenSize )
+    {
+        if (ScreenSize <= 1.0f)
+            return MipCount - 1;
+
+        float TexelsPerPixel = (float)(std::max)(Width, Height) / ScreenSize;
+        if (TexelsPerPixel <= 1.0f)
+            return 0;
+
+        uint32_t Mip = (uint32_t)std::floor(std::log2(TexelsPerPixel));
+        return (std::min)(Mip, MipCount - 1);
+    }
+
+    struct TextureState
+    {
+        uint32_t MipCount;
+        uint32_t TailMip;
+        uint32_t ResidentMip;
+        uint32_t RequestedMip;
+        float Priority;                 // Larger is more important.  Zero when not seen this frame.
+        bool Busy;                      // A change is in flight; leave it alone
+        uint32_t PendingMip;            // The resident mip once the change in flight lands
+        uint64_t Bytes[kMaxMips];       // Memory for the chain starting at each mip
+
+        uint64_t ResidentBytes( void ) const { return Bytes[ResidentMip]; }
+    };
+
+    struct Change
+    {
+        uint32_t Index;                 // Into the texture array
+        uint32_t NewMip;
+    };
+
+    // Fills in MipCount, TailMip and Bytes for a texture whose mip chain starting at mip m costs
+    // BytesForMip(m).  ResidentMip starts at the tail.
+    template <typename BytesQuery>
+    inline TextureState MakeTextureState( uint32_t Width, uint32_t Height, uint32_t MipCount, const BytesQuery& BytesForMip )
+    {
+        TextureState State = {};
+        State.MipCount = (std::min)(MipCount, (uint32_t)kMaxMips);
+        State.TailMip = MipForMaxSize(Width, Height, State.MipCount, kTailSize);
+        State.ResidentMip = State.TailMip;
+        State.RequestedMip = State.TailMip;
+        State.PendingMip = State.TailMip;
+        for (uint32_t Mip = 0; Mip < State.MipCount; ++Mip)
+            State.Bytes[Mip] = BytesForMip(Mip);
+        return State;
+    }
+
+    // Decides which textures change resolution this update.
+    //
+    // Requests are granted in priority order while they fit in the budget.  A request that doesn't fit
+    // gets the most detailed mip that does.  Textures no longer requested keep what they have until
+    // the space is needed, so a texture that leaves the view briefly isn't reloaded; when space is
+    // needed, the lowest priority textures are demoted first, down to their tail.  Promotions are
+    // limited to MaxUploadBytes per update, but at least one is always allowed.  Demotions come first
+    // in Changes, so a caller that throttles promotions still frees the memory the plan counted on.
+    class ResidencyPlanner
+    {
+    public:
+        void Plan( const std::vector<TextureState>& Textures, uint64_t BudgetBytes, uint64_t MaxUploadBytes,
+            std::vector<Change>& Changes )
+        {
+            Changes.clear();
+            const size_t Count = Textures.size();
+
+            m_Target.resize(Count);
+            m_Order.resize(Count);
+
+            // Tails are always resident.  Textures in flight cost the larger of their old and new mips.
+            uint64_t Committed = 0;
+            for (size_t i = 0; i < Count; ++i)
+            {
+                const TextureState& Tex = Textures[i];
+                m_Order[i] = (uint32_t)i;
+                m_Target[i] = Tex.Busy ? (std::min)(Tex.ResidentMip, Tex.PendingMip) : Tex.TailMip;
+                Committed += Tex.Bytes[m_Target[i]];
+            }
+
+            std::stable_sort(m_Order.begin(), m_Order.end(), [&Textures]( uint32_t A, uint32_t B )
+                { return Textures[A].Priority > Textures[B].Priority; });
+
+            // Grant requests by priority
+            for (uint32_t Index : m_Order)
+            {
+                const TextureState& Tex = Textures[Index];
+                if (Tex.Busy || Tex.Priority <= 0.0f)
+                    continue;
+
+                uint32_t Mip = (std::min)(Tex.RequestedMip, Tex.TailMip);
+                while (Mip < Tex.TailMip && Committed - Tex.Bytes[Tex.TailMip] + Tex.Bytes[Mip] > BudgetBytes)
+                    ++Mip;
+
+                Committed += Tex.Bytes[Mip] - Tex.Bytes[Tex.TailMip];
+                m_Target[Index] = Mip;
+            }
+
+            // Unrequested textures keep their mips while there is room, best priority first
+            for (uint32_t Index : m_Order)
+            {
+                const TextureState& Tex = Textures[Index];
+                if (Tex.Busy || m_Target[Index] <= Tex.ResidentMip)
+                    continue;
+
+                uint64_t Extra = Tex.ResidentBytes() - Tex.Bytes[m_Target[Index]];
+                if (Committed + Extra <= BudgetBytes)
+                {
+                    Committed += Extra;
+                    m_Target[Index] = Tex.ResidentMip;
+                }
+            }
+
+            // Demotions free memory, so they are never throttled
+            for (uint32_t Index : m_Order)
+            {
+                const TextureState& Tex = Textures[Index];
+                if (!Tex.Busy && m_Target[Index] > Tex.ResidentMip)
+                {
+                    Change NewChange = { Index, m_Target[Index] };
+                    Changes.push_back(NewChange);
+                }
+            }
+
+            // Promotions go best first
+            uint64_t Uploaded = 0;
+            for (uint32_t Index : m_Order)
+            {
+                const TextureState& Tex = Textures[Index];
+                uint32_t Target = m_Target[Index];
+                if (Tex.Busy || Target >= Tex.ResidentMip)
+                    continue;
+
+                uint64_t Upload = Tex.Bytes[Target] - Tex.ResidentBytes();
+                if (Uploaded > 0 && Uploaded + Upload > MaxUploadBytes)
+                    continue;
+                Uploaded += Upload;
+
+                Change NewChange = { Index, Target };
+                Changes.push_back(NewChange);
+            }
+        }
+
+    private:
+        std::vector<uint32_t> m_Target;
+        std::vector<uint32_t> m_Order;
+    };
+
+} // namespace StreamingCore
@@ -0,0 +1,597 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+
+#include "BlockCompress.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace BlockCompress;
+
+namespace
+{
+    // Every encoder works on a block of 16 pixels with up to four float channels
+    struct Block
+    {
+        float pixels[16][4];
+        uint32_t channels;
+    };
+
+    inline float Clamp( float v, float lo, float hi )
+    {
+        return v < lo ? lo : (v > hi ? hi : v);
+    }
+
+    inline float DistanceSq( const float* a, const float* b, uint32_t channels )
+    {
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            float d = a[c] - b[c];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    // Pick two endpoints that span the block's colors
+    void FitEndpoints( const Block& block, Quality quality, float e0[4], float e1[4] )
+    {
+        const uint32_t channels = block.channels;
+
+        float lo[4], hi[4], mean[4] = {};
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            lo[c] = hi[c] = block.pixels[0][c];
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                lo[c] = (std::min)(lo[c], block.pixels[i][c]);
+                hi[c] = (std::max)(hi[c], block.pixels[i][c]);
+                mean[c] += block.pixels[i][c];
+            }
+            mean[c] /= 16.0f;
+        }
+
+        float cov[4][4] = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float d[4];
+            for (uint32_t c = 0; c < channels; ++c)
+                d[c] = block.pixels[i][c] - mean[c];
+            for (uint32_t r = 0; r < channels; ++r)
+                for (uint32_t c = 0; c < channels; ++c)
+                    cov[r][c] += d[r] * d[c];
+        }
+
+        if (quality == kFast)
+        {
+            // Use the bounding box diagonal, flipping channels that run against the widest one
+            uint32_t widest = 0;
+            for (uint32_t c = 1; c < channels; ++c)
+            {
+                if (hi[c] - lo[c] > hi[widest] - lo[widest])
+                    widest = c;
+            }
+
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                // Inset slightly, since the extremes are rarely the best endpoints
+                float inset = (hi[c] - lo[c]) / 16.0f;
+                bool flip = cov[widest][c] < 0.0f;
+                e0[c] = flip ? hi[c] - inset : lo[c] + inset;
+                e1[c] = flip ? lo[c] + inset : hi[c] - inset;
+            }
+            return;
+        }
+
+        // Power iteration for the principal axis, starting from the bounding box diagonal
+        float axis[4];
+        for (uint32_t c = 0; c < channels; ++c)
+            axis[c] = hi[c] - lo[c];
+
+        for (uint32_t iter = 0; iter < 8; ++iter)
+        {
+            float next[4] = {};
+            for (uint32_t r = 0; r < channels; ++r)
+                for (uint32_t c = 0; c < channels; ++c)
+                    next[r] += cov[r][c] * axis[c];
+
+            float length = 0.0f;
+            for (uint32_t c = 0; c < channels; ++c)
+                length += next[c] * next[c];
+            length = std::sqrt(length);
+
+            if (length < 1e-6f)
+                break;
+
+            for (uint32_t c = 0; c < channels; ++c)
+                axis[c] = next[c] / length;
+        }
+
+        float tMin = 0.0f, tMax = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (uint32_t c = 0; c < channels; ++c)
+                t += (block.pixels[i][c] - mean[c]) * axis[c];
+            tMin = (std::min)(tMin, t);
+            tMax = (std::max)(tMax, t);
+        }
+
+        float inset = (tMax - tMin) / 16.0f;
+        tMin += inset;
+        tMax -= inset;
+
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            e0[c] = Clamp(mean[c] + tMin * axis[c], 0.0f, 255.0f);
+            e1[c] = Clamp(mean[c] + tMax * axis[c], 0.0f, 255.0f);
+        }
+    }
+
+    // Least squares endpoints for the given interpolation weights.  Returns false if the weights
+    // don't determine them.
+    bool RefineEndpoints( const Block& block, const float weights[16], float e0[4], float e1[4] )
+    {
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (uint32_t c = 0; c < block.channels; ++c)
+            {
+                ax[c] += a * block.pixels[i][c];
+                bx[c] += b * block.pixels[i][c];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+            return false;
+
+        for (uint32_t c = 0; c < block.channels; ++c)
+        {
+            e0[c] = Clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, 255.0f);
+            e1[c] = Clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    // Choose the nearest palette entry for each pixel and return the total error
+    float AssignIndices( const Block& block, const float palette[][4], uint32_t paletteSize, uint8_t indices[16] )
+    {
+        float total = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float best = DistanceSq(block.pixels[i], palette[0], block.channels);
+            indices[i] = 0;
+            for (uint32_t p = 1; p < paletteSize; ++p)
+            {
+                float error = DistanceSq(block.pixels[i], palette[p], block.channels);
+                if (error < best)
+                {
+                    best = error;
+                    indices[i] = (uint8_t)p;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    // Least significant bit first, as the BC formats are laid out
+    struct BitWriter
+    {
+        uint8_t* out;
+        uint32_t pos;
+
+        void Put( uint32_t value, uint32_t count )
+        {
+            for (uint32_t b = 0; b < count; ++b, ++pos)
+            {
+                if (value >> b & 1)
+                    out[pos >> 3] |= (uint8_t)(1 << (pos & 7));
+            }
+        }
+    };
+
+    //
+    // BC1 color
+    //
+
+    inline uint16_t Quantize565( const float c[4] )
+    {
+        uint32_t r = (uint32_t)(Clamp(c[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        uint32_t g = (uint32_t)(Clamp(c[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        uint32_t b = (uint32_t)(Clamp(c[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    inline void Expand565( uint16_t v, float c[4] )
+    {
+        uint32_t r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+        c[0] = (float)(r << 3 | r >> 2);
+        c[1] = (float)(g << 2 | g >> 4);
+        c[2] = (float)(b << 3 | b >> 2);
+        c[3] = 255.0f;
+    }
+
+    // Palette position of each index in four color mode
+    const float kBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float EncodeBC1Endpoints( const Block& block, const float e0[4], const float e1[4], uint8_t* out )
+    {
+        uint16_t c0 = Quantize565(e0);
+        uint16_t c1 = Quantize565(e1);
+
+        // Four color mode requires c0 > c1.  Swapping endpoints swaps index pairs 0/1 and 2/3.
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        float palette[4][4];
+        Expand565(c0, palette[0]);
+        Expand565(c1, palette[1]);
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        uint8_t indices[16] = {};
+        float error;
+        if (c0 == c1)
+        {
+            // Three color mode; every pixel uses c0
+            error = 0.0f;
+            for (uint32_t i = 0; i < 16; ++i)
+                error += DistanceSq(block.pixels[i], palette[0], 3);
+        }
+        else
+        {
+            error = AssignIndices(block, palette, 4, indices);
+        }
+
+        std::memset(out, 0, 8);
+        out[0] = (uint8_t)c0;
+        out[1] = (uint8_t)(c0 >> 8);
+        out[2] = (uint8_t)c1;
+        out[3] = (uint8_t)(c1 >> 8);
+        BitWriter writer = { out, 32 };
+        for (uint32_t i = 0; i < 16; ++i)
+            writer.Put(indices[i], 2);
+
+        return error;
+    }
+
+    void EncodeBC1( const Block& block, uint8_t* out, Quality quality )
+    {
+        float e0[4], e1[4];
+        FitEndpoints(block, quality, e0, e1);
+        float bestError = EncodeBC1Endpoints(block, e0, e1, out);
+
+        if (quality != kHigh)
+            return;
+
+        for (uint32_t iter = 0; iter < 2; ++iter)
+        {
+            // Recover the chosen indices and the endpoint order from the encoded block
+            uint16_t c0 = (uint16_t)(out[0] | out[1] << 8);
+            uint16_t c1 = (uint16_t)(out[2] | out[3] << 8);
+            if (c0 == c1)
+                return;
+
+            uint32_t bits = out[4] | out[5] << 8 | out[6] << 16 | (uint32_t)out[7] << 24;
+            float weights[16];
+            for (uint32_t i = 0; i < 16; ++i)
+                weights[i] = kBC1Weights[bits >> (2 * i) & 3];
+
+            if (!RefineEndpoints(block, weights, e0, e1))
+                return;
+
+            uint8_t candidate[8];
+            float error = EncodeBC1Endpoints(block, e0, e1, candidate);
+            if (error >= bestError)
+                return;
+
+            bestError = error;
+            std::memcpy(out, candidate, 8);
+        }
+    }
+
+    //
+    // BC4 single channel, also used for BC3 alpha and BC5
+    //
+
+    float EncodeBC4Mode( const float values[16], uint32_t a0, uint32_t a1, uint8_t* out )
+    {
+        float palette[8];
+        palette[0] = (float)a0;
+        palette[1] = (float)a1;
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7.0f;
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * a0 + i * a1) / 5.0f;
+            palette[6] = 0.0f;
+            palette[7] = 255.0f;
+        }
+
+        std::memset(out, 0, 8);
+        out[0] = (uint8_t)a0;
+        out[1] = (uint8_t)a1;
+        BitWriter writer = { out, 16 };
+
+        float total = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t bestIndex = 0;
+            float best = std::fabs(values[i] - palette[0]);
+            for (uint32_t p = 1; p < 8; ++p)
+            {
+                float error = std::fabs(values[i] - palette[p]);
+                if (error < best)
+                {
+                    best = error;
+                    bestIndex = p;
+                }
+            }
+            writer.Put(bestIndex, 3);
+            total += best * best;
+        }
+        return total;
+    }
+
+    void EncodeBC4( const Block& block, uint32_t channel, uint8_t* out, Quality quality )
+    {
+        float values[16];
+        float lo = 255.0f, hi = 0.0f;
+        float innerLo = 255.0f, innerHi = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            values[i] = block.pixels[i][channel];
+            lo = (std::min)(lo, values[i]);
+            hi = (std::max)(hi, values[i]);
+            if (values[i] > 0.0f && values[i] < 255.0f)
+            {
+                innerLo = (std::min)(innerLo, values[i]);
+                innerHi = (std::max)(innerHi, values[i]);
+            }
+        }
+
+        uint32_t a0 = (uint32_t)(hi + 0.5f);
+        uint32_t a1 = (uint32_t)(lo + 0.5f);
+        float bestError = EncodeBC4Mode(values, a0, a1, out);
+
+        // The six value mode has exact 0 and 255, which helps blocks with a few saturated values
+        if (quality == kHigh && bestError > 0.0f && innerLo <= innerHi)
+        {
+            uint8_t candidate[8];
+            float error = EncodeBC4Mode(values, (uint32_t)(innerLo + 0.5f), (uint32_t)(innerHi + 0.5f), candidate);
+            if (error < bestError)
+                std::memcpy(out, candidate, 8);
+        }
+    }
+
+    //
+    // BC7 mode 6: one subset, 7-bit RGBA endpoints with a p-bit each, 4-bit indices
+    //
+
+    const uint32_t kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Choose the p-bit and 7-bit values that best represent an endpoint
+    void QuantizeBC7Endpoint( const float e[4], uint32_t q[4], uint32_t& pbit )
+    {
+        float bestError = 0.0f;
+        for (uint32_t p = 0; p < 2; ++p)
+        {
+            uint32_t candidate[4];
+            float error = 0.0f;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                float v = (e[c] - p) * 0.5f + 0.5f;
+                candidate[c] = (uint32_t)Clamp(v, 0.0f, 127.0f);
+                float d = (float)(candidate[c] * 2 + p) - e[c];
+                error += d * d;
+            }
+
+            if (p == 0 || error < bestError)
+            {
+                bestError = error;
+                pbit = p;
+                std::memcpy(q, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    float EncodeBC7Endpoints( const Block& block, const float e0[4], const float e1[4], uint8_t* out )
+    {
+        uint32_t q0[4], q1[4], p0, p1;
+        QuantizeBC7Endpoint(e0, q0, p0);
+        QuantizeBC7Endpoint(e1, q1, p1);
+
+        float palette[16][4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            uint32_t a = q0[c] * 2 + p0;
+            uint32_t b = q1[c] * 2 + p1;
+            for (uint32_t i = 0; i < 16; ++i)
+                palette[i][c] = (float)(((64 - kBC7Weights[i]) * a + kBC7Weights[i] * b + 32) >> 6);
+        }
+
+        uint8_t indices[16];
+        float error = AssignIndices(block, palette, 16, indices);
+
+        // The first index is stored with its top bit implied zero
+        if (indices[0] >= 8)
+        {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+            for (uint32_t i = 0; i < 16; ++i)
+                indices[i] = (uint8_t)(15 - indices[i]);
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter writer = { out, 0 };
+        writer.Put(1 << 6, 7);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            writer.Put(q0[c], 7);
+            writer.Put(q1[c], 7);
+        }
+        writer.Put(p0, 1);
+        writer.Put(p1, 1);
+        writer.Put(indices[0], 3);
+        for (uint32_t i = 1; i < 16; ++i)
+            writer.Put(indices[i], 4);
+
+        return error;
+    }
+
+    // Read back the indices of an encoded mode 6 block
+    void DecodeBC7Indices( const uint8_t* block, uint8_t indices[16] )
+    {
+        uint32_t pos = 65;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t count = i == 0 ? 3 : 4;
+            uint32_t value = 0;
+            for (uint32_t b = 0; b < count; ++b, ++pos)
+                value |= (block[pos >> 3] >> (pos & 7) & 1) << b;
+            indices[i] = (uint8_t)value;
+        }
+    }
+
+    void EncodeBC7( const Block& block, uint8_t* out, Quality quality )
+    {
+        float e0[4], e1[4];
+        FitEndpoints(block, quality, e0, e1);
+        float bestError = EncodeBC7Endpoints(block, e0, e1, out);
+
+        if (quality != kHigh)
+            return;
+
+        for (uint32_t iter = 0; iter < 2 && bestError > 0.0f; ++iter)
+        {
+            // Refinement only needs the weights, so endpoint order doesn't matter
+            uint8_t indices[16];
+            DecodeBC7Indices(out, indices);
+            float weights[16];
+            for (uint32_t i = 0; i < 16; ++i)
+                weights[i] = kBC7Weights[indices[i]] / 64.0f;
+
+            if (!RefineEndpoints(block, weights, e0, e1))
+                return;
+
+            uint8_t candidate[16];
+            float error = EncodeBC7Endpoints(block, e0, e1, candidate);
+            if (error >= bestError)
+                return;
+
+            bestError = error;
+            std::memcpy(out, candidate, 16);
+        }
+    }
+
+} // anonymous namespace
+
+void BlockCompress::CompressBlock( Format format, const uint8_t rgba[64], uint8_t* block, Quality quality )
+{
+    Block pixels;
+    for (uint32_t i = 0; i < 16; ++i)
+        for (uint32_t c = 0; c < 4; ++c)
+            pixels.pixels[i][c] = rgba[i * 4 + c];
+
+    switch (format)
+    {
+    case kBC1:
+        pixels.channels = 3;
+        EncodeBC1(pixels, block, quality);
+        break;
+
+    case kBC3:
+        pixels.channels = 3;
+        EncodeBC4(pixels, 3, block, quality);
+        EncodeBC1(pixels, block + 8, quality);
+        break;
+
+    case kBC4:
+        pixels.channels = 1;
+        EncodeBC4(pixels, 0, block, quality);
+        break;
+
+    case kBC5:
+        pixels.channels = 2;
+        EncodeBC4(pixels, 0, block, quality);
+        EncodeBC4(pixels, 1, block + 8, quality);
+        break;
+
+    case kBC7:
+        pixels.channels = 4;
+        EncodeBC7(pixels, block, quality);
+        break;
+    }
+}
+
+void BlockCompress::CompressImage( Format format, const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+    uint8_t* blocks, size_t blockRowPitch, Quality quality, uint32_t threadCount )
+{
+    if (width == 0 || height == 0)
+        return;
+
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    const uint32_t blockSize = BlockSize(format);
+
+    // Each worker takes the next row of blocks until none are left
+    std::atomic<uint32_t> nextRow(0);
+    auto worker = [&]
+    {
+        uint8_t pixels[64];
+        for (uint32_t by = nextRow++; by < blocksHigh; by = nextRow++)
+        {
+            uint8_t* dest = blocks + by * blockRowPitch;
+            for (uint32_t bx = 0; bx < blocksWide; ++bx, dest += blockSize)
+            {
+                for (uint32_t y = 0; y < 4; ++y)
+                {
+                    const uint8_t* row = rgba + (std::min)(by * 4 + y, height - 1) * rowPitch;
+                    for (uint32_t x = 0; x < 4; ++x)
+                        std::memcpy(pixels + (y * 4 + x) * 4, row + (std::min)(bx * 4 + x, width - 1) * 4, 4);
+                }
+                CompressBlock(format, pixels, dest, quality);
+            }
+        }
+    };
+
+    if (threadCount == 0)
+        threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+    threadCount = (std::min)(threadCount, blocksHigh);
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
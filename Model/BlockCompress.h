@@ -0,0 +1,55 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// A block compressor for 8-bit textures with no platform dependencies, so that textures can be baked
+// on machines without DirectXTex.  BC7 uses only mode 6 (one subset, RGBA endpoints), which is fast
+// and handles smooth gradients and alpha well, but loses to a full BC7 search on blocks with several
+// distinct colors.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace BlockCompress
+{
+    enum Format
+    {
+        kBC1,       // RGB, 4 bits per pixel.  Alpha is ignored.
+        kBC3,       // RGBA, 8 bits per pixel
+        kBC4,       // R, 4 bits per pixel
+        kBC5,       // RG, 8 bits per pixel
+        kBC7,       // RGBA, 8 bits per pixel
+    };
+
+    enum Quality
+    {
+        kFast,      // Endpoints from the bounding box
+        kNormal,    // Endpoints along the principal axis
+        kHigh,      // Principal axis, then least squares refinement
+    };
+
+    // Bytes in one 4x4 block
+    inline uint32_t BlockSize( Format format )
+    {
+        return format == kBC1 || format == kBC4 ? 8 : 16;
+    }
+
+    // Compress one 4x4 block of RGBA8 pixels, in row order
+    void CompressBlock( Format format, const uint8_t rgba[64], uint8_t* block, Quality quality );
+
+    // Compress an RGBA8 image.  Edge blocks of images that aren't a multiple of four repeat the last
+    // row and column.  Rows of blocks are spread across threadCount threads; zero uses every core.
+    void CompressImage( Format format, const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height,
+        uint8_t* blocks, size_t blockRowPitch, Quality quality, uint32_t threadCount = 0 );
+}
@@ -140,11 +140,13 @@ bool ModelH3D::BuildModel(ModelData& model, const std::wstring& basePath) const
     }
 
     ASSERT(model.m_TextureOptions.size() == model.m_TextureNames.size());
+    std::vector<TextureConversion> conversions(model.m_TextureNames.size());
     for (size_t ti = 0; ti < model.m_TextureNames.size(); ++ti)
     {
-        std::wstring fullPath = basePath + Utility::UTF8ToWideString(model.m_TextureNames[ti]);
-        CompileTextureOnDemand(fullPath, model.m_TextureOptions[ti]);
+        conversions[ti].originalFile = basePath + Utility::UTF8ToWideString(model.m_TextureNames[ti]);
+        conversions[ti].flags = model.m_TextureOptions[ti];
     }
+    CompileTexturesOnDemand(conversions);
 
     model.m_BoundingSphere = BoundingSphere(kZero);
     model.m_BoundingBox = AxisAlignedBox(kZero);
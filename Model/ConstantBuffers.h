@@ -55,6 +55,10 @@ __declspec(align(256)) struct MaterialConstants
             uint32_t alphaRef : 16; // half float
         };
     };
+
+    // Written at load time when rendering with bindless textures
+    uint32_t textureIndex[kNumTextures]; // Offsets into the scene texture heap
+    uint32_t samplerModes; // Address mode permutation for each texture, 4 bits each
 };
 
 __declspec(align(256)) struct GlobalConstants
@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:   James Stanard
+//
+// Splitting of a sorted draw range into chunks that can be recorded on separate
+// command lists, and the choice of targets each pass binds.  This has no dependency
+// on the device so it can be exercised in isolation.
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace Renderer
+{
+    // A contiguous run of sorted draws recorded into a single command list
+    struct DrawChunk
+    {
+        uint32_t firstDraw;
+        uint32_t numDraws;
+    };
+
+    // Split [firstDraw, firstDraw + numDraws) into at most maxChunks contiguous chunks.  Chunks are
+    // balanced to within one draw of each other and none is smaller than minDrawsPerChunk unless the
+    // whole range is.  Chunks are written in submission order.  Returns the number of chunks written.
+    inline uint32_t PartitionDraws( uint32_t firstDraw, uint32_t numDraws, uint32_t maxChunks,
+        uint32_t minDrawsPerChunk, DrawChunk* chunks )
+    {
+        if (numDraws == 0 || maxChunks == 0)
+            return 0;
+
+        if (minDrawsPerChunk == 0)
+            minDrawsPerChunk = 1;
+
+        uint32_t numChunks = numDraws / minDrawsPerChunk;
+        if (numChunks == 0)
+            numChunks = 1;
+        else if (numChunks > maxChunks)
+            numChunks = maxChunks;
+
+        const uint32_t drawsPerChunk = numDraws / numChunks;
+        const uint32_t remainder = numDraws % numChunks;
+
+        for (uint32_t i = 0; i < numChunks; ++i)
+        {
+            const uint32_t count = drawsPerChunk + (i < remainder ? 1 : 0);
+            chunks[i].firstDraw = firstDraw;
+            chunks[i].numDraws = count;
+            firstDraw += count;
+        }
+
+        return numChunks;
+    }
+
+    // Which targets a MeshSorter pass binds.  Passes are numbered as MeshSorter::DrawPass:
+    // depth only, opaque, then transparent.
+    struct PassBindings
+    {
+        bool bindColor;         // Scene color as well as depth
+        bool depthReadOnly;     // Depth was laid down by an earlier pass
+    };
+
+    inline PassBindings SelectPassBindings( bool shadowBatch, uint32_t pass, bool separateZPass )
+    {
+        PassBindings bindings = { false, false };
+
+        // Shadow batches only ever write depth
+        if (shadowBatch)
+            return bindings;
+
+        switch (pass)
+        {
+        case 1:     // Opaque
+            bindings.bindColor = true;
+            bindings.depthReadOnly = separateZPass;
+            break;
+        case 2:     // Transparent
+            bindings.bindColor = true;
+            bindings.depthReadOnly = true;
+            break;
+        }
+
+        return bindings;
+    }
+
+} // namespace Renderer
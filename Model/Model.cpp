@@ -14,6 +14,7 @@
 #include "Model.h"
 #include "Renderer.h"
 #include "ConstantBuffers.h"
+#include "../Core/TextureStreamingCore.h"
 
 using namespace Math;
 using namespace Renderer;
@@ -27,6 +28,20 @@ void Model::Destroy()
     m_NumMeshes = 0;
     m_MeshData = nullptr;
     m_SceneGraph = nullptr;
+
+    // Give back the descriptors and bindless slots the materials took when loading
+    if (Renderer::UsingBindlessTextures())
+    {
+        for (uint16_t textureIdx : m_MaterialTextures)
+        {
+            if (textureIdx != 0xFFFF)
+                Renderer::ReleaseBindlessTextureIndex(textures[textureIdx]);
+        }
+    }
+    for (uint32_t tableOffset : m_TextureTables)
+        Renderer::FreeTextureDescriptors(Renderer::s_TextureHeap[tableOffset], kNumTextures);
+    m_MaterialTextures.clear();
+    m_TextureTables.clear();
 }
 
 void Model::Render(
@@ -40,6 +55,7 @@ void Model::Render(
 
     const Frustum& frustum = sorter.GetViewFrustum();
     const AffineTransform& viewMat = (const AffineTransform&)sorter.GetViewMatrix();
+    const float projScale = m_MaterialTextures.empty() ? 0.0f : sorter.GetProjectedScale();
 
     for (uint32_t i = 0; i < m_NumMeshes; ++i)
     {
@@ -57,6 +73,18 @@ void Model::Render(
                 meshConstants.GetGpuVirtualAddress() + sizeof(MeshConstants) * mesh.meshCBV,
                 m_MaterialConstants.GetGpuVirtualAddress() + sizeof(MaterialConstants) * mesh.materialCBV,
                 m_DataBuffer.GetGpuVirtualAddress(), skeleton);
+
+            // Tell texture streaming how much detail the mesh's material needs
+            if (projScale > 0.0f)
+            {
+                float screenSize = StreamingCore::ProjectedDiameter(sphereVS.GetRadius(), -sphereVS.GetCenter().GetZ(), projScale);
+                const uint16_t* materialTextures = &m_MaterialTextures[mesh.materialCBV * kNumTextures];
+                for (uint32_t j = 0; j < kNumTextures; ++j)
+                {
+                    if (materialTextures[j] != 0xFFFF)
+                        textures[materialTextures[j]].RequestScreenSize(screenSize);
+                }
+            }
         }
 
         pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
@@ -120,6 +120,8 @@ public:
     std::unique_ptr<uint8_t[]> m_MeshData;
     std::unique_ptr<GraphNode[]> m_SceneGraph;
     std::vector<TextureRef> textures;
+    std::vector<uint16_t> m_MaterialTextures;  // kNumTextures indices into textures per material, 0xFFFF for none
+    std::vector<uint32_t> m_TextureTables;     // Offsets of material descriptor tables in s_TextureHeap, without bindless textures
     std::unique_ptr<uint8_t[]> m_KeyFrameData;
     std::unique_ptr<AnimationCurve[]> m_CurveData;
     std::unique_ptr<AnimationSet[]> m_Animations;
@@ -84,9 +84,10 @@ void Renderer::CompileMesh(
 
     uint32_t totalBufferSize = (uint32_t)(totalVertexSize + totalDepthVertexSize + totalIndexSize);
 
-    Utility::ByteArray stagingBuffer;
-    stagingBuffer.reset(new std::vector<byte>(totalBufferSize));
-    uint8_t* uploadMem = stagingBuffer->data();
+    // Write straight into the model's buffer rather than staging a copy
+    const uint32_t baseOffset = (uint32_t)bufferMemory.size();
+    bufferMemory.resize(baseOffset + totalBufferSize);
+    uint8_t* uploadMem = bufferMemory.data() + baseOffset;
 
     uint32_t curVBOffset = 0;
     uint32_t curDepthVBOffset = (uint32_t)totalVertexSize;
@@ -115,11 +116,11 @@ void Renderer::CompileMesh(
         mesh->bounds[1] = collectiveSphere.GetCenter().GetY();
         mesh->bounds[2] = collectiveSphere.GetCenter().GetZ();
         mesh->bounds[3] = collectiveSphere.GetRadius();
-        mesh->vbOffset = (uint32_t)bufferMemory.size() + curVBOffset;
+        mesh->vbOffset = baseOffset + curVBOffset;
         mesh->vbSize = (uint32_t)vbSize;
-        mesh->vbDepthOffset = (uint32_t)bufferMemory.size() + curDepthVBOffset;
+        mesh->vbDepthOffset = baseOffset + curDepthVBOffset;
         mesh->vbDepthSize = (uint32_t)vbDepthSize;
-        mesh->ibOffset = (uint32_t)bufferMemory.size() + curIBOffset;
+        mesh->ibOffset = baseOffset + curIBOffset;
         mesh->ibSize = (uint32_t)ibSize;
         mesh->vbStride = (uint8_t)iter.second[0]->vertexStride;
         mesh->ibFormat = uint8_t(iter.second[0]->index32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT);
@@ -163,8 +164,6 @@ void Renderer::CompileMesh(
 
         meshList.push_back(mesh);
     }
-
-    bufferMemory.insert(bufferMemory.end(), stagingBuffer->begin(), stagingBuffer->end());
 }
 
 
@@ -321,18 +320,22 @@ void BuildMaterials(ModelData& model, const glTF::Asset& asset)
     }
 
     model.m_TextureOptions.clear();
+    std::vector<TextureConversion> conversions;
     for (auto name : model.m_TextureNames)
     {
         auto iter = textureOptions.find(name);
         if (iter != textureOptions.end())
         {
             model.m_TextureOptions.push_back(iter->second);
-            CompileTextureOnDemand(asset.m_basePath + Utility::UTF8ToWideString(iter->first), iter->second);
+            TextureConversion conversion = { asset.m_basePath + Utility::UTF8ToWideString(iter->first), iter->second };
+            conversions.push_back(conversion);
         }
         else
             model.m_TextureOptions.push_back(0xFF);
     }
     ASSERT(model.m_TextureOptions.size() == model.m_TextureNames.size());
+
+    CompileTexturesOnDemand(conversions);
 }
 
 void BuildAnimations(ModelData& model, const glTF::Asset& asset)
@@ -31,6 +31,10 @@ namespace Renderer
 {
     extern DescriptorHeap s_TextureHeap;
     extern DescriptorHeap s_SamplerHeap;
+
+    void TrackTextureCopy(const TextureRef& texture, D3D12_CPU_DESCRIPTOR_HANDLE dest);
+    DescriptorHandle AllocTextureDescriptors(uint32_t count);
+    void FreeTextureDescriptors(DescriptorHandle first, uint32_t count);
 }
 
 ModelH3D::ModelH3D()
@@ -57,6 +61,9 @@ void ModelH3D::Clear()
     m_pMesh = nullptr;
     m_Header.meshCount = 0;
 
+    Renderer::FreeTextureDescriptors(m_SRVs, m_Header.materialCount * 6);
+    m_SRVs = DescriptorHandle();
+
     delete [] m_pMaterial;
     m_pMaterial = nullptr;
     m_Header.materialCount = 0;
@@ -303,7 +310,7 @@ void ModelH3D::LoadTextures(const std::wstring& basePath)
     using namespace TextureManager;
 
     m_TextureReferences.resize(m_Header.materialCount * 3);
-    m_SRVs = Renderer::s_TextureHeap.Alloc(m_Header.materialCount * 6);
+    m_SRVs = Renderer::AllocTextureDescriptors(m_Header.materialCount * 6);
     m_SRVDescriptorSize = Renderer::s_TextureHeap.GetDescriptorSize();
 
     DescriptorHandle SRVs = m_SRVs;
@@ -321,15 +328,22 @@ void ModelH3D::LoadTextures(const std::wstring& basePath)
         // Load specular
         std::wstring specularPath = basePath + RemoveExt(pMaterial.texSpecularPath);
         MatTextures[1] = LoadDDSFromFile(specularPath + L".dds", kBlackOpaque2D, true);
+        MatTextures[1].WaitForLoad();
         if (!MatTextures[1].IsValid())
             MatTextures[1] = LoadDDSFromFile(diffusePath + L"_specular.dds", kBlackOpaque2D, true);
 
         // Load normal
         std::wstring normalPath = basePath + RemoveExt(pMaterial.texNormalPath);
         MatTextures[2] = LoadDDSFromFile(normalPath + L".dds", kDefaultNormalMap, false);
+        MatTextures[2].WaitForLoad();
         if (!MatTextures[2].IsValid())
             MatTextures[2] = LoadDDSFromFile(diffusePath + L"_normal.dds", kDefaultNormalMap, false);
 
+        // Any that are still loading are copied again when they finish
+        Renderer::TrackTextureCopy(MatTextures[0], SRVs);
+        Renderer::TrackTextureCopy(MatTextures[1], SRVs + m_SRVDescriptorSize);
+        Renderer::TrackTextureCopy(MatTextures[2], SRVs + 3 * m_SRVDescriptorSize);
+
         uint32_t DestCount = 6;
         uint32_t SourceCounts[] = { 1, 1, 1, 1, 1, 1 };
         D3D12_CPU_DESCRIPTOR_HANDLE SourceTextures[6] =
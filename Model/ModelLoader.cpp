@@ -22,6 +22,7 @@
 #include "TextureManager.h"
 #include "TextureConvert.h"
 #include "GraphicsCommon.h"
+#include "../Core/FileUtility.h"
 
 #include <fstream>
 #include <unordered_map>
@@ -43,86 +44,151 @@ void LoadMaterials(Model& model,
     const std::vector<MaterialTextureData>& materialTextures,
     const std::vector<std::wstring>& textureNames,
     const std::vector<uint8_t>& textureOptions,
-    const std::wstring& basePath)
+    const std::wstring& basePath,
+    MaterialConstants* materialConstants)
 {
     static_assert((_alignof(MaterialConstants) & 255) == 0, "CBVs need 256 byte alignment");
 
-    // Load textures
+    // Bring every DDS file up to date in one batch, then load them
     const uint32_t numTextures = (uint32_t)textureNames.size();
-    model.textures.resize(numTextures);
+    std::vector<TextureConversion> conversions(numTextures);
     for (size_t ti = 0; ti < numTextures; ++ti)
     {
-        std::wstring originalFile = basePath + textureNames[ti];
-        CompileTextureOnDemand(originalFile, textureOptions[ti]);
+        conversions[ti].originalFile = basePath + textureNames[ti];
+        conversions[ti].flags = textureOptions[ti];
+    }
+    CompileTexturesOnDemand(conversions);
+
+    std::vector<std::wstring> ddsFiles(numTextures);
+    for (size_t ti = 0; ti < numTextures; ++ti)
+        ddsFiles[ti] = Utility::RemoveExtension(conversions[ti].originalFile) + L".dds";
 
-        std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
-        model.textures[ti] = TextureManager::LoadDDSFromFile(ddsFile);
+    // Streamed textures keep their files to create other mips from, so only full loads are batched
+    if (TextureManager::Streaming)
+    {
+        model.textures.resize(numTextures);
+        for (size_t ti = 0; ti < numTextures; ++ti)
+            model.textures[ti] = TextureManager::LoadStreamedDDSFromFile(ddsFiles[ti]);
+    }
+    else
+    {
+        TextureManager::LoadDDSBatch(ddsFiles, model.textures);
     }
 
-    // Generate descriptor tables and record offsets for each material
     const uint32_t numMaterials = (uint32_t)materialTextures.size();
-    std::vector<uint32_t> tableOffsets(numMaterials);
 
+    // Model::Render() reports on-screen sizes to each material's textures
+    model.m_MaterialTextures.resize(numMaterials * kNumTextures);
     for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx)
     {
-        const MaterialTextureData& srcMat = materialTextures[matIdx];
-
-        DescriptorHandle TextureHandles = Renderer::s_TextureHeap.Alloc(kNumTextures);
-        uint32_t SRVDescriptorTable = Renderer::s_TextureHeap.GetOffsetOfHandle(TextureHandles);
-
-        uint32_t DestCount = kNumTextures;
-        uint32_t SourceCounts[kNumTextures] = { 1, 1, 1, 1, 1 };
-
-        D3D12_CPU_DESCRIPTOR_HANDLE DefaultTextures[kNumTextures] =
-        {
-            GetDefaultTexture(kWhiteOpaque2D),
-            GetDefaultTexture(kWhiteOpaque2D),
-            GetDefaultTexture(kWhiteOpaque2D),
-            GetDefaultTexture(kBlackTransparent2D),
-            GetDefaultTexture(kDefaultNormalMap)
-        };
-
-        D3D12_CPU_DESCRIPTOR_HANDLE SourceTextures[kNumTextures];
         for (uint32_t j = 0; j < kNumTextures; ++j)
+            model.m_MaterialTextures[matIdx * kNumTextures + j] = materialTextures[matIdx].stringIdx[j];
+    }
+    std::vector<uint32_t> tableOffsets(numMaterials);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE DefaultTextures[kNumTextures] =
+    {
+        GetDefaultTexture(kWhiteOpaque2D),
+        GetDefaultTexture(kWhiteOpaque2D),
+        GetDefaultTexture(kWhiteOpaque2D),
+        GetDefaultTexture(kBlackTransparent2D),
+        GetDefaultTexture(kDefaultNormalMap)
+    };
+
+    // With bindless textures each unique texture is placed in the heap once and materials record
+    // where.  Otherwise generate descriptor tables and record offsets for each material.
+    if (Renderer::UsingBindlessTextures())
+    {
+        for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx)
         {
-            if (srcMat.stringIdx[j] == 0xffff)
-                SourceTextures[j] = DefaultTextures[j];
-            else
-                SourceTextures[j] = model.textures[srcMat.stringIdx[j]].GetSRV();
-        }
+            const MaterialTextureData& srcMat = materialTextures[matIdx];
+            MaterialConstants& dstMat = materialConstants[matIdx];
 
-        g_Device->CopyDescriptors(1, &TextureHandles, &DestCount,
-            DestCount, SourceTextures, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            for (uint32_t j = 0; j < kNumTextures; ++j)
+            {
+                if (srcMat.stringIdx[j] == 0xffff)
+                    dstMat.textureIndex[j] = Renderer::GetBindlessTextureIndex(DefaultTextures[j]);
+                else
+                    dstMat.textureIndex[j] = Renderer::GetBindlessTextureIndex(model.textures[srcMat.stringIdx[j]]);
+            }
+            dstMat.samplerModes = srcMat.addressModes;
+        }
+    }
+    else
+    {
+        for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx)
+        {
+            const MaterialTextureData& srcMat = materialTextures[matIdx];
 
-        // See if this combination of samplers has been used before.  If not, allocate more from the heap
-        // and copy in the descriptors.
-        uint32_t addressModes = srcMat.addressModes;
-        auto samplerMapLookup = g_SamplerPermutations.find(addressModes);
+            DescriptorHandle TextureHandles = Renderer::AllocTextureDescriptors(kNumTextures);
+            uint32_t SRVDescriptorTable = Renderer::s_TextureHeap.GetOffsetOfHandle(TextureHandles);
+            model.m_TextureTables.push_back(SRVDescriptorTable);
 
-        if (samplerMapLookup == g_SamplerPermutations.end())
-        {
-            DescriptorHandle SamplerHandles = Renderer::s_SamplerHeap.Alloc(kNumTextures);
-            uint32_t SamplerDescriptorTable = Renderer::s_SamplerHeap.GetOffsetOfHandle(SamplerHandles);
-            g_SamplerPermutations[addressModes] = SamplerDescriptorTable;
-            tableOffsets[matIdx] = SRVDescriptorTable | SamplerDescriptorTable << 16;
+            uint32_t DestCount = kNumTextures;
+            uint32_t SourceCounts[kNumTextures] = { 1, 1, 1, 1, 1 };
 
-            D3D12_CPU_DESCRIPTOR_HANDLE SourceSamplers[kNumTextures];
+            D3D12_CPU_DESCRIPTOR_HANDLE SourceTextures[kNumTextures];
             for (uint32_t j = 0; j < kNumTextures; ++j)
             {
-                SourceSamplers[j] = GetSampler(addressModes & 0xF);
-                addressModes >>= 4;
+                if (srcMat.stringIdx[j] == 0xffff)
+                    SourceTextures[j] = DefaultTextures[j];
+                else
+                {
+                    const TextureRef& texture = model.textures[srcMat.stringIdx[j]];
+                    Renderer::TrackTextureCopy(texture, TextureHandles + (int)(j * Renderer::s_TextureHeap.GetDescriptorSize()));
+                    SourceTextures[j] = texture.GetSRV();
+                }
+            }
+
+            g_Device->CopyDescriptors(1, &TextureHandles, &DestCount,
+                DestCount, SourceTextures, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+            // See if this combination of samplers has been used before.  If not, allocate more from the heap
+            // and copy in the descriptors.
+            uint32_t addressModes = srcMat.addressModes;
+            auto samplerMapLookup = g_SamplerPermutations.find(addressModes);
+
+            if (samplerMapLookup == g_SamplerPermutations.end())
+            {
+                DescriptorHandle SamplerHandles = Renderer::s_SamplerHeap.Alloc(kNumTextures);
+                uint32_t SamplerDescriptorTable = Renderer::s_SamplerHeap.GetOffsetOfHandle(SamplerHandles);
+                g_SamplerPermutations[addressModes] = SamplerDescriptorTable;
+                tableOffsets[matIdx] = SRVDescriptorTable | SamplerDescriptorTable << 16;
+
+                D3D12_CPU_DESCRIPTOR_HANDLE SourceSamplers[kNumTextures];
+                for (uint32_t j = 0; j < kNumTextures; ++j)
+                {
+                    SourceSamplers[j] = GetSampler(addressModes & 0xF);
+                    addressModes >>= 4;
+                }
+                g_Device->CopyDescriptors(1, &SamplerHandles, &DestCount,
+                    DestCount, SourceSamplers, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+            }
+            else
+            {
+                tableOffsets[matIdx] = SRVDescriptorTable | samplerMapLookup->second << 16;
             }
-            g_Device->CopyDescriptors(1, &SamplerHandles, &DestCount,
-                DestCount, SourceSamplers, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
         }
-        else
+    }
+
+    // Compile every pipeline the model needs up front and in parallel
+    bool flagsSeen[PSOFlags::kHasSkin << 1] = {};
+    std::vector<uint16_t> psoFlags;
+    uint8_t* meshPtr = model.m_MeshData.get();
+    for (uint32_t i = 0; i < model.m_NumMeshes; ++i)
+    {
+        const Mesh& mesh = *(const Mesh*)meshPtr;
+        if (!flagsSeen[mesh.psoFlags])
         {
-            tableOffsets[matIdx] = SRVDescriptorTable | samplerMapLookup->second << 16;
+            flagsSeen[mesh.psoFlags] = true;
+            psoFlags.push_back(mesh.psoFlags);
         }
+        meshPtr += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
     }
+    Renderer::PrecompilePSOs(psoFlags.data(), (uint32_t)psoFlags.size());
 
     // Update table offsets for each mesh
-    uint8_t* meshPtr = model.m_MeshData.get();
+    meshPtr = model.m_MeshData.get();
     for (uint32_t i = 0; i < model.m_NumMeshes; ++i)
     {
         Mesh& mesh = *(Mesh*)meshPtr;
@@ -134,6 +200,16 @@ void LoadMaterials(Model& model,
     }
 }
 
+// Parses a file that has been read whole, so that .mini files can come from archives
+struct ByteArrayStreamBuf : public std::streambuf
+{
+    explicit ByteArrayStreamBuf(const Utility::ByteArray& data)
+    {
+        char* begin = (char*)data->data();
+        setg(begin, begin, begin + data->size());
+    }
+};
+
 std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool forceRebuild)
 {
     const std::wstring miniFileName = Utility::RemoveExtension(filePath) + L".mini";
@@ -141,12 +217,17 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
 
     struct _stat64 sourceFileStat;
     struct _stat64 miniFileStat;
-    std::ifstream inFile;
+    Utility::ByteArray miniFile;
     FileHeader header;
 
     bool sourceFileMissing = _wstat64(filePath.c_str(), &sourceFileStat) == -1;
     bool miniFileMissing = _wstat64(miniFileName.c_str(), &miniFileStat) == -1;
 
+    // A .mini that is only in an archive or compressed is taken to be current
+    bool miniFilePacked = miniFileMissing && Utility::GetFileSize(miniFileName) > 0;
+    if (miniFilePacked)
+        miniFileMissing = false;
+
     if (sourceFileMissing)
         forceRebuild = false;
 
@@ -159,19 +240,20 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
     bool needBuild = forceRebuild;
 
     // Check if .mini file exists and it is newer than source file
-    if (miniFileMissing || !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
+    if (miniFileMissing || !miniFilePacked && !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
         needBuild = true;
 
-    // Check if it's an older version of .mini
+    // Check if it's an older version of .mini.  A loose file was judged current by its time stamp, so
+    // read it rather than a packed copy that may be stale.
     if (!needBuild)
     {
-        inFile = std::ifstream(miniFileName, std::ios::in | std::ios::binary);
-        inFile.read((char*)&header, sizeof(FileHeader));
-        if (strncmp(header.id, "MINI", 4) != 0 || header.version != CURRENT_MINI_FILE_VERSION)
+        miniFile = miniFilePacked ? Utility::ReadFileSync(miniFileName) : Utility::ReadLooseFileSync(miniFileName);
+        const FileHeader* miniHeader = (const FileHeader*)miniFile->data();
+        if (miniFile->size() < sizeof(FileHeader) || strncmp(miniHeader->id, "MINI", 4) != 0 ||
+            miniHeader->version != CURRENT_MINI_FILE_VERSION)
         {
             Utility::Printf("Model version deprecated.  Rebuilding %ws...\n", fileName.c_str());
             needBuild = true;
-            inFile.close();
         }
     }
 
@@ -209,13 +291,17 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
         if (!SaveModel(miniFileName, modelData))
             return nullptr;
 
-        inFile = std::ifstream(miniFileName, std::ios::in | std::ios::binary);
-        inFile.read((char*)&header, sizeof(FileHeader));
+        // Archives and compressed siblings may still hold an older copy
+        miniFile = Utility::ReadLooseFileSync(miniFileName);
     }
 
-    if (!inFile)
+    if (miniFile->size() < sizeof(FileHeader))
         return nullptr;
 
+    ByteArrayStreamBuf miniBuffer(miniFile);
+    std::istream inFile(&miniBuffer);
+    inFile.read((char*)&header, sizeof(FileHeader));
+
     ASSERT(strncmp(header.id, "MINI", 4) == 0 && header.version == CURRENT_MINI_FILE_VERSION);
 
     std::wstring basePath = Utility::GetBasePath(filePath);
@@ -239,18 +325,15 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
     inFile.read((char*)model->m_SceneGraph.get(), header.numNodes * sizeof(GraphNode));
     inFile.read((char*)model->m_MeshData.get(), header.meshDataSize);
 
+	// Left mapped until LoadMaterials() has filled in bindless texture indices
+	UploadBuffer materialConstants;
+	MaterialConstants* materialCBVs = nullptr;
 	if (header.numMaterials > 0)
 	{
-		UploadBuffer materialConstants;
 		materialConstants.Create(L"Material Constant Upload", header.numMaterials * sizeof(MaterialConstants));
-		MaterialConstants* materialCBV = (MaterialConstants*)materialConstants.Map();
+		materialCBVs = (MaterialConstants*)materialConstants.Map();
 		for (uint32_t i = 0; i < header.numMaterials; ++i)
-		{
-			inFile.read((char*)materialCBV, sizeof(MaterialConstantData));
-			materialCBV++;
-		}
-		materialConstants.Unmap();
-		model->m_MaterialConstants.Create(L"Material Constants", header.numMaterials, sizeof(MaterialConstants), materialConstants);
+			inFile.read((char*)&materialCBVs[i], sizeof(MaterialConstantData));
 	}
 
     // Read material texture and sampler properties so we can load the material
@@ -268,7 +351,13 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
     std::vector<uint8_t> textureOptions(header.numTextures);
     inFile.read((char*)textureOptions.data(), header.numTextures * sizeof(uint8_t));
 
-    LoadMaterials(*model, materialTextures, textureNames, textureOptions, basePath);
+    LoadMaterials(*model, materialTextures, textureNames, textureOptions, basePath, materialCBVs);
+
+	if (header.numMaterials > 0)
+	{
+		materialConstants.Unmap();
+		model->m_MaterialConstants.Create(L"Material Constants", header.numMaterials, sizeof(MaterialConstants), materialConstants);
+	}
 
     model->m_BoundingSphere = BoundingSphere(*(XMFLOAT4*)header.boundingSphere);
     model->m_BoundingBox = AxisAlignedBox(Vector3(*(XMFLOAT3*)header.minPos), Vector3(*(XMFLOAT3*)header.maxPos));
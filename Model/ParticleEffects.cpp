@@ -47,6 +47,7 @@ namespace
 
             // Load the texture and register it with the effect manager
             TextureRef texture = TextureManager::LoadDDSFromFile(name, kMagenta2D, true);
+            texture.WaitForLoad();
             s_TextureReferences.push_back(texture);
             ParticleEffectManager::RegisterTexture(index, *texture.Get());
 
@@ -21,6 +21,13 @@
 #include "../Core/GraphicsCommon.h"
 #include "../Core/BufferManager.h"
 #include "../Core/ShadowCamera.h"
+#include "../Core/CommandListManager.h"
+#include "DrawPartition.h"
+#include <ppl.h>
+#include <mutex>
+#include <atomic>
+#include <queue>
+#include <unordered_map>
 
 #include "CompiledShaders/DefaultVS.h"
 #include "CompiledShaders/DefaultSkinVS.h"
@@ -34,11 +41,16 @@
 #include "CompiledShaders/DefaultNoTangentNoUV1VS.h"
 #include "CompiledShaders/DefaultNoTangentNoUV1SkinVS.h"
 #include "CompiledShaders/DefaultNoTangentNoUV1PS.h"
+#include "CompiledShaders/DefaultBindlessPS.h"
+#include "CompiledShaders/DefaultNoUV1BindlessPS.h"
+#include "CompiledShaders/DefaultNoTangentBindlessPS.h"
+#include "CompiledShaders/DefaultNoTangentNoUV1BindlessPS.h"
 #include "CompiledShaders/DepthOnlyVS.h"
 #include "CompiledShaders/DepthOnlySkinVS.h"
 #include "CompiledShaders/CutoutDepthVS.h"
 #include "CompiledShaders/CutoutDepthSkinVS.h"
 #include "CompiledShaders/CutoutDepthPS.h"
+#include "CompiledShaders/CutoutDepthBindlessPS.h"
 #include "CompiledShaders/SkyboxVS.h"
 #include "CompiledShaders/SkyboxPS.h"
 
@@ -51,6 +63,12 @@ using namespace Renderer;
 namespace Renderer
 {
     BoolVar SeparateZPass("Renderer/Separate Z Pass", true);
+    BoolVar ParallelRecording("Renderer/Parallel Recording", false);
+    IntVar MinDrawsPerChunk("Renderer/Min Draws Per Chunk", 64, 1, 4096, 16);
+    BoolVar AsyncPSOCompilation("Renderer/Async PSO Compilation", false);
+
+    // Upper bound on command lists a single pass is split across
+    static const uint32_t kMaxDrawChunks = 8;
 
     bool s_Initialized = false;
 
@@ -70,6 +88,70 @@ namespace Renderer
     GraphicsPSO m_DefaultPSO(L"Renderer: Default PSO"); // Not finalized.  Used as a template.
 
     DescriptorHandle m_CommonTextures;
+
+    bool s_BindlessTextures = false;
+
+    // One sampler per address mode permutation.  Bindless materials select from these with the
+    // same 4 bits per texture that MaterialTextureData::addressModes uses.
+    static const uint32_t kNumSamplerPermutations = 16;
+    DescriptorHandle m_BindlessSamplers;
+
+    // Textures placed in s_TextureHeap, with the number of material slots using each.  The reference
+    // keeps the texture, and so its source descriptor, alive until the last use is released.
+    struct BindlessTexture
+    {
+        uint32_t index;
+        uint32_t useCount;
+        TextureRef texture;
+    };
+    std::unordered_map<const Texture*, BindlessTexture> s_BindlessTextureSlots;
+
+    // Default textures are engine descriptors that live as long as the heap
+    std::unordered_map<size_t, uint32_t> s_DefaultTextureIndices;
+    std::mutex s_BindlessMutex;
+
+    // Ranges of s_TextureHeap given back by unloaded models.  Each waits for the GPU to finish with it,
+    // then is reused by the next request of the same size.
+    struct RetiredDescriptors
+    {
+        uint64_t fenceValue;
+        uint32_t offset;
+        uint32_t count;
+    };
+    std::queue<RetiredDescriptors> s_RetiredTextureDescriptors;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> s_FreeTextureDescriptors;
+    std::mutex s_TextureDescriptorMutex;
+
+    // Where each texture's SRV has been copied in s_TextureHeap, keyed by the source descriptor, and
+    // the copies waiting to be redone because a load or streaming update rewrote the source, as
+    // (dest, source)
+    std::unordered_multimap<size_t, D3D12_CPU_DESCRIPTOR_HANDLE> s_TextureCopies;
+    std::vector<std::pair<D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE>> s_PendingTextureRefreshes;
+    std::mutex s_TextureRefreshMutex;
+
+    // Every combination of PSOFlags maps directly to its index in sm_PSOs
+    static const uint32_t kNumPSOFlagCombinations = PSOFlags::kHasSkin << 1;
+    static const uint16_t kInvalidPSOIndex = 0xFFFF;
+
+    // Limited by the width of MeshSorter::SortKey::psoIdx
+    static const size_t kMaxPSOs = 4096;
+
+    uint16_t s_PSOIndexByFlags[kNumPSOFlagCombinations];
+    std::unordered_map<const PSO::SharedPipeline*, uint16_t> s_PSOIndexByPipeline;
+    std::mutex s_PSOMutex;
+
+    // Flags that change blending, depth writes, culling or the depth pass.  Meshes with any of them can't
+    // be drawn with another PSO while theirs compiles.
+    static const uint16_t kRenderStateFlags = PSOFlags::kAlphaBlend | PSOFlags::kAlphaTest | PSOFlags::kTwoSided;
+    std::atomic<uint32_t> s_SkippedDraws(0);
+}
+
+static void OnTextureUpdated(D3D12_CPU_DESCRIPTOR_HANDLE srv)
+{
+    std::lock_guard<std::mutex> LockGuard(s_TextureRefreshMutex);
+    auto range = s_TextureCopies.equal_range(srv.ptr);
+    for (auto iter = range.first; iter != range.second; ++iter)
+        s_PendingTextureRefreshes.push_back(std::make_pair(iter->second, srv));
 }
 
 void Renderer::Initialize(void)
@@ -83,7 +165,12 @@ void Renderer::Initialize(void)
     SamplerDesc CubeMapSamplerDesc = DefaultSamplerDesc;
     //CubeMapSamplerDesc.MaxLOD = 6.0f;
 
-    m_RootSig.Reset(kNumRootBindings, 3);
+    // Bindless tables span the whole texture heap, which tier 1 hardware can't address from one table
+    uint32_t useBindless = 1;
+    CommandLineArgs::GetInteger(L"bindless", useBindless);
+    s_BindlessTextures = useBindless != 0 && g_ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_2;
+
+    m_RootSig.Reset(s_BindlessTextures ? kNumRootBindings : kBindlessSRVs, 3);
     m_RootSig.InitStaticSampler(10, DefaultSamplerDesc, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig.InitStaticSampler(11, SamplerShadowDesc, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig.InitStaticSampler(12, CubeMapSamplerDesc, D3D12_SHADER_VISIBILITY_PIXEL);
@@ -94,6 +181,11 @@ void Renderer::Initialize(void)
     m_RootSig[kCommonSRVs].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 10, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig[kCommonCBV].InitAsConstantBuffer(1);
     m_RootSig[kSkinMatrices].InitAsBufferSRV(20, D3D12_SHADER_VISIBILITY_VERTEX);
+    if (s_BindlessTextures)
+    {
+        m_RootSig[kBindlessSRVs].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, UINT_MAX, D3D12_SHADER_VISIBILITY_PIXEL, 1);
+        m_RootSig[kBindlessSamplers].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 0, UINT_MAX, D3D12_SHADER_VISIBILITY_PIXEL, 1);
+    }
     m_RootSig.Finalize(L"RootSig", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     DXGI_FORMAT ColorFormat = g_SceneColorBuffer.GetFormat();
@@ -127,6 +219,11 @@ void Renderer::Initialize(void)
 
     ASSERT(sm_PSOs.size() == 0);
 
+    std::fill_n(s_PSOIndexByFlags, kNumPSOFlagCombinations, kInvalidPSOIndex);
+
+    // Never reallocate, so that PSOs can be added while other threads draw with existing ones
+    sm_PSOs.reserve(kMaxPSOs);
+
     // Depth Only PSOs
 
     GraphicsPSO DepthOnlyPSO(L"Renderer: Depth Only PSO");
@@ -146,7 +243,10 @@ void Renderer::Initialize(void)
     CutoutDepthPSO.SetInputLayout(_countof(posAndUV), posAndUV);
     CutoutDepthPSO.SetRasterizerState(RasterizerTwoSided);
     CutoutDepthPSO.SetVertexShader(g_pCutoutDepthVS, sizeof(g_pCutoutDepthVS));
-    CutoutDepthPSO.SetPixelShader(g_pCutoutDepthPS, sizeof(g_pCutoutDepthPS));
+    if (s_BindlessTextures)
+        CutoutDepthPSO.SetPixelShader(g_pCutoutDepthBindlessPS, sizeof(g_pCutoutDepthBindlessPS));
+    else
+        CutoutDepthPSO.SetPixelShader(g_pCutoutDepthPS, sizeof(g_pCutoutDepthPS));
     CutoutDepthPSO.Finalize();
     sm_PSOs.push_back(CutoutDepthPSO);
 
@@ -216,6 +316,19 @@ void Renderer::Initialize(void)
     // Maybe only need 2 for wrap vs. clamp?  Currently we allocate 1 for 1 with textures
     s_SamplerHeap.Create(L"Scene Sampler Descriptors", D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 2048);
 
+    if (s_BindlessTextures)
+    {
+        m_BindlessSamplers = s_SamplerHeap.Alloc(kNumSamplerPermutations);
+        for (uint32_t i = 0; i < kNumSamplerPermutations; ++i)
+        {
+            SamplerDesc samplerDesc;
+            samplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE(i & 0x3);
+            samplerDesc.AddressV = D3D12_TEXTURE_ADDRESS_MODE(i >> 2);
+            DescriptorHandle dest = m_BindlessSamplers + i * s_SamplerHeap.GetDescriptorSize();
+            g_Device->CopyDescriptorsSimple(1, dest, samplerDesc.CreateDescriptor(), D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
+        }
+    }
+
     Lighting::InitializeResources();
 
     // Allocate a descriptor table for the common textures
@@ -241,11 +354,83 @@ void Renderer::Initialize(void)
     g_SSAOFullScreenID = g_SSAOFullScreen.GetVersionID();
     g_ShadowBufferID = g_ShadowBuffer.GetVersionID();
 
+    TextureManager::SetUpdateListener(OnTextureUpdated);
+
     s_Initialized = true;
 }
 
+void Renderer::TrackTextureCopy(const TextureRef& texture, D3D12_CPU_DESCRIPTOR_HANDLE dest)
+{
+    std::lock_guard<std::mutex> LockGuard(s_TextureRefreshMutex);
+    s_TextureCopies.insert(std::make_pair(texture.GetSRV().ptr, dest));
+}
+
+DescriptorHandle Renderer::AllocTextureDescriptors(uint32_t count)
+{
+    std::lock_guard<std::mutex> LockGuard(s_TextureDescriptorMutex);
+
+    while (!s_RetiredTextureDescriptors.empty() &&
+        g_CommandManager.IsFenceComplete(s_RetiredTextureDescriptors.front().fenceValue))
+    {
+        const RetiredDescriptors& retired = s_RetiredTextureDescriptors.front();
+        s_FreeTextureDescriptors[retired.count].push_back(retired.offset);
+        s_RetiredTextureDescriptors.pop();
+    }
+
+    auto iter = s_FreeTextureDescriptors.find(count);
+    if (iter != s_FreeTextureDescriptors.end() && !iter->second.empty())
+    {
+        const uint32_t offset = iter->second.back();
+        iter->second.pop_back();
+        return s_TextureHeap[offset];
+    }
+
+    return s_TextureHeap.Alloc(count);
+}
+
+void Renderer::FreeTextureDescriptors(DescriptorHandle first, uint32_t count)
+{
+    // Models may outlive the renderer
+    if (s_TextureHeap.GetHeapPointer() == nullptr || first.IsNull() || count == 0)
+        return;
+
+    // Stop refreshing copies into the range before it can be handed to someone else
+    {
+        const size_t begin = first.GetCpuPtr();
+        const size_t end = begin + count * s_TextureHeap.GetDescriptorSize();
+
+        std::lock_guard<std::mutex> LockGuard(s_TextureRefreshMutex);
+        for (auto iter = s_TextureCopies.begin(); iter != s_TextureCopies.end(); )
+        {
+            if (iter->second.ptr >= begin && iter->second.ptr < end)
+                iter = s_TextureCopies.erase(iter);
+            else
+                ++iter;
+        }
+    }
+
+    // Command lists still being recorded or executed may refer to the descriptors
+    RetiredDescriptors retired;
+    retired.fenceValue = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    retired.offset = s_TextureHeap.GetOffsetOfHandle(first);
+    retired.count = count;
+
+    std::lock_guard<std::mutex> LockGuard(s_TextureDescriptorMutex);
+    s_RetiredTextureDescriptors.push(retired);
+}
+
 void Renderer::UpdateGlobalDescriptors(void)
 {
+    // Applied here, on the rendering thread between passes, rather than from the loading and
+    // streaming threads
+    std::vector<std::pair<D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE>> refreshes;
+    {
+        std::lock_guard<std::mutex> LockGuard(s_TextureRefreshMutex);
+        refreshes.swap(s_PendingTextureRefreshes);
+    }
+    for (auto& refresh : refreshes)
+        g_Device->CopyDescriptorsSimple(1, refresh.first, refresh.second, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
     if (g_SSAOFullScreenID == g_SSAOFullScreen.GetVersionID() &&
         g_ShadowBufferID == g_ShadowBuffer.GetVersionID())
     {
@@ -272,6 +457,9 @@ void Renderer::UpdateGlobalDescriptors(void)
 
 void Renderer::SetIBLTextures(TextureRef diffuseIBL, TextureRef specularIBL)
 {
+    diffuseIBL.WaitForLoad();
+    specularIBL.WaitForLoad();
+
     s_RadianceCubeMap = specularIBL;
     s_IrradianceCubeMap = diffuseIBL;
 
@@ -305,12 +493,18 @@ void Renderer::Shutdown(void)
 {
     s_RadianceCubeMap = nullptr;
     s_IrradianceCubeMap = nullptr;
+    s_BindlessTextureSlots.clear();
+    s_DefaultTextureIndices.clear();
     TextureManager::Shutdown();
+    s_PendingTextureRefreshes.clear();
+    s_TextureCopies.clear();
+    s_RetiredTextureDescriptors = std::queue<RetiredDescriptors>();
+    s_FreeTextureDescriptors.clear();
     s_TextureHeap.Destroy();
     s_SamplerHeap.Destroy();
 }
 
-uint8_t Renderer::GetPSO(uint16_t psoFlags)
+static GraphicsPSO BuildColorPSO(uint16_t psoFlags)
 {
     using namespace PSOFlags;
 
@@ -319,26 +513,28 @@ uint8_t Renderer::GetPSO(uint16_t psoFlags)
     uint16_t Requirements = kHasPosition | kHasNormal;
     ASSERT((psoFlags & Requirements) == Requirements);
 
-    std::vector<D3D12_INPUT_ELEMENT_DESC> vertexLayout;
+    // At most seven elements; SetInputLayout copies them
+    D3D12_INPUT_ELEMENT_DESC vertexLayout[8];
+    uint32_t numElements = 0;
     if (psoFlags & kHasPosition)
-        vertexLayout.push_back({"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT};
     if (psoFlags & kHasNormal)
-        vertexLayout.push_back({"NORMAL",   0, DXGI_FORMAT_R10G10B10A2_UNORM,  0, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"NORMAL",   0, DXGI_FORMAT_R10G10B10A2_UNORM,  0, D3D12_APPEND_ALIGNED_ELEMENT};
     if (psoFlags & kHasTangent)
-        vertexLayout.push_back({"TANGENT",  0, DXGI_FORMAT_R10G10B10A2_UNORM,  0, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"TANGENT",  0, DXGI_FORMAT_R10G10B10A2_UNORM,  0, D3D12_APPEND_ALIGNED_ELEMENT};
     if (psoFlags & kHasUV0)
-        vertexLayout.push_back({"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT};
     else
-        vertexLayout.push_back({"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       1, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       1, D3D12_APPEND_ALIGNED_ELEMENT};
     if (psoFlags & kHasUV1)
-        vertexLayout.push_back({"TEXCOORD", 1, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT});
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{"TEXCOORD", 1, DXGI_FORMAT_R16G16_FLOAT,       0, D3D12_APPEND_ALIGNED_ELEMENT};
     if (psoFlags & kHasSkin)
     {
-        vertexLayout.push_back({ "BLENDINDICES", 0, DXGI_FORMAT_R16G16B16A16_UINT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
-        vertexLayout.push_back({ "BLENDWEIGHT", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{ "BLENDINDICES", 0, DXGI_FORMAT_R16G16B16A16_UINT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+        vertexLayout[numElements++] = D3D12_INPUT_ELEMENT_DESC{ "BLENDWEIGHT", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
     }
 
-    ColorPSO.SetInputLayout((uint32_t)vertexLayout.size(), vertexLayout.data());
+    ColorPSO.SetInputLayout(numElements, vertexLayout);
 
     if (psoFlags & kHasSkin)
     {
@@ -399,6 +595,25 @@ uint8_t Renderer::GetPSO(uint16_t psoFlags)
         }
     }
 
+    // Same vertex shaders, but materials read their textures by index
+    if (s_BindlessTextures)
+    {
+        if (psoFlags & kHasTangent)
+        {
+            if (psoFlags & kHasUV1)
+                ColorPSO.SetPixelShader(g_pDefaultBindlessPS, sizeof(g_pDefaultBindlessPS));
+            else
+                ColorPSO.SetPixelShader(g_pDefaultNoUV1BindlessPS, sizeof(g_pDefaultNoUV1BindlessPS));
+        }
+        else
+        {
+            if (psoFlags & kHasUV1)
+                ColorPSO.SetPixelShader(g_pDefaultNoTangentBindlessPS, sizeof(g_pDefaultNoTangentBindlessPS));
+            else
+                ColorPSO.SetPixelShader(g_pDefaultNoTangentNoUV1BindlessPS, sizeof(g_pDefaultNoTangentNoUV1BindlessPS));
+        }
+    }
+
     if (psoFlags & kAlphaBlend)
     {
         ColorPSO.SetBlendState(BlendPreMultiplied);
@@ -408,32 +623,155 @@ uint8_t Renderer::GetPSO(uint16_t psoFlags)
     {
         ColorPSO.SetRasterizerState(RasterizerTwoSided);
     }
-    ColorPSO.Finalize();
 
-    // Look for an existing PSO
-    for (uint32_t i = 0; i < sm_PSOs.size(); ++i)
+    return ColorPSO;
+}
+
+bool Renderer::UsingBindlessTextures(void)
+{
+    return s_BindlessTextures;
+}
+
+uint32_t Renderer::GetBindlessTextureIndex(const TextureRef& texture)
+{
+    ASSERT(s_BindlessTextures);
+
+    // A reference to nothing shows the fallback, which is placed like the other defaults
+    if (texture.Get() == nullptr)
+        return GetBindlessTextureIndex(texture.GetSRV());
+
+    std::lock_guard<std::mutex> LockGuard(s_BindlessMutex);
+
+    auto iter = s_BindlessTextureSlots.find(texture.Get());
+    if (iter != s_BindlessTextureSlots.end())
     {
-        if (ColorPSO.GetPipelineStateObject() == sm_PSOs[i].GetPipelineStateObject())
-        {
-            return (uint8_t)i;
-        }
+        ++iter->second.useCount;
+        return iter->second.index;
     }
 
-    // If not found, keep the new one, and return its index
-    sm_PSOs.push_back(ColorPSO);
+    DescriptorHandle dest = AllocTextureDescriptors(1);
+    TrackTextureCopy(texture, dest);
+    g_Device->CopyDescriptorsSimple(1, dest, texture.GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    BindlessTexture slot = { s_TextureHeap.GetOffsetOfHandle(dest), 1, texture };
+    s_BindlessTextureSlots.insert(std::make_pair(texture.Get(), slot));
+
+    return slot.index;
+}
+
+uint32_t Renderer::GetBindlessTextureIndex(D3D12_CPU_DESCRIPTOR_HANDLE defaultSRV)
+{
+    ASSERT(s_BindlessTextures);
+
+    std::lock_guard<std::mutex> LockGuard(s_BindlessMutex);
+
+    auto iter = s_DefaultTextureIndices.find(defaultSRV.ptr);
+    if (iter != s_DefaultTextureIndices.end())
+        return iter->second;
+
+    DescriptorHandle dest = AllocTextureDescriptors(1);
+    g_Device->CopyDescriptorsSimple(1, dest, defaultSRV, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    uint32_t index = s_TextureHeap.GetOffsetOfHandle(dest);
+    s_DefaultTextureIndices[defaultSRV.ptr] = index;
+    return index;
+}
+
+void Renderer::ReleaseBindlessTextureIndex(const TextureRef& texture)
+{
+    if (texture.Get() == nullptr)
+        return;
+
+    // Dropped outside the lock, since the last reference may unload the texture
+    TextureRef released;
+    {
+        std::lock_guard<std::mutex> LockGuard(s_BindlessMutex);
+
+        auto iter = s_BindlessTextureSlots.find(texture.Get());
+        if (iter == s_BindlessTextureSlots.end())
+            return;
+
+        if (--iter->second.useCount > 0)
+            return;
+
+        FreeTextureDescriptors(s_TextureHeap[iter->second.index], 1);
+        released = iter->second.texture;
+        s_BindlessTextureSlots.erase(iter);
+    }
+}
+
+static uint16_t FindOrCreatePSO(uint16_t psoFlags, bool compileAsync)
+{
+    {
+        std::lock_guard<std::mutex> LockGuard(s_PSOMutex);
+        if (s_PSOIndexByFlags[psoFlags] != kInvalidPSOIndex)
+            return s_PSOIndexByFlags[psoFlags];
+    }
 
     // The returned PSO index has read-write depth.  The index+1 tests for equal depth.
-    ColorPSO.SetDepthStencilState(DepthStateTestEqual);
-    ColorPSO.Finalize();
-#ifdef DEBUG
-    for (uint32_t i = 0; i < sm_PSOs.size(); ++i)
-        ASSERT(ColorPSO.GetPipelineStateObject() != sm_PSOs[i].GetPipelineStateObject());
-#endif
+    GraphicsPSO ColorPSO = BuildColorPSO(psoFlags);
+    GraphicsPSO EqualDepthPSO = ColorPSO;
+    EqualDepthPSO.SetDepthStencilState(DepthStateTestEqual);
+
+    // Compile outside of the lock so that other permutations can compile concurrently
+    if (compileAsync)
+    {
+        ColorPSO.FinalizeAsync();
+        EqualDepthPSO.FinalizeAsync();
+    }
+    else
+    {
+        ColorPSO.Finalize();
+        EqualDepthPSO.Finalize();
+    }
+
+    std::lock_guard<std::mutex> LockGuard(s_PSOMutex);
+
+    // Another thread may have registered these flags while we were compiling
+    if (s_PSOIndexByFlags[psoFlags] != kInvalidPSOIndex)
+        return s_PSOIndexByFlags[psoFlags];
+
+    // Different flags can resolve to the same pipeline, e.g. alpha test only affects depth PSOs
+    auto iter = s_PSOIndexByPipeline.find(ColorPSO.GetSharedPipeline());
+    if (iter != s_PSOIndexByPipeline.end())
+    {
+        s_PSOIndexByFlags[psoFlags] = iter->second;
+        return iter->second;
+    }
+
+    ASSERT(sm_PSOs.size() + 2 <= kMaxPSOs, "Ran out of room for unique PSOs");
+    ASSERT(s_PSOIndexByPipeline.find(EqualDepthPSO.GetSharedPipeline()) == s_PSOIndexByPipeline.end());
+
+    const uint16_t index = (uint16_t)sm_PSOs.size();
     sm_PSOs.push_back(ColorPSO);
+    sm_PSOs.push_back(EqualDepthPSO);
+    s_PSOIndexByPipeline[ColorPSO.GetSharedPipeline()] = index;
+    s_PSOIndexByFlags[psoFlags] = index;
 
-    ASSERT(sm_PSOs.size() <= 256, "Ran out of room for unique PSOs");
+    return index;
+}
 
-    return (uint8_t)sm_PSOs.size() - 2;
+uint16_t Renderer::GetPSO(uint16_t psoFlags)
+{
+    ASSERT(psoFlags < kNumPSOFlagCombinations, "Unrecognized PSO flags");
+
+    if (!AsyncPSOCompilation)
+        return FindOrCreatePSO(psoFlags, false);
+
+    // The plain PSO of each vertex layout is compiled right away, so that opaque meshes always draw.  Any
+    // stand-in for the others would blend, write depth or cull differently, so those compile in the
+    // background and their draws are skipped until they are ready.
+    return FindOrCreatePSO(psoFlags, (psoFlags & kRenderStateFlags) != 0);
+}
+
+void Renderer::PrecompilePSOs(const uint16_t* psoFlags, uint32_t count)
+{
+    concurrency::parallel_for(0u, count, [psoFlags](uint32_t i) { GetPSO(psoFlags[i]); });
+}
+
+uint32_t Renderer::GetSkippedPSODrawCount(void)
+{
+    return s_SkippedDraws.exchange(0);
 }
 
 void Renderer::DrawSkybox( GraphicsContext& gfxContext, const Camera& Camera, const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissor )
@@ -538,15 +876,18 @@ void MeshSorter::Sort()
     std::sort(m_SortKeys.begin(), m_SortKeys.end(), Cmp);
 }
 
-void MeshSorter::RenderMeshes(
-    DrawPass pass,
-    GraphicsContext& context,
-    GlobalConstants& globals)
+MeshSorter::PassTargets MeshSorter::GetPassTargets(BatchType type, DrawPass pass, bool separateZPass)
 {
-	ASSERT(m_DSV != nullptr);
+    static_assert(kZPass == 0 && kOpaque == 1 && kTransparent == 2, "SelectPassBindings() numbers passes in this order");
 
-    Renderer::UpdateGlobalDescriptors();
+    const PassBindings bindings = SelectPassBindings(type == kShadows, pass, separateZPass);
+    PassTargets targets = { bindings.bindColor, bindings.depthReadOnly,
+        bindings.depthReadOnly ? D3D12_RESOURCE_STATE_DEPTH_READ : D3D12_RESOURCE_STATE_DEPTH_WRITE };
+    return targets;
+}
 
+void MeshSorter::BindCommonState(GraphicsContext& context, const GlobalConstants& globals) const
+{
     context.SetRootSignature(m_RootSig);
     context.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     context.SetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, s_TextureHeap.GetHeapPointer());
@@ -555,12 +896,49 @@ void MeshSorter::RenderMeshes(
     // Set common textures
     context.SetDescriptorTable(kCommonSRVs, m_CommonTextures);
 
+    // Material textures are reached through these for the whole pass
+    if (s_BindlessTextures)
+    {
+        context.SetDescriptorTable(kBindlessSRVs, s_TextureHeap[0]);
+        context.SetDescriptorTable(kBindlessSamplers, m_BindlessSamplers);
+    }
+
     // Set common shader constants
+    context.SetDynamicConstantBufferView(kCommonCBV, sizeof(GlobalConstants), &globals);
+}
+
+void MeshSorter::BindPassTargets(GraphicsContext& context, const PassTargets& targets, bool transition) const
+{
+    if (transition)
+    {
+        context.TransitionResource(*m_DSV, targets.depthState);
+        if (targets.bindColor)
+            context.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE DSV = targets.depthReadOnly ? m_DSV->GetDSV_DepthReadOnly() : m_DSV->GetDSV();
+
+    if (targets.bindColor)
+        context.SetRenderTarget(g_SceneColorBuffer.GetRTV(), DSV);
+    else
+        context.SetDepthStencilTarget(DSV);
+}
+
+void MeshSorter::RenderMeshes(
+    DrawPass pass,
+    GraphicsContext& context,
+    GlobalConstants& globals)
+{
+	ASSERT(m_DSV != nullptr);
+
+    Renderer::UpdateGlobalDescriptors();
+
 	globals.ViewProjMatrix = m_Camera->GetViewProjMatrix();
 	globals.CameraPos = m_Camera->GetPosition();
     globals.IBLRange = s_SpecularIBLRange - s_SpecularIBLBias;
     globals.IBLBias = s_SpecularIBLBias;
-	context.SetDynamicConstantBufferView(kCommonCBV, sizeof(GlobalConstants), &globals);
+
+    BindCommonState(context, globals);
 
 	if (m_BatchType == kShadows)
 	{
@@ -614,83 +992,111 @@ void MeshSorter::RenderMeshes(
         if (passCount == 0)
             continue;
 
+        const PassTargets targets = GetPassTargets(m_BatchType, m_CurrentPass, SeparateZPass);
+
+        // Shadow batches bound their only target above
 		if (m_BatchType == kDefault)
-		{
-			switch (m_CurrentPass)
-			{
-			case kZPass:
-				context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-				context.SetDepthStencilTarget(m_DSV->GetDSV());
-				break;
-			case kOpaque:
-				if (SeparateZPass)
-				{
-					context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_READ);
-					context.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
-					context.SetRenderTarget(g_SceneColorBuffer.GetRTV(), m_DSV->GetDSV_DepthReadOnly());
-				}
-				else
-				{
-					context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-					context.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
-					context.SetRenderTarget(g_SceneColorBuffer.GetRTV(), m_DSV->GetDSV());
-				}
-				break;
-			case kTransparent:
-				context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_READ);
-				context.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
-				context.SetRenderTarget(g_SceneColorBuffer.GetRTV(), m_DSV->GetDSV_DepthReadOnly());
-				break;
-			}
-		}
+            BindPassTargets(context, targets, true);
 
         context.SetViewportAndScissor(m_Viewport, m_Scissor);
         context.FlushResourceBarriers();
 
         const uint32_t lastDraw = m_CurrentDraw + passCount;
 
-        while (m_CurrentDraw < lastDraw)
+        if (ParallelRecording && passCount >= 2 * (uint32_t)MinDrawsPerChunk)
+            RecordDrawsParallel(context, globals, m_CurrentPass, targets, m_CurrentDraw, lastDraw);
+        else
+            RecordDraws(context, m_CurrentPass, m_CurrentDraw, lastDraw);
+
+        m_CurrentDraw = lastDraw;
+    }
+
+	if (m_BatchType == kShadows)
+	{
+		context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	}
+}
+
+void MeshSorter::RecordDraws(GraphicsContext& context, DrawPass pass, uint32_t firstDraw, uint32_t lastDraw) const
+{
+    for (uint32_t drawIdx = firstDraw; drawIdx < lastDraw; ++drawIdx)
+    {
+        SortKey key;
+        key.value = m_SortKeys[drawIdx];
+        const SortObject& object = m_SortObjects[key.objectIdx];
+        const Mesh& mesh = *object.mesh;
+
+        uint32_t psoIdx = key.psoIdx;
+        if (!sm_PSOs[psoIdx].IsReady())
         {
-            SortKey key;
-            key.value = m_SortKeys[m_CurrentDraw];
-            const SortObject& object = m_SortObjects[key.objectIdx];
-            const Mesh& mesh = *object.mesh;
+            ++s_SkippedDraws;
+            continue;
+        }
 
-            context.SetConstantBuffer(kMeshConstants, object.meshCBV);
-            context.SetConstantBuffer(kMaterialConstants, object.materialCBV);
+        context.SetConstantBuffer(kMeshConstants, object.meshCBV);
+        context.SetConstantBuffer(kMaterialConstants, object.materialCBV);
+        if (!s_BindlessTextures)
+        {
             context.SetDescriptorTable(kMaterialSRVs, s_TextureHeap[mesh.srvTable]);
             context.SetDescriptorTable(kMaterialSamplers, s_SamplerHeap[mesh.samplerTable]);
+        }
+        if (mesh.numJoints > 0)
+        {
+            ASSERT(object.skeleton != nullptr, "Unspecified joint matrix array");
+            context.SetDynamicSRV(kSkinMatrices, sizeof(Joint) * mesh.numJoints, object.skeleton + mesh.startJoint);
+        }
+        context.SetPipelineState(sm_PSOs[psoIdx]);
+
+        if (pass == kZPass)
+        {
+            bool alphaTest = (mesh.psoFlags & PSOFlags::kAlphaTest) == PSOFlags::kAlphaTest;
+            uint32_t stride = alphaTest ? 16u : 12u;
             if (mesh.numJoints > 0)
-            {
-                ASSERT(object.skeleton != nullptr, "Unspecified joint matrix array");
-                context.SetDynamicSRV(kSkinMatrices, sizeof(Joint) * mesh.numJoints, object.skeleton + mesh.startJoint);
-            }
-            context.SetPipelineState(sm_PSOs[key.psoIdx]);
+                stride += 16;
+            context.SetVertexBuffer(0, {object.bufferPtr + mesh.vbDepthOffset, mesh.vbDepthSize, stride});
+        }
+        else
+        {
+            context.SetVertexBuffer(0, {object.bufferPtr + mesh.vbOffset, mesh.vbSize, mesh.vbStride});
+        }
 
-            if (m_CurrentPass == kZPass)
-            {
-                bool alphaTest = (mesh.psoFlags & PSOFlags::kAlphaTest) == PSOFlags::kAlphaTest;
-                uint32_t stride = alphaTest ? 16u : 12u;
-                if (mesh.numJoints > 0)
-                    stride += 16;
-                context.SetVertexBuffer(0, {object.bufferPtr + mesh.vbDepthOffset, mesh.vbDepthSize, stride});
-            }
-            else
-            {
-                context.SetVertexBuffer(0, {object.bufferPtr + mesh.vbOffset, mesh.vbSize, mesh.vbStride});
-            }
+        context.SetIndexBuffer({object.bufferPtr + mesh.ibOffset, mesh.ibSize, (DXGI_FORMAT)mesh.ibFormat});
 
-            context.SetIndexBuffer({object.bufferPtr + mesh.ibOffset, mesh.ibSize, (DXGI_FORMAT)mesh.ibFormat});
+        for (uint32_t i = 0; i < mesh.numDraws; ++i)
+            context.DrawIndexed(mesh.draw[i].primCount, mesh.draw[i].startIndex, mesh.draw[i].baseVertex);
+    }
+}
 
-            for (uint32_t i = 0; i < mesh.numDraws; ++i)
-                context.DrawIndexed(mesh.draw[i].primCount, mesh.draw[i].startIndex, mesh.draw[i].baseVertex);
+void MeshSorter::RecordDrawsParallel(GraphicsContext& context, const GlobalConstants& globals,
+    DrawPass pass, const PassTargets& targets, uint32_t firstDraw, uint32_t lastDraw) const
+{
+    DrawChunk chunks[kMaxDrawChunks];
+    const uint32_t numChunks = PartitionDraws(firstDraw, lastDraw - firstDraw, kMaxDrawChunks, MinDrawsPerChunk, chunks);
 
-            ++m_CurrentDraw;
-        }
-    }
+    // Submit everything recorded so far, including this pass's barriers, so that it executes
+    // ahead of the chunks.  Resource states are already final, so chunks don't transition.
+    context.Flush();
 
-	if (m_BatchType == kShadows)
-	{
-		context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-	}
+    GraphicsContext* chunkContexts[kMaxDrawChunks];
+    for (uint32_t i = 0; i < numChunks; ++i)
+        chunkContexts[i] = &GraphicsContext::Begin();
+
+    concurrency::parallel_for(0u, numChunks, [&](uint32_t i)
+    {
+        GraphicsContext& chunkContext = *chunkContexts[i];
+        BindCommonState(chunkContext, globals);
+        BindPassTargets(chunkContext, targets, false);
+        chunkContext.SetViewportAndScissor(m_Viewport, m_Scissor);
+        RecordDraws(chunkContext, pass, chunks[i].firstDraw, chunks[i].firstDraw + chunks[i].numDraws);
+    });
+
+    // Submit in sort order
+    for (uint32_t i = 0; i < numChunks; ++i)
+        chunkContexts[i]->Finish();
+
+    // Flushing kept the root signature and heaps but reset the root arguments, topology and targets.
+    // Restore them so that later passes, and the caller, see the same state as after serial recording.
+    BindCommonState(context, globals);
+    BindPassTargets(context, targets, false);
+    context.SetViewportAndScissor(m_Viewport, m_Scissor);
 }
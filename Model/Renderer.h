@@ -19,6 +19,7 @@
 #include "../Core/CommandContext.h"
 #include "../Core/UploadBuffer.h"
 #include "../Core/TextureManager.h"
+#include "../Core/FrameArena.h"
 #include <cstdint>
 #include <vector>
 
@@ -36,6 +37,8 @@ struct Joint;
 namespace Renderer
 {
     extern BoolVar SeparateZPass;
+    extern BoolVar ParallelRecording;
+    extern BoolVar AsyncPSOCompilation;
 
     using namespace Math;
 
@@ -54,6 +57,8 @@ namespace Renderer
         kCommonSRVs,
         kCommonCBV,
         kSkinMatrices,
+        kBindlessSRVs,      // Only present with bindless textures
+        kBindlessSamplers,
 
         kNumRootBindings
     };
@@ -61,7 +66,36 @@ namespace Renderer
     void Initialize(void);
     void Shutdown(void);
 
-    uint8_t GetPSO(uint16_t psoFlags);
+    // Materials index s_TextureHeap through one table instead of binding a copied table per draw.
+    // Decided once in Initialize().  Requires resource binding tier 2; disable with -bindless 0.
+    bool UsingBindlessTextures(void);
+
+    // Place a texture's SRV in s_TextureHeap the first time it is seen and return its offset in
+    // the heap.  Later requests for the same texture return the same offset.  Every request for a
+    // texture is a use that must be given back with ReleaseBindlessTextureIndex(); the slot and the
+    // texture are released with the last one.  Default textures stay placed.
+    uint32_t GetBindlessTextureIndex(const TextureRef& texture);
+    uint32_t GetBindlessTextureIndex(D3D12_CPU_DESCRIPTOR_HANDLE defaultSRV);
+    void ReleaseBindlessTextureIndex(const TextureRef& texture);
+
+    // Ranges of s_TextureHeap that are given back when a model unloads.  Freeing stops tracked copies
+    // into the range, and the range is reused once the GPU has finished with it.
+    DescriptorHandle AllocTextureDescriptors(uint32_t count);
+    void FreeTextureDescriptors(DescriptorHandle first, uint32_t count);
+
+    // Keep dest in s_TextureHeap in sync with the texture's SRV, which changes when a background load
+    // finishes or streaming changes its mips.  Call before copying the current SRV there.
+    void TrackTextureCopy(const TextureRef& texture, D3D12_CPU_DESCRIPTOR_HANDLE dest);
+
+    // With AsyncPSOCompilation, PSOs for blended, alpha-tested or two-sided meshes compile in the background
+    // and their draws are skipped until they are ready.  Other PSOs are compiled before GetPSO() returns.
+    uint16_t GetPSO(uint16_t psoFlags);
+
+    // Compile the pipelines for a set of PSO flags in parallel so that later GetPSO() calls are lookups
+    void PrecompilePSOs(const uint16_t* psoFlags, uint32_t count);
+
+    // Draws recorded since the last call that were skipped because their PSO was still compiling
+    uint32_t GetSkippedPSODrawCount(void);
     void SetIBLTextures(TextureRef diffuseIBL, TextureRef specularIBL);
     void SetIBLBias(float LODBias);
     void UpdateGlobalDescriptors(void);
@@ -102,6 +136,15 @@ namespace Renderer
         const Frustum& GetViewFrustum() const { return m_Camera->GetViewSpaceFrustum(); }
         const Matrix4& GetViewMatrix() const { return m_Camera->GetViewMatrix(); }
 
+        // Converts a view-space size to pixels at unit depth, for texture streaming.  Zero for
+        // shadow batches, which shouldn't drive texture detail.
+        float GetProjectedScale() const
+        {
+            if (m_BatchType != kDefault || m_Viewport.Height == 0.0f)
+                return 0.0f;
+            return float(m_Camera->GetProjMatrix().GetY().GetY()) * m_Viewport.Height * 0.5f;
+        }
+
         void AddMesh( const Mesh& mesh, float distance,
             D3D12_GPU_VIRTUAL_ADDRESS meshCBV,
             D3D12_GPU_VIRTUAL_ADDRESS materialCBV,
@@ -112,8 +155,25 @@ namespace Renderer
 
         void RenderMeshes(DrawPass pass, GraphicsContext& context, GlobalConstants& globals);
 
+        // Render target bindings and depth state for a pass.  Each command list a pass is
+        // recorded into must bind the same targets.
+        struct PassTargets
+        {
+            bool bindColor;
+            bool depthReadOnly;
+            D3D12_RESOURCE_STATES depthState;
+        };
+
+        static PassTargets GetPassTargets(BatchType type, DrawPass pass, bool separateZPass);
+
     private:
 
+        void BindCommonState(GraphicsContext& context, const GlobalConstants& globals) const;
+        void BindPassTargets(GraphicsContext& context, const PassTargets& targets, bool transition) const;
+        void RecordDraws(GraphicsContext& context, DrawPass pass, uint32_t firstDraw, uint32_t lastDraw) const;
+        void RecordDrawsParallel(GraphicsContext& context, const GlobalConstants& globals,
+            DrawPass pass, const PassTargets& targets, uint32_t firstDraw, uint32_t lastDraw) const;
+
         struct SortKey
         {
             union
@@ -138,8 +198,9 @@ namespace Renderer
             D3D12_GPU_VIRTUAL_ADDRESS bufferPtr;
         };
 
-        std::vector<SortObject> m_SortObjects;
-        std::vector<uint64_t> m_SortKeys;
+        // Sorters are rebuilt every frame, so their lists live in the frame arena
+        FrameVector<SortObject> m_SortObjects;
+        FrameVector<uint64_t> m_SortKeys;
 		BatchType m_BatchType;
         uint32_t m_PassCounts[kNumPasses];
         DrawPass m_CurrentPass;
@@ -19,7 +19,7 @@
 // single-iteration loop
 #pragma warning (disable: 3557)
 
-#define Renderer_RootSig \
+#define Renderer_RootParams \
     "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT), " \
     "CBV(b0, visibility = SHADER_VISIBILITY_VERTEX), " \
     "CBV(b0, visibility = SHADER_VISIBILITY_PIXEL), " \
@@ -27,7 +27,14 @@
     "DescriptorTable(Sampler(s0, numDescriptors = 10), visibility = SHADER_VISIBILITY_PIXEL)," \
     "DescriptorTable(SRV(t10, numDescriptors = 10), visibility = SHADER_VISIBILITY_PIXEL)," \
     "CBV(b1), " \
-    "SRV(t20, visibility = SHADER_VISIBILITY_VERTEX), " \
+    "SRV(t20, visibility = SHADER_VISIBILITY_VERTEX), "
+
+// The whole scene texture heap and the sampler permutations, indexed by material constants
+#define Renderer_BindlessParams \
+    "DescriptorTable(SRV(t0, space = 1, numDescriptors = unbounded), visibility = SHADER_VISIBILITY_PIXEL)," \
+    "DescriptorTable(Sampler(s0, space = 1, numDescriptors = unbounded), visibility = SHADER_VISIBILITY_PIXEL),"
+
+#define Renderer_StaticSamplers \
     "StaticSampler(s10, maxAnisotropy = 8, visibility = SHADER_VISIBILITY_PIXEL)," \
     "StaticSampler(s11, visibility = SHADER_VISIBILITY_PIXEL," \
         "addressU = TEXTURE_ADDRESS_CLAMP," \
@@ -37,6 +44,9 @@
         "filter = FILTER_MIN_MAG_LINEAR_MIP_POINT)," \
     "StaticSampler(s12, maxAnisotropy = 8, visibility = SHADER_VISIBILITY_PIXEL)"
 
+#define Renderer_RootSig Renderer_RootParams Renderer_StaticSamplers
+#define Renderer_BindlessRootSig Renderer_RootParams Renderer_BindlessParams Renderer_StaticSamplers
+
 // Common (static) samplers
 SamplerState defaultSampler : register(s10);
 SamplerComparisonState shadowSampler : register(s11);
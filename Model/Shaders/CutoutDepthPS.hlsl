@@ -19,8 +19,16 @@ struct VSOutput
     float2 uv : TexCoord0;
 };
 
+#ifdef BINDLESS_TEXTURES
+Texture2D<float4> bindlessTextures[]        : register(t0, space1);
+SamplerState bindlessSamplers[]             : register(s0, space1);
+
+#define baseColorTexture            bindlessTextures[baseColorTextureIndex]
+#define baseColorSampler            bindlessSamplers[samplerModes & 0xF]
+#else
 Texture2D<float4> baseColorTexture          : register(t0);
 SamplerState baseColorSampler               : register(s0);
+#endif
 
 cbuffer MaterialConstants : register(b0)
 {
@@ -29,9 +37,19 @@ cbuffer MaterialConstants : register(b0)
     float normalTextureScale;
     float2 metallicRoughnessFactor;
     uint flags;
+    uint baseColorTextureIndex;
+    uint metallicRoughnessTextureIndex;
+    uint occlusionTextureIndex;
+    uint emissiveTextureIndex;
+    uint normalTextureIndex;
+    uint samplerModes;
 }
 
+#ifdef BINDLESS_TEXTURES
+[RootSignature(Renderer_BindlessRootSig)]
+#else
 [RootSignature(Renderer_RootSig)]
+#endif
 void main(VSOutput vsOutput)
 {
     float cutoff = f16tof32(flags >> 16);
@@ -13,6 +13,24 @@
 
 #include "Common.hlsli"
 
+#ifdef BINDLESS_TEXTURES
+// Material textures are looked up in the scene texture heap by index.  Each texture picks one
+// of the 16 address mode samplers with 4 bits of samplerModes.
+Texture2D<float4> bindlessTextures[]        : register(t0, space1);
+SamplerState bindlessSamplers[]             : register(s0, space1);
+
+#define baseColorTexture            bindlessTextures[baseColorTextureIndex]
+#define metallicRoughnessTexture    bindlessTextures[metallicRoughnessTextureIndex]
+#define occlusionTexture            bindlessTextures[occlusionTextureIndex]
+#define emissiveTexture             bindlessTextures[emissiveTextureIndex]
+#define normalTexture               bindlessTextures[normalTextureIndex]
+
+#define baseColorSampler            bindlessSamplers[samplerModes & 0xF]
+#define metallicRoughnessSampler    bindlessSamplers[(samplerModes >> 4) & 0xF]
+#define occlusionSampler            bindlessSamplers[(samplerModes >> 8) & 0xF]
+#define emissiveSampler             bindlessSamplers[(samplerModes >> 12) & 0xF]
+#define normalSampler               bindlessSamplers[(samplerModes >> 16) & 0xF]
+#else
 Texture2D<float4> baseColorTexture          : register(t0);
 Texture2D<float3> metallicRoughnessTexture  : register(t1);
 Texture2D<float1> occlusionTexture          : register(t2);
@@ -24,6 +42,7 @@ SamplerState metallicRoughnessSampler       : register(s1);
 SamplerState occlusionSampler               : register(s2);
 SamplerState emissiveSampler                : register(s3);
 SamplerState normalSampler                  : register(s4);
+#endif
 
 TextureCube<float3> radianceIBLTexture      : register(t10);
 TextureCube<float3> irradianceIBLTexture    : register(t11);
@@ -37,6 +56,12 @@ cbuffer MaterialConstants : register(b0)
     float normalTextureScale;
     float2 metallicRoughnessFactor;
     uint flags;
+    uint baseColorTextureIndex;
+    uint metallicRoughnessTextureIndex;
+    uint occlusionTextureIndex;
+    uint emissiveTextureIndex;
+    uint normalTextureIndex;
+    uint samplerModes;
 }
 
 cbuffer GlobalConstants : register(b1)
@@ -229,7 +254,7 @@ float3 ComputeNormal(VSOutput vsOutput)
     float3x3 tangentFrame = float3x3(tangent, bitangent, normal);
 
     // Read normal map and convert to SNORM (TODO:  convert all normal maps to R8G8B8A8_SNORM?)
-    normal = normalTexture.Sample(normalSampler, UVSET(NORMAL)) * 2.0 - 1.0;
+    normal = normalTexture.Sample(normalSampler, UVSET(NORMAL)).rgb * 2.0 - 1.0;
 
     // glTF spec says to normalize N before and after scaling, but that's excessive
     normal = normalize(normal * float3(normalTextureScale, normalTextureScale, 1));
@@ -239,15 +264,19 @@ float3 ComputeNormal(VSOutput vsOutput)
 #endif
 }
 
+#ifdef BINDLESS_TEXTURES
+[RootSignature(Renderer_BindlessRootSig)]
+#else
 [RootSignature(Renderer_RootSig)]
+#endif
 float4 main(VSOutput vsOutput) : SV_Target0
 {
     // Load and modulate textures
     float4 baseColor = baseColorFactor * baseColorTexture.Sample(baseColorSampler, UVSET(BASECOLOR));
     float2 metallicRoughness = metallicRoughnessFactor * 
         metallicRoughnessTexture.Sample(metallicRoughnessSampler, UVSET(METALLICROUGHNESS)).bg;
-    float occlusion = occlusionTexture.Sample(occlusionSampler, UVSET(OCCLUSION));
-    float3 emissive = emissiveFactor * emissiveTexture.Sample(emissiveSampler, UVSET(EMISSIVE));
+    float occlusion = occlusionTexture.Sample(occlusionSampler, UVSET(OCCLUSION)).r;
+    float3 emissive = emissiveFactor * emissiveTexture.Sample(emissiveSampler, UVSET(EMISSIVE)).rgb;
     float3 normal = ComputeNormal(vsOutput);
 
     SurfaceProperties Surface;
@@ -15,14 +15,19 @@
 //
 
 #include "TextureConvert.h"
+#include "BlockCompress.h"
 #include "../Core/Utility.h"
 #include "DirectXTex.h"
+#include <ppl.h>
+#include <chrono>
+#include <unordered_set>
 
 using namespace DirectX;
 
 #define GetFlag(f) ((Flags & f) != 0)
 
-void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
+// Whether the DDS file is missing or older than the source
+static bool NeedsConversion(const std::wstring& originalFile)
 {
     std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
 
@@ -34,15 +39,115 @@ void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
     if (srcFileMissing && ddsFileMissing)
     {
         Utility::Printf("Texture %ws is missing.\n", Utility::RemoveBasePath(originalFile).c_str());
-        return;
+        return false;
     }
 
     // If we can find the source texture and the DDS file is older, reconvert.
     if (ddsFileMissing || !srcFileMissing && ddsFileStat.st_mtime < srcFileStat.st_mtime)
     {
         Utility::Printf("DDS texture %ws missing or older than source.  Rebuilding.\n", Utility::RemoveBasePath(originalFile).c_str());
+        return true;
+    }
+
+    return false;
+}
+
+void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
+{
+    if (NeedsConversion(originalFile))
         ConvertToDDS(originalFile, flags);
+}
+
+void CompileTexturesOnDemand(std::vector<TextureConversion>& textures)
+{
+    // Find the unique files that need converting
+    std::vector<TextureConversion*> pending;
+    std::unordered_set<std::wstring> seenFiles;
+    for (auto& texture : textures)
+    {
+        texture.converted = false;
+        texture.succeeded = true;
+        texture.seconds = 0.0;
+
+        if (seenFiles.insert(Utility::ToLower(texture.originalFile)).second && NeedsConversion(texture.originalFile))
+        {
+            texture.converted = true;
+            pending.push_back(&texture);
+        }
     }
+
+    if (pending.empty())
+        return;
+
+    auto batchStart = std::chrono::steady_clock::now();
+
+    // Conversions are independent and each runs single-threaded, so one task per texture
+    // keeps every core busy.  WIC needs COM initialized on each worker thread.
+    Concurrency::parallel_for_each(pending.begin(), pending.end(), [](TextureConversion* texture)
+    {
+        HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+        auto start = std::chrono::steady_clock::now();
+        texture->succeeded = ConvertToDDS(texture->originalFile, texture->flags);
+        texture->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (SUCCEEDED(hr))
+            CoUninitialize();
+    });
+
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    double sumSeconds = 0.0;
+    for (const TextureConversion* texture : pending)
+    {
+        Utility::Printf("  %6.2f s  %ws%s\n", texture->seconds, Utility::RemoveBasePath(texture->originalFile).c_str(),
+            texture->succeeded ? "" : " (failed)");
+        sumSeconds += texture->seconds;
+    }
+    Utility::Printf("Converted %u textures in %.2f s (%.2f s of work)\n", (uint32_t)pending.size(), totalSeconds, sumSeconds);
+}
+
+// Compress an RGBA8 image and its mips with BlockCompress, replacing the image.  Returns false without
+// changing anything for formats it doesn't handle, such as BC6H.
+static bool CompressWithBuiltInEncoder( ScratchImage& image, DXGI_FORMAT cformat, BlockCompress::Quality quality )
+{
+    BlockCompress::Format format;
+    switch (cformat)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB: format = BlockCompress::kBC1; break;
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB: format = BlockCompress::kBC3; break;
+    case DXGI_FORMAT_BC4_UNORM:      format = BlockCompress::kBC4; break;
+    case DXGI_FORMAT_BC5_UNORM:      format = BlockCompress::kBC5; break;
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB: format = BlockCompress::kBC7; break;
+    default: return false;
+    }
+
+    const TexMetadata& metadata = image.GetMetadata();
+    if (metadata.format != DXGI_FORMAT_R8G8B8A8_UNORM && metadata.format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+        return false;
+
+    TexMetadata compressedMetadata = metadata;
+    compressedMetadata.format = cformat;
+
+    ScratchImage compressed;
+    if (FAILED(compressed.Initialize(compressedMetadata)))
+        return false;
+
+    // Images are in the same order in both, one per mip and array slice.  Each image is compressed on
+    // the calling thread, since conversions already run one per core.
+    ASSERT(compressed.GetImageCount() == image.GetImageCount());
+    for (size_t i = 0; i < image.GetImageCount(); ++i)
+    {
+        const Image& src = image.GetImages()[i];
+        const Image& dst = compressed.GetImages()[i];
+        BlockCompress::CompressImage(format, src.pixels, src.rowPitch, (uint32_t)src.width, (uint32_t)src.height,
+            dst.pixels, dst.rowPitch, quality, 1);
+    }
+
+    image = std::move(compressed);
+    return true;
 }
 
 bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
@@ -238,6 +343,10 @@ bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
         {
             Utility::Printf( "Texture size (%Iux%Iu) not a multiple of 4 \"%ws\", so skipping compress\n", info.width, info.height, filePath.c_str() );
         }
+        else if (!isHDR && CompressWithBuiltInEncoder(*image, cformat, bUseBestBC ? BlockCompress::kHigh : BlockCompress::kNormal))
+        {
+            // Done
+        }
         else
         {
             std::unique_ptr<ScratchImage> timage(new ScratchImage);
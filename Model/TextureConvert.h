@@ -15,6 +15,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 enum TexConversionFlags
 {
@@ -35,6 +36,22 @@ inline uint8_t TextureOptions(bool sRGB, bool hasAlpha=false, bool invertY=false
 // If the DDS version of the texture specified does not exist or is older than the source texture, reconvert it.
 void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags);
 
+struct TextureConversion
+{
+    std::wstring originalFile;
+    uint32_t flags;
+
+    // Filled in by CompileTexturesOnDemand()
+    bool converted;         // The DDS file was missing or out of date
+    bool succeeded;
+    double seconds;         // Time spent converting, on whichever thread did it
+};
+
+// As CompileTextureOnDemand(), but for many textures at once.  Out of date textures are converted in
+// parallel.  Requests that name the same file are converted once with the first request's flags, since
+// they would write the same DDS file; the duplicates are marked as not converted.
+void CompileTexturesOnDemand(std::vector<TextureConversion>& textures);
+
 // Loads a non-DDS texture such as TGA, PNG, or JPG, then converts it to a more optimal
 // DDS format with a full mip chain.  Resultant file has the same path with the file extension
 // changed to "DDS".
@@ -34,6 +34,10 @@
 #include "ModelLoader.h"
 #include "ShadowCamera.h"
 #include "Display.h"
+#include "FileUtility.h"
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 
 #define LEGACY_RENDERER
 
@@ -145,6 +149,146 @@ void LoadIBLTextures()
         g_IBLSet.Increment();
 }
 
+// Every file under dir, recursively
+void ListFiles( const std::wstring& dir, std::vector<std::wstring>& files )
+{
+    WIN32_FIND_DATA ffd;
+    HANDLE hFind = FindFirstFile((dir + L"/*").c_str(), &ffd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        std::wstring name = ffd.cFileName;
+        if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            files.push_back(dir + L"/" + name);
+        else if (name != L"." && name != L"..")
+            ListFiles(dir + L"/" + name, files);
+    }
+    while (FindNextFile(hFind, &ffd) != 0);
+
+    FindClose(hFind);
+}
+
+// Writes a chunked copy of every .mini and .dds file under dir with the named codec, then reports the
+// compression ratio and how fast each copy decodes compared with the original.  Originals are left in
+// place; delete them to make the loaders use the compressed copies.
+void RecompressAssets( const std::wstring& dir, const std::wstring& codecExtension, int level )
+{
+    Utility::FileCodec codec;
+    if (!Utility::FindFileCodec(codecExtension, codec))
+    {
+        Utility::Printf(L"Unknown codec %s\n", codecExtension.c_str());
+        return;
+    }
+
+    std::vector<std::wstring> files;
+    ListFiles(dir, files);
+
+    for (const std::wstring& path : files)
+    {
+        std::wstring ext = Utility::ToLower(Utility::GetFileExtension(path));
+        if (ext != L"mini" && ext != L"dds")
+            continue;
+
+        std::wstring compressedPath = path + codecExtension;
+        if (!Utility::CompressFile(path, codec, level))
+        {
+            Utility::Printf(L"Failed to compress %s\n", path.c_str());
+            continue;
+        }
+
+        struct _stat64 original, compressed;
+        _wstat64(path.c_str(), &original);
+        _wstat64(compressedPath.c_str(), &compressed);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        Utility::ByteArray decoded = Utility::ReadFileSync(path);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        Utility::Printf(L"%s:  %.1f%% of %llu bytes, decoded at %.0f MB/s\n", compressedPath.c_str(),
+            100.0 * compressed.st_size / (std::max)(original.st_size, 1ll), original.st_size,
+            decoded->size() / (1024.0 * 1024.0) / (std::max)(seconds, 1e-9));
+    }
+}
+
+// Packs everything under dir into dir.pak, compressed with the named codec if given, then times reading
+// every file loose and from the archive.  The archive stays mounted.  Compressed siblings are packed
+// under their original names.
+void PackAssets( const std::wstring& dir, const std::wstring& codecExtension, int level )
+{
+    std::vector<std::wstring> files;
+    ListFiles(dir, files);
+
+    for (std::wstring& path : files)
+    {
+        Utility::FileCodec codec;
+        std::wstring ext = L"." + Utility::ToLower(Utility::GetFileExtension(path));
+        if (ext == L".gz" || Utility::FindFileCodec(ext, codec))
+            path = Utility::RemoveExtension(path);
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    const std::wstring archiveFile = dir + L".pak";
+    if (!Utility::PackArchive(archiveFile, files, codecExtension, level))
+    {
+        Utility::Printf(L"Failed to pack %s\n", archiveFile.c_str());
+        return;
+    }
+
+    auto ReadAll = [&files]( size_t& totalBytes )
+    {
+        totalBytes = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const std::wstring& path : files)
+            totalBytes += Utility::ReadFileSync(path)->size();
+        auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    size_t looseBytes, archivedBytes;
+    double looseTime = ReadAll(looseBytes);
+    Utility::MountArchive(archiveFile);
+    double archiveTime = ReadAll(archivedBytes);
+
+    struct _stat64 archiveStat;
+    _wstat64(archiveFile.c_str(), &archiveStat);
+
+    Utility::Printf(L"Packed %u files (%.1f MB) into %s (%.1f MB).  Read loose in %.0f ms, from the archive in %.0f ms\n",
+        (uint32_t)files.size(), looseBytes / (1024.0 * 1024.0), archiveFile.c_str(), archiveStat.st_size / (1024.0 * 1024.0),
+        looseTime, archiveTime);
+    ASSERT(looseBytes == archivedBytes);
+}
+
+// Reads every file under dir one at a time, then all at once through the asynchronous reader, and
+// reports the throughput of each.  Run it twice to compare with a warm file cache.
+void BenchmarkFileReads( const std::wstring& dir )
+{
+    std::vector<std::wstring> files;
+    ListFiles(dir, files);
+
+    size_t syncBytes = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const std::wstring& path : files)
+        syncBytes += Utility::ReadFileSync(path)->size();
+    auto end = std::chrono::high_resolution_clock::now();
+    double syncSeconds = std::chrono::duration<double>(end - start).count();
+
+    std::atomic<size_t> asyncBytes(0);
+    start = std::chrono::high_resolution_clock::now();
+    Utility::ReadFilesAsync(files, [&asyncBytes]( size_t, Utility::ByteArray file ) { asyncBytes += file->size(); });
+    Utility::WaitForFileReads();
+    end = std::chrono::high_resolution_clock::now();
+    double asyncSeconds = std::chrono::duration<double>(end - start).count();
+
+    Utility::Printf(L"Read %u files (%.1f MB).  One at a time:  %.0f files/s, %.0f MB/s.  Batched:  %.0f files/s, %.0f MB/s\n",
+        (uint32_t)files.size(), syncBytes / (1024.0 * 1024.0),
+        files.size() / (std::max)(syncSeconds, 1e-9), syncBytes / (1024.0 * 1024.0) / (std::max)(syncSeconds, 1e-9),
+        files.size() / (std::max)(asyncSeconds, 1e-9), asyncBytes / (1024.0 * 1024.0) / (std::max)(asyncSeconds, 1e-9));
+}
+
 void ModelViewer::Startup( void )
 {
     MotionBlur::Enable = true;
@@ -159,6 +303,33 @@ void ModelViewer::Startup( void )
 
     LoadIBLTextures();
 
+    // -recompress <dir> [-codec .lz4] [-level n]
+    std::wstring recompressDir;
+    if (CommandLineArgs::GetString(L"recompress", recompressDir))
+    {
+        std::wstring codecExtension = L".zlc";
+        CommandLineArgs::GetString(L"codec", codecExtension);
+        uint32_t level = 0;
+        CommandLineArgs::GetInteger(L"level", level);
+        RecompressAssets(recompressDir, codecExtension, (int)level);
+    }
+
+    // -pack <dir> [-codec .lz4] [-level n]
+    std::wstring packDir;
+    if (CommandLineArgs::GetString(L"pack", packDir))
+    {
+        std::wstring codecExtension;
+        CommandLineArgs::GetString(L"codec", codecExtension);
+        uint32_t level = 0;
+        CommandLineArgs::GetInteger(L"level", level);
+        PackAssets(packDir, codecExtension, (int)level);
+    }
+
+    // -iobench <dir>
+    std::wstring benchmarkDir;
+    if (CommandLineArgs::GetString(L"iobench", benchmarkDir))
+        BenchmarkFileReads(benchmarkDir);
+
     std::wstring gltfFileName;
 
     bool forceRebuild = false;
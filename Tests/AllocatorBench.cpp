@@ -0,0 +1,432 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Allocation rate and fragmentation of the allocators in AllocatorCore.h under synthetic frame workloads.
+// Frames are retired through a HostFence that lags a fixed number of frames behind, as the GPU would.
+//
+
+#include "TestHarness.h"
+#include "AllocatorCore.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace AllocatorCore;
+
+namespace
+{
+    typedef std::reference_wrapper<const HostFence> HostFenceRef;
+
+    const uint32_t kFramesInFlight = 3;
+
+    uint32_t NumFrames( uint32_t Full ) { return TestHarness::IsQuickRun() ? Full / 50 : Full; }
+
+    // A resource that lives for a number of frames, as streamed meshes and textures do
+    struct TimedBlock
+    {
+        uint32_t ExpireFrame;
+        size_t Offset;
+        uint32_t Node;
+        uint32_t Order;
+        size_t Requested;
+    };
+
+    void ReportRate( const char* Name, double Operations, double Seconds )
+    {
+        std::printf("  %-28s %8.2f M ops/s\n", Name, Operations / Seconds * 1e-6);
+    }
+}
+
+// Per-frame upload allocations of the kind LinearAllocator serves: many small constant and vertex
+// blocks, with the occasional allocation larger than a page
+TEST_CASE(LinearAllocatorFrames)
+{
+    const size_t kPageSize = 2 * 1024 * 1024;
+    const uint32_t kAllocsPerFrame = 20000;
+    const uint32_t Frames = NumFrames(1000);
+
+    HostFence Fence;
+    FencedPagePool<HostMemoryProvider, HostFenceRef> Pool(HostMemoryProvider(kPageSize), std::cref(Fence));
+    LinearOffsetAllocator Offsets(kPageSize);
+    std::mt19937 Random(1);
+
+    std::vector<HostPage*> UsedPages, LargePages;
+    HostPage* CurPage = nullptr;
+    size_t RequestedBytes = 0, PageBytes = 0;
+    uint64_t NumAllocs = 0;
+
+    TestHarness::Timer Timer;
+    for (uint32_t Frame = 0; Frame < Frames; ++Frame)
+    {
+        for (uint32_t i = 0; i < kAllocsPerFrame; ++i)
+        {
+            // Mostly constant buffers, some dynamic vertex data, rarely a big upload
+            const uint32_t Kind = Random() % 1000;
+            const size_t Size = Kind < 900 ? 256 : Kind < 999 ? 256 + Random() % 65536 : kPageSize + Random() % kPageSize;
+            const size_t AlignedSize = (Size + 255) & ~(size_t)255;
+            RequestedBytes += Size;
+            ++NumAllocs;
+
+            if (AlignedSize > kPageSize)
+            {
+                LargePages.push_back(Pool.CreateLargePage(AlignedSize));
+                PageBytes += AlignedSize;
+                continue;
+            }
+
+            if (Offsets.Allocate(AlignedSize, 256) == LinearOffsetAllocator::kInvalidOffset)
+            {
+                if (CurPage != nullptr)
+                    UsedPages.push_back(CurPage);
+                CurPage = Pool.RequestPage();
+                PageBytes += kPageSize;
+                Offsets.StartPage();
+                Offsets.Allocate(AlignedSize, 256);
+            }
+        }
+
+        // End of frame: retire what was used and let the GPU catch up to kFramesInFlight behind
+        const uint64_t FenceValue = Fence.Signal();
+        if (CurPage != nullptr)
+            UsedPages.push_back(CurPage);
+        CurPage = nullptr;
+        Offsets.EndPage();
+        Pool.DiscardPages(FenceValue, UsedPages);
+        Pool.FreeLargePages(FenceValue, LargePages);
+        UsedPages.clear();
+        LargePages.clear();
+        if (FenceValue > kFramesInFlight)
+            Fence.Complete(FenceValue - kFramesInFlight);
+    }
+    const double Seconds = Timer.Elapsed();
+
+    ReportRate("allocations", (double)NumAllocs, Seconds);
+    std::printf("  %-28s %8zu\n", "pages created", Pool.GetPageCount());
+    std::printf("  %-28s %8.1f%%\n", "page space used", 100.0 * RequestedBytes / PageBytes);
+    CHECK(Pool.GetPageCount() > 0);
+}
+
+// Blocks of the sizes streamed geometry and textures use, each living for a random number of frames,
+// to measure how far buddy and TLSF allocation fragment a long-running heap
+template <typename Allocator>
+static void RunStreamingFrames( const char* Name, Allocator& Heap, size_t HeapBytes )
+{
+    // About 60% of the heap is live once the lifetimes reach a steady state
+    const uint32_t kAllocsPerFrame = 20;
+    const uint32_t Frames = NumFrames(50000);
+
+    std::mt19937 Random(2);
+    std::vector<TimedBlock> Live;
+    uint64_t NumOps = 0, NumFailures = 0;
+    double ExternalSum = 0.0, InternalSum = 0.0;
+    uint32_t Samples = 0;
+
+    TestHarness::Timer Timer;
+    for (uint32_t Frame = 0; Frame < Frames; ++Frame)
+    {
+        for (size_t i = 0; i < Live.size(); )
+        {
+            if (Live[i].ExpireFrame <= Frame)
+            {
+                Heap.Free(Live[i]);
+                Live[i] = Live.back();
+                Live.pop_back();
+                ++NumOps;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        for (uint32_t i = 0; i < kAllocsPerFrame; ++i)
+        {
+            // Log-uniform between 256 bytes and 1 MB
+            const size_t Size = (size_t)(256.0 * std::pow(4096.0, (Random() % 10000) / 10000.0));
+            TimedBlock Block;
+            Block.ExpireFrame = Frame + 1 + Random() % 120;
+            Block.Requested = Size;
+            ++NumOps;
+            if (Heap.Allocate(Size, Block))
+                Live.push_back(Block);
+            else
+                ++NumFailures;
+        }
+
+        if (Frame % 16 == 0)
+        {
+            size_t AllocatedBytes, LargestFree;
+            Heap.Measure(AllocatedBytes, LargestFree);
+            size_t RequestedBytes = 0;
+            for (const TimedBlock& Block : Live)
+                RequestedBytes += Block.Requested;
+
+            const size_t FreeBytes = HeapBytes - AllocatedBytes;
+            ExternalSum += FreeBytes == 0 ? 0.0 : 1.0 - (double)LargestFree / FreeBytes;
+            InternalSum += AllocatedBytes == 0 ? 0.0 : 1.0 - (double)RequestedBytes / AllocatedBytes;
+            ++Samples;
+        }
+    }
+    const double Seconds = Timer.Elapsed();
+
+    std::printf("  %s\n", Name);
+    ReportRate("allocations and frees", (double)NumOps, Seconds);
+    std::printf("  %-28s %8.2f%%\n", "failed allocations", 100.0 * NumFailures / (Frames * kAllocsPerFrame));
+    std::printf("  %-28s %8.1f%%\n", "external fragmentation", 100.0 * ExternalSum / Samples);
+    std::printf("  %-28s %8.1f%%\n", "internal fragmentation", 100.0 * InternalSum / Samples);
+}
+
+namespace
+{
+    const size_t kStreamingHeapBytes = (size_t)256 * 1024 * 1024;
+    const size_t kBuddyUnit = 256;
+
+    struct BuddyHeap
+    {
+        BuddyHeap() : Blocks(20) {}     // 2^20 units of 256 bytes
+
+        bool Allocate( size_t Size, TimedBlock& Block )
+        {
+            const size_t Units = (Size + kBuddyUnit - 1) / kBuddyUnit;
+            uint32_t Order = 0;
+            while (BuddyOrderAllocator::OrderToUnitSize(Order) < Units)
+                ++Order;
+            Block.Order = Order;
+            Block.Offset = Blocks.AllocateBlock(Order);
+            return Block.Offset != BuddyOrderAllocator::kInvalidOffset;
+        }
+
+        void Free( const TimedBlock& Block ) { Blocks.DeallocateBlock(Block.Offset, Block.Order); }
+
+        void Measure( size_t& AllocatedBytes, size_t& LargestFree ) const
+        {
+            AllocatedBytes = kStreamingHeapBytes - Blocks.GetFreeUnits() * kBuddyUnit;
+            LargestFree = Blocks.GetLargestFreeUnits() * kBuddyUnit;
+        }
+
+        BuddyOrderAllocator Blocks;
+    };
+
+    struct TLSFHeap
+    {
+        TLSFHeap() : Ranges(kStreamingHeapBytes, kBuddyUnit) {}
+
+        bool Allocate( size_t Size, TimedBlock& Block )
+        {
+            Block.Node = Ranges.Allocate(Size);
+            return Block.Node != TLSFOffsetAllocator::kInvalidNode;
+        }
+
+        void Free( const TimedBlock& Block ) { Ranges.Free(Block.Node); }
+
+        void Measure( size_t& AllocatedBytes, size_t& LargestFree ) const
+        {
+            const SubAllocatorStats Stats = Ranges.GetStats();
+            AllocatedBytes = Stats.AllocatedSize;
+            LargestFree = Stats.LargestFreeBlock;
+        }
+
+        TLSFOffsetAllocator Ranges;
+    };
+}
+
+namespace
+{
+    // The free block sets BuddyAllocator kept before BuddyOrderAllocator's bitmaps, for comparison.
+    // Both take the lowest free block of the smallest order that fits, so they return the same offsets.
+    class SetBuddyAllocator
+    {
+    public:
+        explicit SetBuddyAllocator( uint32_t MaxOrder ) : m_MaxOrder(MaxOrder), m_FreeBlocks(MaxOrder + 1)
+        {
+            m_FreeBlocks[MaxOrder].insert(0);
+        }
+
+        size_t AllocateBlock( uint32_t Order )
+        {
+            if (Order > m_MaxOrder)
+                return BuddyOrderAllocator::kInvalidOffset;
+
+            auto Iter = m_FreeBlocks[Order].begin();
+            if (Iter != m_FreeBlocks[Order].end())
+            {
+                const size_t Offset = *Iter;
+                m_FreeBlocks[Order].erase(Iter);
+                return Offset;
+            }
+
+            // Split the next order up and keep the right half
+            const size_t Left = AllocateBlock(Order + 1);
+            if (Left != BuddyOrderAllocator::kInvalidOffset)
+                m_FreeBlocks[Order].insert(Left + BuddyOrderAllocator::OrderToUnitSize(Order));
+            return Left;
+        }
+
+        void DeallocateBlock( size_t Offset, uint32_t Order )
+        {
+            const size_t Buddy = Offset ^ BuddyOrderAllocator::OrderToUnitSize(Order);
+            auto Iter = m_FreeBlocks[Order].find(Buddy);
+            if (Order < m_MaxOrder && Iter != m_FreeBlocks[Order].end())
+            {
+                m_FreeBlocks[Order].erase(Iter);
+                DeallocateBlock((std::min)(Offset, Buddy), Order + 1);
+            }
+            else
+            {
+                m_FreeBlocks[Order].insert(Offset);
+            }
+        }
+
+    private:
+        uint32_t m_MaxOrder;
+        std::vector<std::set<size_t> > m_FreeBlocks;
+    };
+
+    // Replays one random trace of allocations and frees of orders 0 to 6, which is the range
+    // streamed buffers cover, against either allocator
+    template <typename Allocator>
+    double RunBuddyTrace( Allocator& Blocks, uint32_t Steps, std::vector<size_t>& Offsets )
+    {
+        struct Live { size_t Offset; uint32_t Order; };
+        std::vector<Live> Allocations;
+        std::mt19937 Random(9);
+
+        TestHarness::Timer Timer;
+        for (uint32_t Step = 0; Step < Steps; ++Step)
+        {
+            // Hold about half of the blocks live
+            if (Allocations.empty() || Random() % 2 == 0)
+            {
+                const uint32_t Order = Random() % 7;
+                const size_t Offset = Blocks.AllocateBlock(Order);
+                Offsets.push_back(Offset);
+                if (Offset != BuddyOrderAllocator::kInvalidOffset)
+                {
+                    Live Block = { Offset, Order };
+                    Allocations.push_back(Block);
+                }
+            }
+            else
+            {
+                const size_t Index = Random() % Allocations.size();
+                Blocks.DeallocateBlock(Allocations[Index].Offset, Allocations[Index].Order);
+                Allocations[Index] = Allocations.back();
+                Allocations.pop_back();
+            }
+        }
+        return Timer.Elapsed();
+    }
+}
+
+// Free block bitmaps against the ordered sets they replaced, on a 1M unit heap
+TEST_CASE(BuddySetVersusBitmap)
+{
+    const uint32_t kMaxOrder = 20;
+    const uint32_t Steps = NumFrames(10000000);
+
+    std::vector<size_t> SetOffsets, BitmapOffsets;
+    SetOffsets.reserve(Steps);
+    BitmapOffsets.reserve(Steps);
+
+    SetBuddyAllocator SetBlocks(kMaxOrder);
+    const double SetSeconds = RunBuddyTrace(SetBlocks, Steps, SetOffsets);
+
+    BuddyOrderAllocator BitmapBlocks(kMaxOrder);
+    const double BitmapSeconds = RunBuddyTrace(BitmapBlocks, Steps, BitmapOffsets);
+
+    ReportRate("std::set free lists", Steps, SetSeconds);
+    ReportRate("bitmap free lists", Steps, BitmapSeconds);
+    std::printf("  %-28s %8.2fx\n", "speedup", SetSeconds / BitmapSeconds);
+
+    // Same placement policy, so the traces must match exactly
+    CHECK(SetOffsets == BitmapOffsets);
+}
+
+TEST_CASE(BuddyStreamingFrames)
+{
+    BuddyHeap Heap;
+    RunStreamingFrames("buddy, 256 MB heap", Heap, kStreamingHeapBytes);
+}
+
+TEST_CASE(TLSFStreamingFrames)
+{
+    TLSFHeap Heap;
+    RunStreamingFrames("TLSF, 256 MB heap", Heap, kStreamingHeapBytes);
+}
+
+namespace
+{
+    struct HostCommandAllocator
+    {
+        std::vector<uint8_t> Memory;
+    };
+
+    // Stands in for ID3D12CommandAllocator, whose memory grows to fit the largest list recorded
+    struct HostCommandAllocatorProvider
+    {
+        typedef HostCommandAllocator ObjectType;
+
+        ObjectType* Create( size_t ) { return new HostCommandAllocator; }
+        void Reset( ObjectType* ) {}
+        void Destroy( ObjectType* Object ) { delete Object; }
+    };
+}
+
+// Several threads each recording a few command lists per frame, as parallel MeshSorter passes do.  Every
+// submission signals the shared fence, which completes kFramesInFlight frames' worth of signals behind.
+TEST_CASE(CommandAllocatorPoolFrames)
+{
+    const uint32_t kThreads = 4;
+    const uint32_t kListsPerFrame = 4;
+    const uint32_t Frames = NumFrames(50000);
+
+    HostFence Fence;
+    FencedObjectPool<HostCommandAllocatorProvider> Pool;
+
+    TestHarness::Timer Timer;
+    std::vector<std::thread> Workers;
+    for (uint32_t t = 0; t < kThreads; ++t)
+    {
+        Workers.push_back(std::thread([&Pool, &Fence, Frames, t]
+        {
+            for (uint32_t Frame = 0; Frame < Frames; ++Frame)
+            {
+                for (uint32_t i = 0; i < kListsPerFrame; ++i)
+                {
+                    HostCommandAllocator* Allocator = Pool.Request(std::cref(Fence));
+
+                    // One list in a thousand is huge, like a loading screen's
+                    const uint64_t Usage = (Frame * 31 + t * 7 + i) % 1000 == 0 ? 4 << 20 : 64 << 10;
+                    const uint64_t FenceValue = Fence.Signal();
+                    Pool.Discard(FenceValue, Allocator, Usage);
+
+                    const uint64_t Lag = kFramesInFlight * kThreads * kListsPerFrame;
+                    if (FenceValue > Lag)
+                        Fence.Complete(FenceValue - Lag);
+                }
+            }
+        }));
+    }
+    for (std::thread& Worker : Workers)
+        Worker.join();
+    const double Seconds = Timer.Elapsed();
+
+    const auto Stats = Pool.GetStats();
+    ReportRate("requests", (double)Frames * kThreads * kListsPerFrame, Seconds);
+    std::printf("  %-28s %8zu\n", "allocators created", Stats.Created);
+    std::printf("  %-28s %8zu\n", "allocators trimmed", Stats.Trimmed);
+    std::printf("  %-28s %8zu\n", "allocators live", Stats.Live);
+    CHECK(Stats.Recycled > 0);
+}
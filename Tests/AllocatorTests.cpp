@@ -0,0 +1,501 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Checks of the allocator bookkeeping in AllocatorCore.h, driven by host memory and a hand-advanced fence.
+//
+
+#include "TestHarness.h"
+#include "AllocatorCore.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+
+using namespace AllocatorCore;
+
+typedef std::reference_wrapper<const HostFence> HostFenceRef;
+typedef FencedPagePool<HostMemoryProvider, HostFenceRef> HostPagePool;
+
+TEST_CASE(LinearOffsetAllocatorAlignsAndFills)
+{
+    LinearOffsetAllocator Offsets(1024);
+
+    // No page is current until one is started
+    CHECK_EQUAL(LinearOffsetAllocator::kInvalidOffset, Offsets.Allocate(16, 16));
+
+    Offsets.StartPage();
+    CHECK_EQUAL(0u, Offsets.Allocate(10, 16));
+    CHECK_EQUAL(256u, Offsets.Allocate(256, 256));
+    CHECK_EQUAL(512u, Offsets.Allocate(512, 16));
+    CHECK_EQUAL(LinearOffsetAllocator::kInvalidOffset, Offsets.Allocate(1, 16));
+
+    Offsets.StartPage();
+    CHECK_EQUAL(0u, Offsets.Allocate(1024, 256));
+    Offsets.EndPage();
+    CHECK_EQUAL(LinearOffsetAllocator::kInvalidOffset, Offsets.Allocate(1, 1));
+}
+
+TEST_CASE(FencedPagePoolRecyclesAfterFence)
+{
+    HostFence Fence;
+    HostPagePool Pool(HostMemoryProvider(4096), std::cref(Fence));
+
+    HostPage* First = Pool.RequestPage();
+    CHECK(First != nullptr);
+    CHECK_EQUAL((size_t)4096, First->m_Size);
+
+    const uint64_t FenceValue = Fence.Signal();
+    Pool.DiscardPages(FenceValue, std::vector<HostPage*>(1, First));
+
+    // Still in flight, so a new page is created
+    HostPage* Second = Pool.RequestPage();
+    CHECK(Second != First);
+    CHECK_EQUAL((size_t)2, Pool.GetPageCount());
+
+    Fence.Complete(FenceValue);
+    HostPage* Third = Pool.RequestPage();
+    CHECK(Third == First);
+    CHECK_EQUAL((size_t)2, Pool.GetPageCount());
+}
+
+TEST_CASE(FencedPagePoolFreesLargePages)
+{
+    HostFence Fence;
+    HostPagePool Pool(HostMemoryProvider(4096), std::cref(Fence));
+
+    HostPage* Large = Pool.CreateLargePage(1 << 20);
+    CHECK_EQUAL((size_t)(1 << 20), Large->m_Size);
+
+    Pool.FreeLargePages(Fence.Signal(), std::vector<HostPage*>(1, Large));
+    CHECK_EQUAL((size_t)0, Pool.GetPageCount());
+
+    // Large pages aren't recycled
+    Fence.Complete(Fence.Signal());
+    HostPage* Page = Pool.RequestPage();
+    CHECK(Page != Large);
+    CHECK_EQUAL((size_t)4096, Page->m_Size);
+}
+
+TEST_CASE(FencedListKeepsPendingBatches)
+{
+    FencedList<int> List;
+    List.Push(1, std::vector<int>(2, 10));
+    List.Push(3, std::vector<int>(1, 30));
+
+    std::vector<int> Completed;
+    List.Reclaim([](uint64_t Value) { return Value <= 2; }, Completed);
+    CHECK_EQUAL((size_t)2, Completed.size());
+
+    Completed.clear();
+    List.Reclaim([](uint64_t Value) { return Value <= 2; }, Completed);
+    CHECK(Completed.empty());
+
+    List.Reclaim([](uint64_t) { return true; }, Completed);
+    CHECK_EQUAL((size_t)1, Completed.size());
+    CHECK_EQUAL(30, Completed[0]);
+}
+
+TEST_CASE(BuddyOrderAllocatorSplitsAndMerges)
+{
+    BuddyOrderAllocator Blocks(4);
+    CHECK_EQUAL((size_t)16, Blocks.GetFreeUnits());
+    CHECK_EQUAL((size_t)16, Blocks.GetLargestFreeUnits());
+
+    const size_t A = Blocks.AllocateBlock(0);
+    const size_t B = Blocks.AllocateBlock(0);
+    const size_t C = Blocks.AllocateBlock(2);
+    CHECK_EQUAL((size_t)0, A);
+    CHECK_EQUAL((size_t)1, B);
+    CHECK_EQUAL((size_t)4, C);
+    CHECK_EQUAL((size_t)10, Blocks.GetFreeUnits());
+    CHECK_EQUAL((size_t)8, Blocks.GetLargestFreeUnits());
+
+    CHECK_EQUAL(BuddyOrderAllocator::kInvalidOffset, Blocks.AllocateBlock(5));
+
+    Blocks.DeallocateBlock(A, 0);
+    Blocks.DeallocateBlock(C, 2);
+    Blocks.DeallocateBlock(B, 0);
+    CHECK_EQUAL((size_t)16, Blocks.GetFreeUnits());
+    CHECK_EQUAL((size_t)1, Blocks.GetFreeBlockCount());
+    CHECK_EQUAL((size_t)16, Blocks.GetLargestFreeUnits());
+}
+
+TEST_CASE(BuddyOrderAllocatorNeverOverlaps)
+{
+    const uint32_t MaxOrder = 10;
+    BuddyOrderAllocator Blocks(MaxOrder);
+    std::vector<int> Owner(BuddyOrderAllocator::OrderToUnitSize(MaxOrder), -1);
+
+    struct Live { size_t Offset; uint32_t Order; };
+    std::vector<Live> Allocations;
+    std::mt19937 Random(7);
+
+    for (int Step = 0; Step < 20000; ++Step)
+    {
+        if (Allocations.empty() || Random() % 3 != 0)
+        {
+            const uint32_t Order = Random() % 5;
+            const size_t Offset = Blocks.AllocateBlock(Order);
+            if (Offset == BuddyOrderAllocator::kInvalidOffset)
+                continue;
+
+            CHECK(Offset % BuddyOrderAllocator::OrderToUnitSize(Order) == 0);
+            for (size_t i = 0; i < BuddyOrderAllocator::OrderToUnitSize(Order); ++i)
+            {
+                CHECK(Owner[Offset + i] == -1);
+                Owner[Offset + i] = Step;
+            }
+            Live Block = { Offset, Order };
+            Allocations.push_back(Block);
+        }
+        else
+        {
+            const size_t Index = Random() % Allocations.size();
+            const Live Block = Allocations[Index];
+            Allocations[Index] = Allocations.back();
+            Allocations.pop_back();
+
+            for (size_t i = 0; i < BuddyOrderAllocator::OrderToUnitSize(Block.Order); ++i)
+                Owner[Block.Offset + i] = -1;
+            Blocks.DeallocateBlock(Block.Offset, Block.Order);
+        }
+    }
+
+    size_t UsedUnits = 0;
+    for (const Live& Block : Allocations)
+        UsedUnits += BuddyOrderAllocator::OrderToUnitSize(Block.Order);
+    CHECK_EQUAL(BuddyOrderAllocator::OrderToUnitSize(MaxOrder) - UsedUnits, Blocks.GetFreeUnits());
+
+    for (const Live& Block : Allocations)
+        Blocks.DeallocateBlock(Block.Offset, Block.Order);
+    CHECK_EQUAL((size_t)1, Blocks.GetFreeBlockCount());
+}
+
+TEST_CASE(BuddyCompactionMovesDown)
+{
+    BuddyOrderAllocator Blocks(4);
+    const size_t A = Blocks.AllocateBlock(2);
+    const size_t B = Blocks.AllocateBlock(2);
+    const size_t C = Blocks.AllocateBlock(2);
+    CHECK_EQUAL((size_t)8, C);
+    Blocks.DeallocateBlock(A, 2);
+    Blocks.DeallocateBlock(B, 2);
+
+    // Only C is live, with 8 free units below it
+    std::vector<DefragBlock> Live(1);
+    Live[0].Offset = C;
+    Live[0].Order = 2;
+    Live[0].Tag = 5;
+
+    std::vector<DefragMove> Moves;
+    CHECK_EQUAL((size_t)0, PlanBuddyCompaction(Blocks, Live, 3, Moves));
+    CHECK(Moves.empty());
+
+    CHECK_EQUAL((size_t)4, PlanBuddyCompaction(Blocks, Live, 4, Moves));
+    CHECK_EQUAL((size_t)1, Moves.size());
+    CHECK_EQUAL(5u, Moves[0].Tag);
+    CHECK_EQUAL((size_t)0, Moves[0].DstOffset);
+    CHECK_EQUAL(C, Moves[0].SrcOffset);
+
+    // Once the copy completes the source is freed and the top half merges
+    Blocks.DeallocateBlock(Moves[0].SrcOffset, Moves[0].Order);
+    CHECK_EQUAL((size_t)8, Blocks.GetLargestFreeUnits());
+}
+
+// Compaction of a randomly fragmented heap must stay within budget, never overlap another live block
+// and only ever grow the largest free block
+TEST_CASE(BuddyCompactionNeverOverlaps)
+{
+    const uint32_t MaxOrder = 12;
+    const size_t TotalUnits = BuddyOrderAllocator::OrderToUnitSize(MaxOrder);
+    std::mt19937 Random(13);
+
+    for (int Trial = 0; Trial < 20; ++Trial)
+    {
+        BuddyOrderAllocator Blocks(MaxOrder);
+        std::vector<DefragBlock> Live;
+        for (uint32_t i = 0; i < 2000; ++i)
+        {
+            DefragBlock Block;
+            Block.Order = Random() % 4;
+            Block.Offset = Blocks.AllocateBlock(Block.Order);
+            Block.Tag = i;
+            if (Block.Offset != BuddyOrderAllocator::kInvalidOffset)
+                Live.push_back(Block);
+        }
+
+        // Free about two thirds, leaving holes throughout
+        std::vector<DefragBlock> Kept;
+        for (const DefragBlock& Block : Live)
+        {
+            if (Random() % 3 == 0)
+                Kept.push_back(Block);
+            else
+                Blocks.DeallocateBlock(Block.Offset, Block.Order);
+        }
+
+        std::vector<int> Owner(TotalUnits, -1);
+        for (const DefragBlock& Block : Kept)
+        {
+            for (size_t u = 0; u < BuddyOrderAllocator::OrderToUnitSize(Block.Order); ++u)
+                Owner[Block.Offset + u] = (int)Block.Tag;
+        }
+
+        const size_t LargestBefore = Blocks.GetLargestFreeUnits();
+        const size_t Budget = 64 + Random() % 512;
+        std::vector<DefragMove> Moves;
+        const size_t Scheduled = PlanBuddyCompaction(Blocks, Kept, Budget, Moves);
+        CHECK(Scheduled <= Budget);
+
+        size_t MovedUnits = 0;
+        for (const DefragMove& Move : Moves)
+        {
+            const size_t Size = BuddyOrderAllocator::OrderToUnitSize(Move.Order);
+            MovedUnits += Size;
+            CHECK(Move.DstOffset < Move.SrcOffset);
+            CHECK(Move.DstOffset % Size == 0);
+            CHECK(Owner[Move.SrcOffset] == (int)Move.Tag);
+            for (size_t u = 0; u < Size; ++u)
+            {
+                CHECK(Owner[Move.DstOffset + u] == -1);
+                Owner[Move.DstOffset + u] = (int)Move.Tag;
+            }
+        }
+        CHECK_EQUAL(Scheduled, MovedUnits);
+
+        for (const DefragMove& Move : Moves)
+            Blocks.DeallocateBlock(Move.SrcOffset, Move.Order);
+        CHECK(Blocks.GetLargestFreeUnits() >= LargestBefore);
+    }
+}
+
+TEST_CASE(TLSFOffsetAllocatorCoalesces)
+{
+    TLSFOffsetAllocator Ranges(1 << 20, 256);
+
+    const uint32_t A = Ranges.Allocate(1000);
+    const uint32_t B = Ranges.Allocate(5000);
+    const uint32_t C = Ranges.Allocate(300);
+    CHECK(A != TLSFOffsetAllocator::kInvalidNode);
+    CHECK(B != TLSFOffsetAllocator::kInvalidNode);
+    CHECK(C != TLSFOffsetAllocator::kInvalidNode);
+
+    CHECK_EQUAL((size_t)1024, Ranges.GetSize(A));
+    CHECK_EQUAL((size_t)0, Ranges.GetOffset(A));
+    CHECK_EQUAL((size_t)1024, Ranges.GetOffset(B));
+    CHECK_EQUAL((size_t)(1024 + 5120), Ranges.GetOffset(C));
+
+    // A failed allocation can be freed like any other
+    const uint32_t Failed = Ranges.Allocate(2 << 20);
+    CHECK_EQUAL(TLSFOffsetAllocator::kInvalidNode, Failed);
+    Ranges.Free(Failed);
+    CHECK_EQUAL((size_t)(1024 + 5120 + 512), Ranges.GetStats().AllocatedSize);
+
+    Ranges.Free(B);
+    Ranges.Free(A);
+    Ranges.Free(C);
+
+    SubAllocatorStats Stats = Ranges.GetStats();
+    CHECK_EQUAL((size_t)0, Stats.AllocatedSize);
+    CHECK_EQUAL((size_t)1, Stats.FreeBlockCount);
+    CHECK_EQUAL((size_t)(1 << 20), Stats.LargestFreeBlock);
+}
+
+TEST_CASE(TLSFOffsetAllocatorNeverOverlaps)
+{
+    const size_t TotalSize = 1 << 20;
+    TLSFOffsetAllocator Ranges(TotalSize, 64);
+    std::vector<uint32_t> Live;
+    std::mt19937 Random(11);
+
+    for (int Step = 0; Step < 20000; ++Step)
+    {
+        if (Live.empty() || Random() % 3 != 0)
+        {
+            const uint32_t Node = Ranges.Allocate(1 + Random() % 16384);
+            if (Node != TLSFOffsetAllocator::kInvalidNode)
+                Live.push_back(Node);
+        }
+        else
+        {
+            const size_t Index = Random() % Live.size();
+            Ranges.Free(Live[Index]);
+            Live[Index] = Live.back();
+            Live.pop_back();
+        }
+    }
+
+    // Sorted by offset, live ranges must not overlap and must fit
+    std::vector<std::pair<size_t, size_t> > Spans;
+    for (uint32_t Node : Live)
+        Spans.push_back(std::make_pair(Ranges.GetOffset(Node), Ranges.GetSize(Node)));
+    std::sort(Spans.begin(), Spans.end());
+    for (size_t i = 0; i < Spans.size(); ++i)
+    {
+        CHECK(Spans[i].first % 64 == 0);
+        CHECK(Spans[i].first + Spans[i].second <= TotalSize);
+        if (i > 0)
+            CHECK(Spans[i - 1].first + Spans[i - 1].second <= Spans[i].first);
+    }
+
+    for (uint32_t Node : Live)
+        Ranges.Free(Node);
+    CHECK_EQUAL((size_t)TotalSize, Ranges.GetStats().LargestFreeBlock);
+}
+
+namespace
+{
+    struct PooledObject
+    {
+        PooledObject() : InUse(false), Resets(0) {}
+        std::atomic<bool> InUse;
+        uint32_t Resets;
+    };
+
+    struct PooledObjectProvider
+    {
+        typedef PooledObject ObjectType;
+
+        ObjectType* Create( size_t ) { return new PooledObject; }
+        void Reset( ObjectType* Object ) { ++Object->Resets; }
+        void Destroy( ObjectType* Object ) { delete Object; }
+    };
+
+    typedef FencedObjectPool<PooledObjectProvider> TestObjectPool;
+}
+
+TEST_CASE(FencedObjectPoolRecyclesOutOfOrder)
+{
+    HostFence Fence;
+    TestObjectPool Pool;
+
+    PooledObject* A = Pool.Request(std::cref(Fence));
+    PooledObject* B = Pool.Request(std::cref(Fence));
+    CHECK(A != B);
+
+    // A retires behind a fence that won't complete; B behind one that will
+    const uint64_t EarlyFence = Fence.Signal();
+    const uint64_t LateFence = Fence.Signal();
+    Pool.Discard(LateFence, A, 2048);
+    Pool.Discard(EarlyFence, B, 2048);
+
+    // Nothing has completed, so a new object is created
+    PooledObject* C = Pool.Request(std::cref(Fence));
+    CHECK(C != A && C != B);
+
+    // B is ready even though A was retired first
+    Fence.Complete(EarlyFence);
+    PooledObject* D = Pool.Request(std::cref(Fence));
+    CHECK(D == B);
+    CHECK_EQUAL(1u, B->Resets);
+
+    const TestObjectPool::PoolStats Stats = Pool.GetStats();
+    CHECK_EQUAL((size_t)3, Stats.Created);
+    CHECK_EQUAL((size_t)1, Stats.Recycled);
+    CHECK_EQUAL((size_t)3, Stats.Live);
+}
+
+TEST_CASE(FencedObjectPoolTrimsOversized)
+{
+    HostFence Fence;
+    TestObjectPool Pool;
+
+    // Establish an average use of 2048
+    for (int i = 0; i < 16; ++i)
+    {
+        PooledObject* Object = Pool.Request(std::cref(Fence));
+        Pool.Discard(Fence.Signal(), Object, 2048);
+        Fence.Complete(Fence.Signal());
+    }
+    CHECK_EQUAL((size_t)1, Pool.GetStats().Created);
+
+    // One huge use marks the object for destruction once its fence completes
+    PooledObject* Huge = Pool.Request(std::cref(Fence));
+    const uint64_t HugeFence = Fence.Signal();
+    Pool.Discard(HugeFence, Huge, 2048 * TestObjectPool::kTrimFactor * 2);
+
+    Fence.Complete(HugeFence);
+    Pool.Request(std::cref(Fence));
+
+    const TestObjectPool::PoolStats Stats = Pool.GetStats();
+    CHECK_EQUAL((size_t)1, Stats.Trimmed);
+    CHECK_EQUAL((size_t)2, Stats.Created);
+    CHECK_EQUAL((size_t)1, Stats.Live);
+}
+
+TEST_CASE(FencedObjectPoolCapsIdleObjects)
+{
+    HostFence Fence;
+    TestObjectPool Pool;
+
+    const size_t kCount = TestObjectPool::kMaxIdlePerShard * 3;
+    std::vector<PooledObject*> Objects;
+    for (size_t i = 0; i < kCount; ++i)
+        Objects.push_back(Pool.Request(std::cref(Fence)));
+    for (PooledObject* Object : Objects)
+        Pool.Discard(Fence.Signal(), Object, 2048);
+
+    // One is handed out and kMaxIdlePerShard stay idle; the rest are destroyed
+    Fence.Complete(Fence.Signal());
+    Pool.Request(std::cref(Fence));
+
+    const TestObjectPool::PoolStats Stats = Pool.GetStats();
+    CHECK_EQUAL((size_t)(TestObjectPool::kMaxIdlePerShard + 1), Stats.Live);
+    CHECK_EQUAL(kCount - TestObjectPool::kMaxIdlePerShard - 1, Stats.Trimmed);
+}
+
+// Threads share one fence that lags a few submissions behind.  An object must never be handed to two
+// threads at once, and once the fence is moving most requests must be served by recycling.
+TEST_CASE(FencedObjectPoolThreadsNeverShare)
+{
+    const uint32_t kThreads = 8;
+    const uint32_t kRequestsPerThread = 20000;
+    const uint64_t kLag = 16;
+
+    HostFence Fence;
+    TestObjectPool Pool;
+    std::atomic<uint32_t> NumShared(0);
+
+    std::vector<std::thread> Workers;
+    for (uint32_t t = 0; t < kThreads; ++t)
+    {
+        Workers.push_back(std::thread([&]
+        {
+            for (uint32_t i = 0; i < kRequestsPerThread; ++i)
+            {
+                PooledObject* Object = Pool.Request(std::cref(Fence));
+                if (Object->InUse.exchange(true))
+                    ++NumShared;
+                Object->InUse.store(false);
+
+                const uint64_t FenceValue = Fence.Signal();
+                Pool.Discard(FenceValue, Object, 2048);
+                if (FenceValue > kLag)
+                    Fence.Complete(FenceValue - kLag);
+            }
+        }));
+    }
+    for (std::thread& Worker : Workers)
+        Worker.join();
+
+    const TestObjectPool::PoolStats Stats = Pool.GetStats();
+    CHECK_EQUAL(0u, NumShared.load());
+    CHECK_EQUAL((size_t)kThreads * kRequestsPerThread, Stats.Created + Stats.Recycled);
+    CHECK(Stats.Recycled > Stats.Created);
+    CHECK_EQUAL(Stats.Created - Stats.Trimmed, Stats.Live);
+}
+
+int main( int argc, char** argv )
+{
+    return TestHarness::RunTestCases(argc, argv);
+}
@@ -0,0 +1,22 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Benchmarks register themselves with TEST_CASE() in the other files of the target.  Pass --quick to
+// run shortened workloads, or part of a benchmark's name to run only matching ones.
+//
+
+#include "TestHarness.h"
+
+int main( int argc, char** argv )
+{
+    return TestHarness::RunTestCases(argc, argv);
+}
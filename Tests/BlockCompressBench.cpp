@@ -0,0 +1,303 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// PSNR and throughput of the built-in block compressor in BlockCompress.h on synthetic images.  Blocks
+// are decoded here following the D3D specification, independently of the encoder.
+//
+
+#include "TestHarness.h"
+#include "BlockCompress.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace BlockCompress;
+
+namespace
+{
+    const uint32_t kImageSize = 512;
+
+    uint32_t ReadBits( const uint8_t* block, uint32_t start, uint32_t count )
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i)
+            value |= (uint32_t)(block[(start + i) / 8] >> ((start + i) % 8) & 1) << i;
+        return value;
+    }
+
+    // Colors in rgba[16][4]; alpha is set to 255
+    void DecodeBC1( const uint8_t* block, uint8_t rgba[16][4], bool alwaysFourColor )
+    {
+        const uint32_t c0 = block[0] | block[1] << 8;
+        const uint32_t c1 = block[2] | block[3] << 8;
+
+        uint32_t palette[4][3];
+        const uint32_t colors[2] = { c0, c1 };
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            const uint32_t r = colors[i] >> 11 & 31, g = colors[i] >> 5 & 63, b = colors[i] & 31;
+            palette[i][0] = r << 3 | r >> 2;
+            palette[i][1] = g << 2 | g >> 4;
+            palette[i][2] = b << 3 | b >> 2;
+        }
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            if (c0 > c1 || alwaysFourColor)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t index = ReadBits(block, 32 + 2 * i, 2);
+            for (uint32_t c = 0; c < 3; ++c)
+                rgba[i][c] = (uint8_t)palette[index][c];
+            rgba[i][3] = 255;
+        }
+    }
+
+    void DecodeBC4( const uint8_t* block, uint8_t rgba[16][4], uint32_t channel )
+    {
+        const uint32_t a0 = block[0], a1 = block[1];
+        uint32_t palette[8] = { a0, a1 };
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        for (uint32_t i = 0; i < 16; ++i)
+            rgba[i][channel] = (uint8_t)palette[ReadBits(block, 16 + 3 * i, 3)];
+    }
+
+    // Mode 6 only, which is all the encoder writes.  Returns false for any other mode.
+    bool DecodeBC7( const uint8_t* block, uint8_t rgba[16][4] )
+    {
+        if (ReadBits(block, 0, 7) != 0x40)
+            return false;
+
+        static const uint32_t kWeights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        uint32_t endpoints[2][4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            endpoints[0][c] = ReadBits(block, 7 + c * 14, 7) << 1 | ReadBits(block, 63, 1);
+            endpoints[1][c] = ReadBits(block, 14 + c * 14, 7) << 1 | ReadBits(block, 64, 1);
+        }
+
+        // The first index drops its implied zero high bit
+        uint32_t bit = 65;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t width = i == 0 ? 3 : 4;
+            const uint32_t w = kWeights[ReadBits(block, bit, width)];
+            bit += width;
+            for (uint32_t c = 0; c < 4; ++c)
+                rgba[i][c] = (uint8_t)(((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6);
+        }
+        return true;
+    }
+
+    bool DecodeBlock( Format format, const uint8_t* block, uint8_t rgba[16][4] )
+    {
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            rgba[i][0] = rgba[i][1] = rgba[i][2] = 0;
+            rgba[i][3] = 255;
+        }
+
+        switch (format)
+        {
+        case kBC1: DecodeBC1(block, rgba, false); return true;
+        case kBC3: DecodeBC1(block + 8, rgba, true); DecodeBC4(block, rgba, 3); return true;
+        case kBC4: DecodeBC4(block, rgba, 0); return true;
+        case kBC5: DecodeBC4(block, rgba, 0); DecodeBC4(block + 8, rgba, 1); return true;
+        case kBC7: return DecodeBC7(block, rgba);
+        }
+        return false;
+    }
+
+    // The channels each format stores
+    uint32_t ChannelCount( Format format )
+    {
+        switch (format)
+        {
+        case kBC1: return 3;
+        case kBC4: return 1;
+        case kBC5: return 2;
+        default:   return 4;
+        }
+    }
+
+    // Smooth gradients with a little noise, as in photographs and albedo maps, under a few hard edged
+    // shapes, as in decals and UI.  Alpha is a soft radial falloff.
+    std::vector<uint8_t> MakeTestImage( void )
+    {
+        std::vector<uint8_t> image(kImageSize * kImageSize * 4);
+        std::mt19937 random(5);
+        for (uint32_t y = 0; y < kImageSize; ++y)
+        {
+            for (uint32_t x = 0; x < kImageSize; ++x)
+            {
+                const float u = (float)x / kImageSize, v = (float)y / kImageSize;
+                float color[3] =
+                {
+                    128.0f + 100.0f * std::sin(u * 6.0f + v * 2.0f),
+                    128.0f + 100.0f * std::cos(v * 5.0f - u * 3.0f),
+                    255.0f * u * v,
+                };
+
+                const bool inSquare = ((x / 64) + (y / 64)) % 5 == 0;
+                const bool inCircle = (u - 0.6f) * (u - 0.6f) + (v - 0.4f) * (v - 0.4f) < 0.02f;
+                if (inSquare)
+                {
+                    color[0] = 240.0f; color[1] = 32.0f; color[2] = 16.0f;
+                }
+                else if (inCircle)
+                {
+                    color[0] = 20.0f; color[1] = 60.0f; color[2] = 220.0f;
+                }
+
+                const float dx = u - 0.5f, dy = v - 0.5f;
+                const float alpha = 255.0f * (std::max)(0.0f, 1.0f - 2.0f * std::sqrt(dx * dx + dy * dy));
+
+                uint8_t* pixel = &image[(y * kImageSize + x) * 4];
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    const float noisy = color[c] + (float)(random() % 9) - 4.0f;
+                    pixel[c] = (uint8_t)(std::min)(255.0f, (std::max)(0.0f, noisy));
+                }
+                pixel[3] = (uint8_t)alpha;
+            }
+        }
+        return image;
+    }
+
+    // Decodes every block and compares the channels the format stores with the source
+    double MeasurePSNR( Format format, const std::vector<uint8_t>& image, const std::vector<uint8_t>& blocks )
+    {
+        const uint32_t blocksWide = kImageSize / 4;
+        const uint32_t channels = ChannelCount(format);
+
+        double errorSum = 0.0;
+        for (uint32_t by = 0; by < blocksWide; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocksWide; ++bx)
+            {
+                uint8_t decoded[16][4];
+                if (!DecodeBlock(format, &blocks[(by * blocksWide + bx) * BlockSize(format)], decoded))
+                    return 0.0;
+
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    const uint8_t* source = &image[((by * 4 + i / 4) * kImageSize + bx * 4 + i % 4) * 4];
+                    for (uint32_t c = 0; c < channels; ++c)
+                    {
+                        const double d = (double)source[c] - decoded[i][c];
+                        errorSum += d * d;
+                    }
+                }
+            }
+        }
+
+        const double mse = errorSum / ((double)kImageSize * kImageSize * channels);
+        return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    double CompressAndReport( const char* name, Format format, Quality quality, const std::vector<uint8_t>& image )
+    {
+        const uint32_t blocksWide = kImageSize / 4;
+        std::vector<uint8_t> blocks(blocksWide * blocksWide * BlockSize(format));
+
+        // Single threaded, as texture conversion runs it
+        const uint32_t repeats = TestHarness::IsQuickRun() ? 1 : 4;
+        TestHarness::Timer timer;
+        for (uint32_t i = 0; i < repeats; ++i)
+        {
+            CompressImage(format, image.data(), kImageSize * 4, kImageSize, kImageSize,
+                blocks.data(), blocksWide * BlockSize(format), quality, 1);
+        }
+        const double seconds = timer.Elapsed();
+
+        const double psnr = MeasurePSNR(format, image, blocks);
+        std::printf("  %-28s %8.2f dB %8.2f MPix/s\n", name, psnr,
+            (double)repeats * kImageSize * kImageSize / seconds * 1e-6);
+        return psnr;
+    }
+}
+
+// Quality floors are well below the measured values and only catch an encoder that has broken
+TEST_CASE(BlockCompressQuality)
+{
+    const std::vector<uint8_t> image = MakeTestImage();
+
+    struct Case { const char* name; Format format; Quality quality; double minPSNR; };
+    static const Case kCases[] =
+    {
+        { "BC1 fast",    kBC1, kFast,   34.0 },
+        { "BC1 normal",  kBC1, kNormal, 35.0 },
+        { "BC1 high",    kBC1, kHigh,   35.0 },
+        { "BC3 fast",    kBC3, kFast,   34.0 },
+        { "BC3 normal",  kBC3, kNormal, 35.0 },
+        { "BC3 high",    kBC3, kHigh,   35.0 },
+        { "BC4 fast",    kBC4, kFast,   48.0 },
+        { "BC4 normal",  kBC4, kNormal, 48.0 },
+        { "BC4 high",    kBC4, kHigh,   48.0 },
+        { "BC5 fast",    kBC5, kFast,   48.0 },
+        { "BC5 normal",  kBC5, kNormal, 48.0 },
+        { "BC5 high",    kBC5, kHigh,   48.0 },
+        { "BC7 fast",    kBC7, kFast,   36.0 },
+        { "BC7 normal",  kBC7, kNormal, 38.0 },
+        { "BC7 high",    kBC7, kHigh,   38.0 },
+    };
+
+    for (const Case& c : kCases)
+        CHECK(CompressAndReport(c.name, c.format, c.quality, image) >= c.minPSNR);
+}
+
+// The same image compressed with every core, for comparison with the single threaded rates above
+TEST_CASE(BlockCompressThreads)
+{
+    const std::vector<uint8_t> image = MakeTestImage();
+    const uint32_t blocksWide = kImageSize / 4;
+    std::vector<uint8_t> single(blocksWide * blocksWide * 16), parallel(single.size());
+
+    TestHarness::Timer singleTimer;
+    CompressImage(kBC7, image.data(), kImageSize * 4, kImageSize, kImageSize, single.data(), blocksWide * 16, kNormal, 1);
+    const double singleSeconds = singleTimer.Elapsed();
+
+    TestHarness::Timer parallelTimer;
+    CompressImage(kBC7, image.data(), kImageSize * 4, kImageSize, kImageSize, parallel.data(), blocksWide * 16, kNormal, 0);
+    const double parallelSeconds = parallelTimer.Elapsed();
+
+    const double pixels = (double)kImageSize * kImageSize;
+    std::printf("  %-28s %8.2f MPix/s\n", "BC7 normal, one thread", pixels / singleSeconds * 1e-6);
+    std::printf("  %-28s %8.2f MPix/s\n", "BC7 normal, every core", pixels / parallelSeconds * 1e-6);
+
+    // Blocks are independent, so the thread count mustn't change the output
+    CHECK(single == parallel);
+}
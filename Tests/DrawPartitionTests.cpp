@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Checks of how MeshSorter splits a pass across command lists and which targets each pass binds.
+//
+
+#include "TestHarness.h"
+#include "DrawPartition.h"
+
+using namespace Renderer;
+
+namespace
+{
+    const uint32_t kZPass = 0, kOpaque = 1, kTransparent = 2;
+
+    // Chunks must tile the range in order with no gaps
+    bool CoversInOrder( const DrawChunk* Chunks, uint32_t NumChunks, uint32_t FirstDraw, uint32_t NumDraws )
+    {
+        uint32_t Next = FirstDraw;
+        for (uint32_t i = 0; i < NumChunks; ++i)
+        {
+            if (Chunks[i].firstDraw != Next || Chunks[i].numDraws == 0)
+                return false;
+            Next += Chunks[i].numDraws;
+        }
+        return Next == FirstDraw + NumDraws;
+    }
+}
+
+TEST_CASE(PartitionDrawsEmptyRange)
+{
+    DrawChunk Chunks[8];
+    CHECK_EQUAL(0u, PartitionDraws(5, 0, 8, 16, Chunks));
+    CHECK_EQUAL(0u, PartitionDraws(5, 100, 0, 16, Chunks));
+}
+
+TEST_CASE(PartitionDrawsSmallRangeIsOneChunk)
+{
+    DrawChunk Chunks[8];
+    CHECK_EQUAL(1u, PartitionDraws(10, 15, 8, 16, Chunks));
+    CHECK_EQUAL(10u, Chunks[0].firstDraw);
+    CHECK_EQUAL(15u, Chunks[0].numDraws);
+}
+
+TEST_CASE(PartitionDrawsHonorsMinimumChunkSize)
+{
+    DrawChunk Chunks[8];
+    const uint32_t NumChunks = PartitionDraws(0, 50, 8, 16, Chunks);
+    CHECK_EQUAL(3u, NumChunks);
+    CHECK(CoversInOrder(Chunks, NumChunks, 0, 50));
+    for (uint32_t i = 0; i < NumChunks; ++i)
+        CHECK(Chunks[i].numDraws >= 16);
+
+    // Zero is treated as one draw per chunk
+    CHECK_EQUAL(4u, PartitionDraws(0, 4, 8, 0, Chunks));
+    CHECK(CoversInOrder(Chunks, 4, 0, 4));
+}
+
+TEST_CASE(PartitionDrawsBalancesAndCapsChunks)
+{
+    DrawChunk Chunks[8];
+    for (uint32_t NumDraws = 1; NumDraws < 2000; NumDraws += 7)
+    {
+        const uint32_t NumChunks = PartitionDraws(3, NumDraws, 8, 16, Chunks);
+        CHECK(NumChunks >= 1 && NumChunks <= 8);
+        CHECK(CoversInOrder(Chunks, NumChunks, 3, NumDraws));
+
+        uint32_t Smallest = ~0u, Largest = 0;
+        for (uint32_t i = 0; i < NumChunks; ++i)
+        {
+            Smallest = Chunks[i].numDraws < Smallest ? Chunks[i].numDraws : Smallest;
+            Largest = Chunks[i].numDraws > Largest ? Chunks[i].numDraws : Largest;
+        }
+        CHECK(Largest - Smallest <= 1);
+    }
+}
+
+TEST_CASE(PassBindingsForShadows)
+{
+    // Shadow batches write depth only, whatever the pass
+    for (uint32_t Pass = kZPass; Pass <= kTransparent; ++Pass)
+    {
+        const PassBindings Bindings = SelectPassBindings(true, Pass, true);
+        CHECK(!Bindings.bindColor);
+        CHECK(!Bindings.depthReadOnly);
+    }
+}
+
+TEST_CASE(PassBindingsForDefaultBatch)
+{
+    PassBindings Bindings = SelectPassBindings(false, kZPass, true);
+    CHECK(!Bindings.bindColor);
+    CHECK(!Bindings.depthReadOnly);
+
+    // Opaque writes depth itself unless a Z prepass already did
+    Bindings = SelectPassBindings(false, kOpaque, false);
+    CHECK(Bindings.bindColor);
+    CHECK(!Bindings.depthReadOnly);
+
+    Bindings = SelectPassBindings(false, kOpaque, true);
+    CHECK(Bindings.bindColor);
+    CHECK(Bindings.depthReadOnly);
+
+    // Transparent never writes depth
+    Bindings = SelectPassBindings(false, kTransparent, false);
+    CHECK(Bindings.bindColor);
+    CHECK(Bindings.depthReadOnly);
+}
+
+int main( int argc, char** argv )
+{
+    return TestHarness::RunTestCases(argc, argv);
+}
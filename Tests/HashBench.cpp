@@ -0,0 +1,195 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Collisions and throughput of the state hashes in Hash.h, next to the single-lane CRC32 and the
+// multiply-xor hash they replaced.  Descriptions mimic pipeline and sampler state: long runs of
+// identical words with a few small enumerants and flags that differ.
+//
+
+#include "TestHarness.h"
+#include "Hash.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Utility;
+
+namespace
+{
+    typedef uint64_t (*HashFunc)( const uint32_t*, const uint32_t*, uint64_t );
+
+    // The previous fallback for CPUs without SSE4.2
+    uint64_t HashRangeMultiplyXor( const uint32_t* Begin, const uint32_t* End, uint64_t Hash )
+    {
+        for (const uint32_t* Iter = Begin; Iter < End; ++Iter)
+            Hash = 16777619U * Hash ^ *Iter;
+        return Hash;
+    }
+
+#if ENABLE_HW_CRC32
+    // The previous hash: one CRC32 lane, so only 32 bits of result
+    HW_CRC32_TARGET uint64_t HashRangeSingleCRC( const uint32_t* Begin, const uint32_t* End, uint64_t Hash )
+    {
+        const uint8_t* Iter = (const uint8_t*)Begin;
+        for (; (const uint8_t*)End - Iter >= 8; Iter += 8)
+            Hash = HW_CRC32_U64(Hash, HashImpl::Read64(Iter));
+        if ((const uint8_t*)End - Iter >= 4)
+            Hash = HW_CRC32_U32((uint32_t)Hash, HashImpl::Read32(Iter));
+        return Hash;
+    }
+#endif
+
+    struct NamedHash
+    {
+        const char* Name;
+        HashFunc Func;
+    };
+
+    std::vector<NamedHash> GetHashes( void )
+    {
+        std::vector<NamedHash> Hashes;
+        Hashes.push_back(NamedHash{ "portable", HashImpl::HashRangePortable });
+#if ENABLE_HW_CRC32
+        if (HashImpl::CPUSupportsCRC32C())
+        {
+            Hashes.push_back(NamedHash{ "two-lane CRC32C", HashImpl::HashRangeCRC });
+            Hashes.push_back(NamedHash{ "old single CRC32C", HashRangeSingleCRC });
+        }
+#endif
+        Hashes.push_back(NamedHash{ "old multiply-xor", HashRangeMultiplyXor });
+        return Hashes;
+    }
+
+    // Sized like D3D12_GRAPHICS_PIPELINE_STATE_DESC without its pointers
+    const uint32_t kDescWords = 150;
+
+    // Every description differs, but only in a few words and only by small values
+    std::vector<uint32_t> MakeStructuredDescs( uint32_t Count )
+    {
+        std::vector<uint32_t> Descs((size_t)Count * kDescWords, 0);
+        for (uint32_t i = 0; i < Count; ++i)
+        {
+            uint32_t* Desc = &Descs[(size_t)i * kDescWords];
+            for (uint32_t w = 0; w < kDescWords; ++w)
+                Desc[w] = w % 7 == 0 ? 1 : 0;
+
+            // Spread the index over enumerant-sized fields: formats, blend ops, sample counts, masks
+            Desc[4] = i & 0x7;
+            Desc[20] = i >> 3 & 0x3F;
+            Desc[33] = i >> 9 & 0xF;
+            Desc[90] = i >> 13 & 0x3;
+            Desc[140] = 0xF << (i >> 15 & 0x3);
+            Desc[149] = i >> 17;
+        }
+        return Descs;
+    }
+
+    std::vector<uint32_t> MakeRandomDescs( uint32_t Count )
+    {
+        std::vector<uint32_t> Descs((size_t)Count * kDescWords);
+        std::mt19937 Random(3);
+        for (uint32_t& Word : Descs)
+            Word = Random();
+        return Descs;
+    }
+
+    // Counts hashes equal to an earlier one, over all 64 bits and over the low 32 bits, which is all
+    // a hash table of fewer than four billion buckets uses
+    void CountCollisions( HashFunc Func, const std::vector<uint32_t>& Descs, size_t& Full, size_t& Low )
+    {
+        const size_t Count = Descs.size() / kDescWords;
+        std::vector<uint64_t> Hashes(Count), LowHashes(Count);
+        for (size_t i = 0; i < Count; ++i)
+        {
+            const uint32_t* Desc = &Descs[i * kDescWords];
+            Hashes[i] = Func(Desc, Desc + kDescWords, 2166136261U);
+            LowHashes[i] = (uint32_t)Hashes[i];
+        }
+
+        std::sort(Hashes.begin(), Hashes.end());
+        std::sort(LowHashes.begin(), LowHashes.end());
+        Full = Count - (size_t)(std::unique(Hashes.begin(), Hashes.end()) - Hashes.begin());
+        Low = Count - (size_t)(std::unique(LowHashes.begin(), LowHashes.end()) - LowHashes.begin());
+    }
+
+    void ReportCollisions( const char* Title, const std::vector<uint32_t>& Descs, bool RequireUnique )
+    {
+        const double Count = (double)(Descs.size() / kDescWords);
+        std::printf("  %s, %.0f descriptions, about %.1f low 32-bit collisions expected\n",
+            Title, Count, Count * Count / 8589934592.0);
+
+        for (const NamedHash& Hash : GetHashes())
+        {
+            size_t Full, Low;
+            CountCollisions(Hash.Func, Descs, Full, Low);
+            std::printf("  %-28s %8zu full %8zu low\n", Hash.Name, Full, Low);
+
+            // The current hashes must keep every description apart
+            if (RequireUnique && Hash.Func != HashRangeMultiplyXor)
+            {
+#if ENABLE_HW_CRC32
+                if (Hash.Func != HashRangeSingleCRC)
+#endif
+                    CHECK_EQUAL((size_t)0, Full);
+            }
+        }
+    }
+}
+
+TEST_CASE(HashCollisions)
+{
+    const uint32_t Count = TestHarness::IsQuickRun() ? 1 << 16 : 1 << 20;
+    ReportCollisions("structured", MakeStructuredDescs(Count), true);
+    ReportCollisions("random", MakeRandomDescs(Count), true);
+}
+
+TEST_CASE(HashThroughput)
+{
+    // A sampler, a small root signature, a graphics PSO and a large root signature
+    const uint32_t kSizes[] = { 13, 32, kDescWords, 1024 };
+    const double kBytesPerSize = TestHarness::IsQuickRun() ? 16e6 : 1e9;
+
+    std::vector<uint32_t> Words(1024);
+    std::mt19937 Random(4);
+    for (uint32_t& Word : Words)
+        Word = Random();
+
+    for (uint32_t Size : kSizes)
+    {
+        std::printf("  %u bytes\n", Size * 4);
+        const uint64_t Repeats = (uint64_t)(kBytesPerSize / (Size * 4));
+        for (const NamedHash& Hash : GetHashes())
+        {
+            // Chain the hashes so that calls can't be elided or overlapped
+            uint64_t Value = 0;
+            TestHarness::Timer Timer;
+            for (uint64_t i = 0; i < Repeats; ++i)
+            {
+                Words[0] = (uint32_t)Value;
+                Value = Hash.Func(Words.data(), Words.data() + Size, Value);
+            }
+            const double Seconds = Timer.Elapsed();
+
+            std::printf("  %-28s %8.2f GB/s %8.1f ns/hash\n", Hash.Name,
+                Repeats * Size * 4.0 / Seconds * 1e-9, Seconds / Repeats * 1e9);
+            CHECK(Value != 0);
+        }
+    }
+
+    // The dispatched entry point must agree with whichever path it picked
+    const uint64_t Dispatched = HashRange(Words.data(), Words.data() + 32, 7);
+    bool Matches = Dispatched == HashImpl::HashRangePortable(Words.data(), Words.data() + 32, 7);
+#if ENABLE_HW_CRC32
+    Matches = Matches || Dispatched == HashImpl::HashRangeCRC(Words.data(), Words.data() + 32, 7);
+#endif
+    CHECK(Matches);
+}
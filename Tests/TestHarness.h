@@ -0,0 +1,127 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// A minimal test runner for the device-independent parts of the engine, so that they can be checked
+// on machines without D3D12.  TEST_CASE() registers a function; RunTestCases() runs every registered
+// case whose name contains the filter given on the command line.  Benchmarks register the same way
+// and read IsQuickRun() to shrink their workloads when run as a smoke test.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace TestHarness
+{
+    typedef void (*TestFunc)( void );
+
+    struct TestCase
+    {
+        const char* Name;
+        TestFunc Func;
+    };
+
+    inline std::vector<TestCase>& GetTestCases( void )
+    {
+        static std::vector<TestCase> s_TestCases;
+        return s_TestCases;
+    }
+
+    inline int& GetFailureCount( void )
+    {
+        static int s_Failures = 0;
+        return s_Failures;
+    }
+
+    inline bool& QuickRunFlag( void )
+    {
+        static bool s_Quick = false;
+        return s_Quick;
+    }
+
+    inline bool IsQuickRun( void ) { return QuickRunFlag(); }
+
+    struct Registrar
+    {
+        Registrar( const char* Name, TestFunc Func )
+        {
+            TestCase Case = { Name, Func };
+            GetTestCases().push_back(Case);
+        }
+    };
+
+    inline void ReportFailure( const char* File, int Line, const char* Expr )
+    {
+        std::printf("  FAILED %s(%d): %s\n", File, Line, Expr);
+        ++GetFailureCount();
+    }
+
+    // Seconds elapsed since construction
+    class Timer
+    {
+    public:
+        Timer() : m_Start(std::chrono::steady_clock::now()) {}
+
+        double Elapsed( void ) const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_Start;
+    };
+
+    // Arguments are an optional name filter and --quick.  Returns the process exit code.
+    inline int RunTestCases( int argc, char** argv )
+    {
+        const char* Filter = nullptr;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--quick") == 0)
+                QuickRunFlag() = true;
+            else
+                Filter = argv[i];
+        }
+
+        int NumRun = 0;
+        for (const TestCase& Case : GetTestCases())
+        {
+            if (Filter != nullptr && std::strstr(Case.Name, Filter) == nullptr)
+                continue;
+
+            const int FailuresBefore = GetFailureCount();
+            std::printf("[ RUN  ] %s\n", Case.Name);
+            std::fflush(stdout);
+            Case.Func();
+            std::printf("[ %s ] %s\n", GetFailureCount() == FailuresBefore ? " OK " : "FAIL", Case.Name);
+            ++NumRun;
+        }
+
+        std::printf("%d case(s), %d failure(s)\n", NumRun, GetFailureCount());
+        return GetFailureCount() == 0 ? 0 : 1;
+    }
+
+} // namespace TestHarness
+
+#define TEST_CASE(Name) \
+    static void Name( void ); \
+    static TestHarness::Registrar Name##_Registrar(#Name, Name); \
+    static void Name( void )
+
+#define CHECK(Expr) \
+    do { if (!(Expr)) TestHarness::ReportFailure(__FILE__, __LINE__, #Expr); } while (0)
+
+#define CHECK_EQUAL(Expected, Actual) \
+    do { if (!((Expected) == (Actual))) TestHarness::ReportFailure(__FILE__, __LINE__, #Expected " == " #Actual); } while (0)
@@ -0,0 +1,254 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard
+//
+// Checks of the mip requests and residency plans the TextureManager streams textures with.
+//
+
+#include "TestHarness.h"
+#include "TextureStreamingCore.h"
+
+using namespace StreamingCore;
+
+namespace
+{
+    // RGBA8 memory for the chain starting at Mip
+    uint64_t ChainBytes( uint32_t Width, uint32_t Height, uint32_t MipCount, uint32_t Mip )
+    {
+        uint64_t Bytes = 0;
+        for (; Mip < MipCount; ++Mip)
+            Bytes += (uint64_t)(std::max)(Width >> Mip, 1u) * (std::max)(Height >> Mip, 1u) * 4;
+        return Bytes;
+    }
+
+    TextureState MakeTexture( uint32_t Width, uint32_t Height, uint32_t MipCount )
+    {
+        return MakeTextureState(Width, Height, MipCount,
+            [=]( uint32_t Mip ) { return ChainBytes(Width, Height, MipCount, Mip); });
+    }
+
+    // A 1024x1024 texture with its full chain.  The tail starts at mip 3.
+    TextureState MakeSquare( void )
+    {
+        return MakeTexture(1024, 1024, 11);
+    }
+
+    TextureState Request( TextureState State, uint32_t Mip, float Priority )
+    {
+        State.RequestedMip = Mip;
+        State.Priority = Priority;
+        return State;
+    }
+
+    TextureState Resident( TextureState State, uint32_t Mip )
+    {
+        State.ResidentMip = Mip;
+        State.PendingMip = Mip;
+        return State;
+    }
+
+    const uint64_t kNoUploadLimit = ~0ull;
+
+    bool HasChange( const std::vector<Change>& Changes, uint32_t Index, uint32_t NewMip )
+    {
+        for (const Change& C : Changes)
+        {
+            if (C.Index == Index && C.NewMip == NewMip)
+                return true;
+        }
+        return false;
+    }
+}
+
+TEST_CASE(MipForScreenSizeMatchesTexelDensity)
+{
+    CHECK_EQUAL(0u, MipForScreenSize(1024, 1024, 11, 2000.0f));
+    CHECK_EQUAL(0u, MipForScreenSize(1024, 1024, 11, 1024.0f));
+    CHECK_EQUAL(0u, MipForScreenSize(1024, 1024, 11, 1000.0f));
+    CHECK_EQUAL(1u, MipForScreenSize(1024, 1024, 11, 512.0f));
+    CHECK_EQUAL(3u, MipForScreenSize(1024, 1024, 11, 100.0f));
+
+    // The larger dimension decides
+    CHECK_EQUAL(2u, MipForScreenSize(256, 1024, 11, 256.0f));
+
+    // Tiny or offscreen surfaces get the smallest mip, and requests never pass the end of the chain
+    CHECK_EQUAL(10u, MipForScreenSize(1024, 1024, 11, 0.5f));
+    CHECK_EQUAL(10u, MipForScreenSize(1024, 1024, 11, 0.0f));
+    CHECK_EQUAL(3u, MipForScreenSize(1024, 1024, 4, 10.0f));
+}
+
+TEST_CASE(MakeTextureStateStartsAtTail)
+{
+    TextureState Square = MakeSquare();
+    CHECK_EQUAL(11u, Square.MipCount);
+    CHECK_EQUAL(3u, Square.TailMip);
+    CHECK_EQUAL(3u, Square.ResidentMip);
+    CHECK_EQUAL(3u, Square.RequestedMip);
+    CHECK_EQUAL(3u, Square.PendingMip);
+    CHECK(!Square.Busy);
+    CHECK(Square.Priority == 0.0f);
+    for (uint32_t Mip = 0; Mip < Square.MipCount; ++Mip)
+        CHECK_EQUAL(ChainBytes(1024, 1024, 11, Mip), Square.Bytes[Mip]);
+    CHECK_EQUAL(Square.Bytes[3], Square.ResidentBytes());
+
+    // Both dimensions must fit in the tail
+    CHECK_EQUAL(4u, MakeTexture(2048, 256, 12).TailMip);
+
+    // Small textures are all tail
+    CHECK_EQUAL(0u, MakeTexture(64, 64, 7).TailMip);
+
+    // Chains longer than the state can describe are cut short
+    CHECK_EQUAL((uint32_t)kMaxMips, MakeTexture(65536, 65536, 17).MipCount);
+}
+
+TEST_CASE(PlanGrantsRequestsByPriority)
+{
+    const TextureState Square = MakeSquare();
+    const uint64_t Tail = Square.Bytes[3];
+
+    // Room for one full chain and one chain from mip 1 on top of the tails
+    std::vector<TextureState> Textures;
+    Textures.push_back(Request(Square, 0, 1.0f));
+    Textures.push_back(Request(Square, 0, 3.0f));
+    Textures.push_back(Request(Square, 0, 2.0f));
+    const uint64_t Budget = Square.Bytes[0] + Square.Bytes[1] + Tail;
+
+    ResidencyPlanner Planner;
+    std::vector<Change> Changes;
+    Planner.Plan(Textures, Budget, kNoUploadLimit, Changes);
+
+    CHECK_EQUAL((size_t)2, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].Index);
+    CHECK_EQUAL(0u, Changes[0].NewMip);
+    CHECK_EQUAL(2u, Changes[1].Index);
+    CHECK_EQUAL(1u, Changes[1].NewMip);
+}
+
+TEST_CASE(PlanDemotesToStayInBudget)
+{
+    const TextureState Square = MakeSquare();
+    const uint64_t Tail = Square.Bytes[3];
+
+    // The unrequested texture holds the memory the requested one needs
+    std::vector<TextureState> Textures;
+    Textures.push_back(Resident(Square, 0));
+    Textures.push_back(Request(Square, 0, 1.0f));
+    Textures.push_back(Resident(Request(Square, 3, 0.5f), 1));
+
+    ResidencyPlanner Planner;
+    std::vector<Change> Changes;
+    Planner.Plan(Textures, Square.Bytes[0] + 2 * Tail, kNoUploadLimit, Changes);
+
+    // Demotions come before promotions
+    CHECK_EQUAL((size_t)3, Changes.size());
+    CHECK(HasChange(Changes, 0, 3));
+    CHECK(HasChange(Changes, 2, 3));
+    CHECK_EQUAL(1u, Changes[2].Index);
+    CHECK_EQUAL(0u, Changes[2].NewMip);
+
+    // A budget smaller than the tails still keeps the tails, and every request is cut to them
+    Planner.Plan(Textures, Tail, kNoUploadLimit, Changes);
+    CHECK_EQUAL((size_t)2, Changes.size());
+    CHECK(HasChange(Changes, 0, 3));
+    CHECK(HasChange(Changes, 2, 3));
+}
+
+TEST_CASE(PlanKeepsUnrequestedMipsWhileThereIsRoom)
+{
+    const TextureState Square = MakeSquare();
+
+    std::vector<TextureState> Textures;
+    Textures.push_back(Resident(Square, 1));
+    Textures.push_back(Request(Square, 0, 1.0f));
+
+    ResidencyPlanner Planner;
+    std::vector<Change> Changes;
+    Planner.Plan(Textures, Square.Bytes[0] + Square.Bytes[1], kNoUploadLimit, Changes);
+    CHECK_EQUAL((size_t)1, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].Index);
+    CHECK_EQUAL(0u, Changes[0].NewMip);
+
+    // One byte short, the unrequested texture drops to its tail rather than the requested one
+    // being cut
+    Planner.Plan(Textures, Square.Bytes[0] + Square.Bytes[1] - 1, kNoUploadLimit, Changes);
+    CHECK_EQUAL((size_t)2, Changes.size());
+    CHECK_EQUAL(0u, Changes[0].Index);
+    CHECK_EQUAL(3u, Changes[0].NewMip);
+    CHECK_EQUAL(1u, Changes[1].Index);
+    CHECK_EQUAL(0u, Changes[1].NewMip);
+}
+
+TEST_CASE(PlanCapsUploadsPerUpdate)
+{
+    const TextureState Square = MakeSquare();
+    const uint64_t Upload = Square.Bytes[0] - Square.Bytes[3];
+
+    std::vector<TextureState> Textures;
+    Textures.push_back(Request(Square, 0, 1.0f));
+    Textures.push_back(Request(Square, 0, 3.0f));
+    Textures.push_back(Request(Square, 0, 2.0f));
+
+    ResidencyPlanner Planner;
+    std::vector<Change> Changes;
+    Planner.Plan(Textures, ~0ull, 2 * Upload, Changes);
+    CHECK_EQUAL((size_t)2, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].Index);
+    CHECK_EQUAL(2u, Changes[1].Index);
+
+    // The best promotion always goes, however small the cap
+    Planner.Plan(Textures, ~0ull, 1, Changes);
+    CHECK_EQUAL((size_t)1, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].Index);
+
+    // Demotions are never held back by the cap
+    Textures.push_back(Resident(Square, 0));
+    Planner.Plan(Textures, 3 * Square.Bytes[3] + Square.Bytes[0], 1, Changes);
+    CHECK_EQUAL((size_t)2, Changes.size());
+    CHECK_EQUAL(3u, Changes[0].Index);
+    CHECK_EQUAL(3u, Changes[0].NewMip);
+    CHECK_EQUAL(1u, Changes[1].Index);
+    CHECK_EQUAL(0u, Changes[1].NewMip);
+}
+
+TEST_CASE(PlanPricesBusyTexturesAtTheLargerMip)
+{
+    const TextureState Square = MakeSquare();
+
+    // A promotion to mip 0 is in flight
+    TextureState Loading = Request(Square, 0, 2.0f);
+    Loading.Busy = true;
+    Loading.PendingMip = 0;
+
+    std::vector<TextureState> Textures;
+    Textures.push_back(Loading);
+    Textures.push_back(Request(Square, 0, 1.0f));
+
+    ResidencyPlanner Planner;
+    std::vector<Change> Changes;
+    Planner.Plan(Textures, 2 * Square.Bytes[0] - 1, kNoUploadLimit, Changes);
+    CHECK_EQUAL((size_t)1, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].Index);
+    CHECK_EQUAL(1u, Changes[0].NewMip);
+
+    // A demotion in flight still costs the mip it is leaving
+    TextureState Unloading = Resident(Square, 0);
+    Unloading.Busy = true;
+    Unloading.PendingMip = 3;
+    Textures[0] = Unloading;
+    Planner.Plan(Textures, 2 * Square.Bytes[0] - 1, kNoUploadLimit, Changes);
+    CHECK_EQUAL((size_t)1, Changes.size());
+    CHECK_EQUAL(1u, Changes[0].NewMip);
+}
+
+int main( int argc, char** argv )
+{
+    return TestHarness::RunTestCases(argc, argv);
+}